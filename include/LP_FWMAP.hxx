@@ -6,8 +6,12 @@
 
 namespace LP_MP {
 
-class LP_tree_FWMAP : public LP_with_trees<Lagrangean_factor_FWMAP, LP_tree_FWMAP> {
+template<typename FMC>
+class LP_tree_FWMAP : public LP_with_trees<FMC, Lagrangean_factor_FWMAP, LP_tree_FWMAP<FMC>> {
 public:
+   using base_type = LP_with_trees<FMC, Lagrangean_factor_FWMAP, LP_tree_FWMAP<FMC>>;
+   using tree_type = LP_tree_Lagrangean<FMC, Lagrangean_factor_FWMAP>;
+
    // for the Frank Wolfe implementation
    // to do: change the FWMAP implementation and make these methods virtual instead of static.
    // _y is the primal labeling to be computed
@@ -15,7 +19,7 @@ public:
    static double max_fn(double* wi, FWMAP::YPtr _y, FWMAP::TermData term_data)
    {
      
-      LP_tree_Lagrangean<Lagrangean_factor_FWMAP>* t = (LP_tree_Lagrangean<Lagrangean_factor_FWMAP>*) term_data;
+      tree_type* t = (tree_type*) term_data;
 
       // first add weights to problem
       // we only need to add Lagrange variables to Lagrangean_factors_ (others are not shared)
@@ -32,10 +36,20 @@ public:
       return t->primal_cost();
    }
 
+   // as max_fn, but weights stay applied to the tree-local factor copies and only differences are added
+   static double max_fn_persistent_weights(double* wi, FWMAP::YPtr _y, FWMAP::TermData term_data)
+   {
+      tree_type* t = (tree_type*) term_data;
+      t->set_weights(wi);
+      t->solve();
+      t->save_primal(_y);
+      return t->primal_cost();
+   }
+
    // copy values provided by subgradient from Lagrangean factors into ai
    static void copy_fn(double* ai, FWMAP::YPtr _y, FWMAP::TermData term_data)
    {
-      LP_tree_Lagrangean<Lagrangean_factor_FWMAP>* t = (LP_tree_Lagrangean<Lagrangean_factor_FWMAP>*) term_data;
+      tree_type* t = (tree_type*) term_data;
 
       // possibly this is not needed anymore
       std::fill(ai, ai+t->dual_size(), double(0.0));
@@ -43,20 +57,20 @@ public:
       // read in primal solution from which to compute subgradient
       t->read_in_primal(_y);
 
-      for(auto L : t->Lagrangean_factors_) {
+      for(auto& L : t->Lagrangean_factors_) {
          L.copy_fn(ai);
       }
    }
 
    static double dot_product_fn(double* wi, FWMAP::YPtr _y, FWMAP::TermData term_data)
    {
-      LP_tree_Lagrangean<Lagrangean_factor_FWMAP>* t = (LP_tree_Lagrangean<Lagrangean_factor_FWMAP>*) term_data;
+      tree_type* t = (tree_type*) term_data;
 
       // read in primal solution
       t->read_in_primal(_y);
 
       double v = 0.0;
-      for(auto L : t->Lagrangean_factors_) {
+      for(auto& L : t->Lagrangean_factors_) {
          v += L.dot_product_fn(wi);
       }
 
@@ -76,15 +90,19 @@ public:
 
    void construct_decomposition()
    {
+     if(this->factor_views()) {
+       throw std::runtime_error("FW-MAP callbacks need factor copies in every tree, factor views are not supported");
+     }
      bundle_solver = build_up_solver();
    }
 
    FWMAP* build_up_solver()
    {
-      auto* bundle_solver = new FWMAP(this->no_Lagrangean_vars(), trees_.size(), LP_tree_FWMAP::max_fn, LP_tree_FWMAP::copy_fn, LP_tree_FWMAP::dot_product_fn);//int d, int n, MaxFn max_fn, CopyFn copy_fn, DotProductFn dot_product_fn);
+      auto* max = persistent_weights_arg_.getValue() ? LP_tree_FWMAP::max_fn_persistent_weights : LP_tree_FWMAP::max_fn;
+      auto* bundle_solver = new FWMAP(this->no_Lagrangean_vars(), this->trees_.size(), max, LP_tree_FWMAP::copy_fn, LP_tree_FWMAP::dot_product_fn);//int d, int n, MaxFn max_fn, CopyFn copy_fn, DotProductFn dot_product_fn);
 
-      for(INDEX i=0; i<trees_.size(); ++i) {
-         auto& t = trees_[i];
+      for(INDEX i=0; i<this->trees_.size(); ++i) {
+         auto& t = this->trees_[i];
          const INDEX primal_size_in_bytes = t.primal_size_in_bytes();
 
          bundle_solver->SetTerm(i, &t, t.mapping().size(), &t.mapping()[0], t.primal_size_in_bytes()); // although mapping is of length di + 1 (the last entry being di itself, its length must be given as di!
@@ -108,8 +126,9 @@ public:
 
 public:
    LP_tree_FWMAP(TCLAP::CmdLine& cmd) 
-     : LP_with_trees(cmd),
-     proximal_weight_arg_("","proximalWeight","inverse weight for the proximal term", false, 1.0, "", cmd)
+     : base_type(cmd),
+     proximal_weight_arg_("","proximalWeight","inverse weight for the proximal term", false, 1.0, "", cmd),
+     persistent_weights_arg_("","persistentWeights","keep Lagrangean variables applied to the tree-local factor copies instead of adding and removing them around every tree solve", cmd)
   {
     bundle_solver = nullptr;
   }
@@ -141,6 +160,7 @@ private:
   FWMAP* bundle_solver;
   REAL lb_;
   TCLAP::ValueArg<double> proximal_weight_arg_; 
+  TCLAP::SwitchArg persistent_weights_arg_;
 };
 } // namespace LP_MP
 
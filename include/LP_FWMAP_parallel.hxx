@@ -0,0 +1,214 @@
+#ifndef LP_MP_LP_FWMAP_PARALLEL_HXX
+#define LP_MP_LP_FWMAP_PARALLEL_HXX
+
+#include "tree_decomposition.hxx"
+
+namespace LP_MP {
+
+// Parallel block-coordinate Frank-Wolfe for the proximal Lagrangean dual, as solved by FW-MAP:
+//    max_{lambda} sum_i f_i(lambda_i) - c/2 ||lambda - center||^2,   sum of lambda over copies of a factor = 0,
+// where f_i is the minimum of tree i with Lagrangean variables lambda_i added to its factor copies.
+// Block i holds a convex combination z_i of subgradients (atoms) of f_i and its cost l_i. The Lagrangean variables are recovered as
+//    lambda_i = center_i + (z_i - mean over copies of z)/c.
+// Each pass first solves all trees concurrently for the same lambda, which yields a lower bound and one new atom per block.
+// The atoms are then merged asynchronously by exact line search: trees are colored such that trees of one color share no Lagrangean variables,
+// hence all blocks of a color are updated in parallel on distinct slices of the Lagrangean variables.
+template<typename FMC>
+class LP_tree_FWMAP_parallel : public LP_with_trees<FMC, Lagrangean_factor_FWMAP, LP_tree_FWMAP_parallel<FMC>> {
+public:
+   using base_type = LP_with_trees<FMC, Lagrangean_factor_FWMAP, LP_tree_FWMAP_parallel<FMC>>;
+
+   LP_tree_FWMAP_parallel(TCLAP::CmdLine& cmd)
+     : base_type(cmd),
+     proximal_weight_arg_("","proximalWeight","inverse weight for the proximal term", false, 1.0, "", cmd),
+     passes_arg_("","fwPasses","number of Frank-Wolfe passes before the proximal center is moved", false, 3, &positiveIntegerConstraint, cmd),
+     persistent_weights_arg_("","persistentWeights","keep Lagrangean variables applied to the tree-local factor copies instead of adding and removing them around every tree solve", cmd)
+   {}
+
+   void construct_decomposition()
+   {
+      const INDEX n = this->no_Lagrangean_vars();
+      no_copies_.assign(n, 0);
+      for(const auto& t : this->trees_) {
+         for(const int k : t.mapping()) {
+            no_copies_[k]++;
+         }
+      }
+      z_sum_.assign(n, 0.0);
+
+      blocks_.resize(this->trees_.size());
+      for(INDEX i=0; i<this->trees_.size(); ++i) {
+         const INDEX d = this->trees_[i].mapping().size();
+         auto& b = blocks_[i];
+         b.center.assign(d, 0.0);
+         b.z.assign(d, 0.0);
+         b.atom.assign(d, 0.0);
+         b.lambda.assign(d, 0.0);
+      }
+
+      compute_tree_colors();
+      lb_ = -std::numeric_limits<REAL>::infinity();
+   }
+
+   void optimize_decomposition(const INDEX iteration)
+   {
+      for(INDEX pass=0; pass<passes_arg_.getValue(); ++pass) {
+         compute_atoms();
+         merge_atoms();
+      }
+      move_center();
+   }
+
+   void ComputeForwardPassAndPrimal(const INDEX iteration)
+   {}
+
+   void ComputeBackwardPassAndPrimal(const INDEX iteration)
+   {
+      this->ComputePass(iteration);
+   }
+
+   REAL decomposition_lower_bound() const
+   {
+      return lb_;
+   }
+
+private:
+   struct block {
+      std::vector<REAL> center, z, atom, lambda; // laid out as given by the tree's mapping
+      REAL cost = 0.0; // cost of z
+      REAL atom_cost = 0.0;
+      REAL value = 0.0; // minimum of tree for the Lagrangean variables of the last solve
+      bool initialized = false;
+   };
+
+   REAL c() const { return proximal_weight_arg_.getValue(); }
+
+   void compute_lambda(const INDEX i)
+   {
+      auto& b = blocks_[i];
+      const auto& m = this->trees_[i].mapping();
+      const REAL inv_c = 1.0/c();
+      for(INDEX l=0; l<m.size(); ++l) {
+         b.lambda[l] = b.center[l] + inv_c*(b.z[l] - z_sum_[m[l]]/no_copies_[m[l]]);
+      }
+   }
+
+   // Frank-Wolfe linear minimization oracle for every tree, all with the same Lagrangean variables
+   void compute_atoms()
+   {
+      this->for_each_tree_parallel([&](auto& t, const INDEX) {
+         const INDEX i = &t - &this->trees_[0];
+         auto& b = blocks_[i];
+         compute_lambda(i);
+         if(persistent_weights_arg_.getValue()) {
+            t.set_weights(b.lambda.data());
+         } else {
+            t.add_weights(b.lambda.data(), +1.0);
+         }
+         t.solve();
+         b.value = t.primal_cost();
+
+         t.compute_local_subgradient(b.atom.data());
+         b.atom_cost = b.value - std::inner_product(b.lambda.begin(), b.lambda.end(), b.atom.begin(), 0.0);
+
+         if(!persistent_weights_arg_.getValue()) {
+            t.add_weights(b.lambda.data(), -1.0);
+         }
+      });
+
+      // summing up in tree order keeps the lower bound independent of the thread assignment.
+      // The bound refers to the current costs, hence a larger bound from before a change of the model is not kept.
+      lb_ = 0.0;
+      for(const auto& b : blocks_) {
+         lb_ += b.value;
+      }
+   }
+
+   // Atoms may be stale, since Lagrangean variables changed through updates of other blocks. They are still feasible, hence line search guarantees descent.
+   void merge_atoms()
+   {
+      for(const auto& color : colors_) {
+#pragma omp parallel for schedule(dynamic,1)
+         for(INDEX k=0; k<color.size(); ++k) {
+            const INDEX i = color[k];
+            compute_lambda(i);
+            auto& b = blocks_[i];
+            const auto& m = this->trees_[i].mapping();
+
+            // derivative and curvature of the proximal dual along atom - z
+            REAL slope = b.atom_cost - b.cost;
+            REAL curvature = 0.0;
+            for(INDEX l=0; l<m.size(); ++l) {
+               const REAL d = b.atom[l] - b.z[l];
+               slope += b.lambda[l]*d;
+               curvature += d*d*(1.0 - 1.0/no_copies_[m[l]]);
+            }
+            curvature /= c();
+
+            REAL gamma = 1.0;
+            if(b.initialized) {
+               if(slope >= 0.0) { continue; }
+               if(curvature > 0.0) {
+                  gamma = std::min(REAL(1.0), -slope/curvature);
+               }
+            }
+            b.initialized = true;
+
+            for(INDEX l=0; l<m.size(); ++l) {
+               const REAL d = gamma*(b.atom[l] - b.z[l]);
+               b.z[l] += d;
+               z_sum_[m[l]] += d;
+            }
+            b.cost += gamma*(b.atom_cost - b.cost);
+         }
+      }
+   }
+
+   // proximal point step: center moves to the current Lagrangean variables, atoms are kept as warm start
+   void move_center()
+   {
+#pragma omp parallel for
+      for(INDEX i=0; i<blocks_.size(); ++i) {
+         compute_lambda(i);
+         blocks_[i].center = blocks_[i].lambda;
+      }
+   }
+
+   // greedy coloring of trees such that trees of one color have disjoint Lagrangean variables. Large trees are colored first.
+   void compute_tree_colors()
+   {
+      colors_.clear();
+      std::vector<std::vector<unsigned char>> occupied;
+      for(const INDEX i : this->tree_schedule_) {
+         const auto& m = this->trees_[i].mapping();
+         INDEX col = 0;
+         for(; col<colors_.size(); ++col) {
+            if(std::none_of(m.begin(), m.end(), [&](const int k) { return occupied[col][k]; })) {
+               break;
+            }
+         }
+         if(col == colors_.size()) {
+            colors_.push_back({});
+            occupied.push_back(std::vector<unsigned char>(this->no_Lagrangean_vars(), 0));
+         }
+         colors_[col].push_back(i);
+         for(const int k : m) {
+            occupied[col][k] = 1;
+         }
+      }
+   }
+
+   std::vector<block> blocks_;
+   std::vector<INDEX> no_copies_; // number of trees sharing a Lagrangean variable
+   std::vector<REAL> z_sum_; // sum of z over copies
+   std::vector<std::vector<INDEX>> colors_;
+   REAL lb_;
+
+   TCLAP::ValueArg<REAL> proximal_weight_arg_;
+   TCLAP::ValueArg<INDEX> passes_arg_;
+   TCLAP::SwitchArg persistent_weights_arg_;
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_LP_FWMAP_PARALLEL_HXX
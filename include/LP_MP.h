@@ -13,6 +13,7 @@
 #include <limits>
 #include <exception>
 #include <unordered_map>
+#include <unordered_set>
 #include "template_utilities.hxx"
 #include <assert.h>
 #include "topological_sort.hxx"
@@ -24,6 +25,7 @@
 #include "union_find.hxx"
 #include <thread>
 #include <future>
+#include <chrono>
 #include "memory_allocator.hxx"
 #include "serialization.hxx"
 #include "tclap/CmdLine.h"
@@ -129,6 +131,16 @@ public:
        bool adjacent_factor_receives;
    };
    virtual std::vector<message_trait> get_messages() const = 0;
+
+   // for removing factors from the model
+   virtual bool can_remove() const = 0;
+   virtual void unlink_messages() = 0;
+
+   // for branch and bound: branch_left restricts the factor to its current primal, branch_right forbids the current primal.
+   // Excluded labelings get the finite cost penalty added, since infinite costs would yield NaN in messages.
+   virtual bool can_branch() const = 0;
+   virtual void branch_left(const REAL penalty) = 0;
+   virtual void branch_right(const REAL penalty) = 0;
 };
 
 /*
@@ -190,7 +202,7 @@ class LP {
    {
        FactorTypeAdapter* left;
        FactorTypeAdapter* right;
-       const bool sends_message_to_left, sends_message_to_right, receives_message_from_left, receives_message_from_right;
+       bool sends_message_to_left, sends_message_to_right, receives_message_from_left, receives_message_from_right;
    };
 
 public:
@@ -258,6 +270,8 @@ public:
 
    INDEX GetNumberOfFactors() const { return f_.size(); }
    FactorTypeAdapter* GetFactor(const INDEX i) const { return f_[i]; }
+   auto factor_begin() const { return f_.begin(); }
+   auto factor_end() const { return f_.end(); }
 
    template<typename MESSAGE_CONTAINER_TYPE>
    static constexpr std::size_t message_tuple_index()
@@ -418,6 +432,7 @@ public:
    LPReparametrizationMode GetRepamMode() const { return repamMode_; }
 
    void set_flags_dirty();
+   void set_weights_dirty();
 
    // return type for get_omega
    struct omega_storage {
@@ -427,7 +442,25 @@ public:
       receive_array& receive_mask_backward;
    };
 
+   // weights are recomputed lazily here, e.g. after tightening or when the reparametrization mode changes. Time spent is accumulated for the solver's phase timing.
    omega_storage get_omega()
+   {
+      const auto begin_time = std::chrono::steady_clock::now();
+      const auto omega = compute_omega();
+      weight_computation_time_ += std::chrono::duration<REAL>(std::chrono::steady_clock::now() - begin_time).count();
+      return omega;
+   }
+
+   // seconds spent in get_omega since the last call
+   REAL take_weight_computation_time()
+   {
+      const REAL t = weight_computation_time_;
+      weight_computation_time_ = 0.0;
+      return t;
+   }
+
+private:
+   omega_storage compute_omega()
    {
       assert(repamMode_ != LPReparametrizationMode::Undefined);
       SortFactors();
@@ -477,11 +510,73 @@ public:
       }
    }
 
+public:
+
    auto get_forward_update_indices() const { return get_factor_indices(forwardUpdateOrdering_.begin(), forwardUpdateOrdering_.end()); }
    auto get_backward_update_indices() const { return get_factor_indices(backwardUpdateOrdering_.begin(), backwardUpdateOrdering_.end()); }
 
    void add_to_constant(const REAL x) { constant_ += x; }
 
+   // warm start: add delta (laid out as in serialize_dual) to the current reparametrization of f.
+   // Topology is unchanged, hence factor ordering and weights stay valid and optimization continues from the current dual.
+   void add_to_cost(FactorTypeAdapter* f, const REAL* delta)
+   {
+      serialization_archive ar(delta, f->dual_size_in_bytes());
+      addition_archive a(ar, 1.0);
+      f->serialize_dual(a);
+   }
+
+   // remove factors together with all their messages and return their memory to the factor container's pool.
+   // Only factors which hold all their messages themselves can be removed, e.g. tightening triplets.
+   // Dropping factors from a topological order leaves it valid, hence orderings are filtered; weights are recomputed lazily.
+   template<typename ITERATOR>
+   void remove_factors(ITERATOR begin, ITERATOR end)
+   {
+      const std::unordered_set<FactorTypeAdapter*> removed(begin, end);
+      if(removed.empty()) { return; }
+      for(auto* f : removed) {
+         assert(factor_address_to_index_.count(f) > 0);
+         if(!f->can_remove()) {
+            throw std::runtime_error("factor cannot be removed: messages are held by adjacent factors");
+         }
+      }
+      for(auto* f : removed) { f->unlink_messages(); }
+
+      auto is_removed = [&](FactorTypeAdapter* f) { return removed.count(f) > 0; };
+      m_.erase(std::remove_if(m_.begin(), m_.end(), [&](const message_trait& m) { return is_removed(m.left) || is_removed(m.right); }), m_.end());
+      for_each_tuple(messages_, [&](auto& msg_vec) {
+         msg_vec.erase(std::remove_if(msg_vec.begin(), msg_vec.end(), [&](auto* m) { return is_removed(m->GetLeftFactor()) || is_removed(m->GetRightFactor()); }), msg_vec.end());
+      });
+      for_each_tuple(factors_, [&](auto& fac_vec) {
+         fac_vec.erase(std::remove_if(fac_vec.begin(), fac_vec.end(), [&](auto* f) { return is_removed(f); }), fac_vec.end());
+      });
+
+      f_.erase(std::remove_if(f_.begin(), f_.end(), is_removed), f_.end());
+      factor_address_to_index_.clear();
+      for(INDEX i=0; i<f_.size(); ++i) { factor_address_to_index_.insert(std::make_pair(f_[i], i)); }
+
+      auto rel_removed = [&](const auto& r) { return is_removed(r.first) || is_removed(r.second); };
+      forward_pass_factor_rel_.erase(std::remove_if(forward_pass_factor_rel_.begin(), forward_pass_factor_rel_.end(), rel_removed), forward_pass_factor_rel_.end());
+      backward_pass_factor_rel_.erase(std::remove_if(backward_pass_factor_rel_.begin(), backward_pass_factor_rel_.end(), rel_removed), backward_pass_factor_rel_.end());
+      partition_graph.erase(std::remove_if(partition_graph.begin(), partition_graph.end(), [&](const auto& e) { return is_removed(e[0]) || is_removed(e[1]); }), partition_graph.end());
+
+      if(ordering_valid_) {
+         for(auto* o : {&forwardOrdering_, &backwardOrdering_, &forwardUpdateOrdering_, &backwardUpdateOrdering_}) {
+            o->erase(std::remove_if(o->begin(), o->end(), is_removed), o->end());
+         }
+         auto sorted_indices = [&](const std::vector<FactorTypeAdapter*>& ordering, std::vector<INDEX>& f_sorted) {
+            assert(ordering.size() == f_.size());
+            f_sorted.resize(ordering.size());
+            for(INDEX i=0; i<ordering.size(); ++i) { f_sorted[i] = factor_address_to_index_.find(ordering[i])->second; }
+         };
+         sorted_indices(forwardOrdering_, f_forward_sorted_);
+         sorted_indices(backwardOrdering_, f_backward_sorted_);
+      }
+      set_weights_dirty();
+
+      for(auto* f : removed) { delete f; }
+   }
+
    // methods for staged optimization
    void put_in_same_partition(FactorTypeAdapter* f1, FactorTypeAdapter* f2) { factor_partition_valid_ = false; partition_graph.push_back({f1,f2}); }
 
@@ -537,6 +632,8 @@ protected:
    bool full_receive_mask_valid_ = false;
    receive_array full_receive_mask_forward_, full_receive_mask_backward_;
 
+   REAL weight_computation_time_ = 0.0;
+
    std::vector<std::pair<FactorTypeAdapter*, FactorTypeAdapter*> > forward_pass_factor_rel_, backward_pass_factor_rel_; // factor ordering relations. First factor must come before second factor. factorRel_ must describe a DAG
 
    
@@ -1608,12 +1705,21 @@ template<typename FMC>
 void LP<FMC>::set_flags_dirty()
 {
   ordering_valid_ = false;
+  set_weights_dirty();
+}
+
+// invalidate everything computed from the current set of factors and messages except the factor ordering
+template<typename FMC>
+void LP<FMC>::set_weights_dirty()
+{
   omega_anisotropic_valid_ = false;
   omega_anisotropic2_valid_ = false;
   omega_isotropic_valid_ = false;
   omega_isotropic_damped_valid_ = false;
   omega_mixed_valid_ = false;
+  full_receive_mask_valid_ = false;
   factor_partition_valid_ = false;
+  overlapping_factor_partition_valid_ = false;
 #ifdef LP_MP_PARALLEL
   synchronization_valid_ = false;
 #endif
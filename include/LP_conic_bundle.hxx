@@ -51,13 +51,27 @@ public:
       // load Lagrangean variables
       this->add_weights(&x[0], -1.0);
 
-      // compute subgradient
-      objective_value = 0.0;
-      ConicBundle::DVector subg(x.size(), 0.0); // this is not so nice!
-      for(auto& t : this->trees_) {
+      // compute subgradient. Trees are solved in parallel, each thread accumulating into its own subgradient buffer
+      const INDEX no_threads = this->no_threads();
+      thread_subgradient_.resize(no_threads);
+      for(auto& g : thread_subgradient_) {
+         g.assign(x.size(), 0.0);
+      }
+      tree_cost_.resize(this->trees_.size());
+      this->for_each_tree_parallel([&](auto& t, const INDEX thread) {
          t.solve();
-         t.compute_mapped_subgradient(subg);
-         objective_value -= t.primal_cost();
+         t.compute_mapped_subgradient(thread_subgradient_[thread]);
+         tree_cost_[&t - &this->trees_[0]] = t.primal_cost();
+      });
+
+      // summing up in tree order keeps the objective independent of the thread assignment
+      objective_value = -std::accumulate(tree_cost_.begin(), tree_cost_.end(), 0.0);
+      ConicBundle::DVector subg(x.size(), 0.0);
+#pragma omp parallel for
+      for(INDEX i=0; i<x.size(); ++i) {
+         for(INDEX thread=0; thread<no_threads; ++thread) {
+            subg[i] += thread_subgradient_[thread][i];
+         }
       }
       cut_vals.push_back(objective_value);
       subgradients.push_back(subg);
@@ -85,6 +99,8 @@ public:
 
 private:
    ConicBundle::CBSolver cb_solver_;
+   std::vector<std::vector<double>> thread_subgradient_;
+   std::vector<REAL> tree_cost_;
 
 };
 
@@ -0,0 +1,104 @@
+#ifndef LP_MP_LP_PROXIMAL_BUNDLE_HXX
+#define LP_MP_LP_PROXIMAL_BUNDLE_HXX
+
+#include "tree_decomposition.hxx"
+#include "proximal_bundle.hxx"
+#include <memory>
+
+namespace LP_MP {
+
+// maximize the Lagrangean dual of a tree decomposition with the built-in proximal bundle method, not requiring ConicBundle
+template<typename FMC>
+class LP_proximal_bundle : public LP_with_trees<FMC, Lagrangean_factor_star, LP_proximal_bundle<FMC>> {
+public:
+   using base_type = LP_with_trees<FMC, Lagrangean_factor_star, LP_proximal_bundle<FMC>>;
+
+   LP_proximal_bundle(TCLAP::CmdLine& cmd)
+     : base_type(cmd),
+     proximal_weight_arg_("","proximalWeight","weight of the proximal term, adapted during optimization", false, 1.0, "", cmd),
+     bundle_size_arg_("","bundleSize","maximum number of cuts kept in the bundle", false, 10, &positiveIntegerConstraint, cmd),
+     max_null_steps_arg_("","maxNullSteps","maximum number of null steps per iteration", false, 10, &positiveIntegerConstraint, cmd)
+   {}
+
+   void construct_decomposition()
+   {
+      proximal_bundle_options o;
+      o.proximal_weight = proximal_weight_arg_.getValue();
+      o.max_bundle_size = std::max(INDEX(2), bundle_size_arg_.getValue());
+      bundle_ = std::make_unique<proximal_bundle>(this->no_Lagrangean_vars(), o);
+      bundle_->init(*this);
+   }
+
+   // iterate until the center moves or the null step budget is exhausted
+   void optimize_decomposition(const INDEX iteration)
+   {
+      for(INDEX k=0; k<max_null_steps_arg_.getValue() && !bundle_->converged(); ++k) {
+         if(bundle_->step(*this)) {
+            break;
+         }
+      }
+   }
+
+   void ComputeForwardPassAndPrimal(const INDEX iteration)
+   {}
+
+   void ComputeBackwardPassAndPrimal(const INDEX iteration)
+   {
+      this->ComputePass(iteration);
+   }
+
+   // oracle for the bundle method: dual value at the Lagrangean variables x and a supergradient
+   REAL operator()(const std::vector<REAL>& x, std::vector<REAL>& supergradient)
+   {
+      // load Lagrangean variables
+      this->add_weights(&x[0], -1.0);
+
+      const INDEX no_threads = this->no_threads();
+      thread_subgradient_.resize(no_threads);
+      for(auto& g : thread_subgradient_) {
+         g.assign(x.size(), 0.0);
+      }
+      tree_cost_.resize(this->trees_.size());
+      this->for_each_tree_parallel([&](auto& t, const INDEX thread) {
+         t.solve();
+         t.compute_mapped_subgradient(thread_subgradient_[thread]);
+         tree_cost_[&t - &this->trees_[0]] = t.primal_cost();
+      });
+
+      // summing up in tree order keeps the value independent of the thread assignment
+      const REAL value = std::accumulate(tree_cost_.begin(), tree_cost_.end(), 0.0);
+      // compute_mapped_subgradient yields a subgradient of the negated dual
+#pragma omp parallel for
+      for(INDEX i=0; i<x.size(); ++i) {
+         supergradient[i] = 0.0;
+         for(INDEX thread=0; thread<no_threads; ++thread) {
+            supergradient[i] -= thread_subgradient_[thread][i];
+         }
+      }
+
+      // remove Lagrangean variables again
+      this->add_weights(&x[0], +1.0);
+
+      return value;
+   }
+
+   // dual value at the current center, already evaluated by the bundle method
+   REAL decomposition_lower_bound() const
+   {
+      assert(bundle_);
+      return bundle_->value();
+   }
+
+private:
+   std::unique_ptr<proximal_bundle> bundle_;
+   std::vector<std::vector<REAL>> thread_subgradient_;
+   std::vector<REAL> tree_cost_;
+
+   TCLAP::ValueArg<REAL> proximal_weight_arg_;
+   TCLAP::ValueArg<INDEX> bundle_size_arg_;
+   TCLAP::ValueArg<INDEX> max_null_steps_arg_;
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_LP_PROXIMAL_BUNDLE_HXX
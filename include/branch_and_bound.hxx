@@ -0,0 +1,177 @@
+#ifndef LP_MP_BRANCH_AND_BOUND_HXX
+#define LP_MP_BRANCH_AND_BOUND_HXX
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include "LP_MP.h"
+#include "factor_archive.hxx"
+
+namespace LP_MP {
+
+// Branch and bound on top of the message passing relaxation, run after the relaxation has been optimized.
+// A node is a snapshot of the dual of all factors. Branching decisions are penalties on the excluded labelings of the branched factor, hence they are part of the snapshot.
+// Penalties are finite, since infinite costs yield NaN in messages (inf - inf). Any penalty keeps node bounds valid, as it only relaxes the decision.
+// The penalty exceeds the gap between incumbent and root bound. Primal solutions are evaluated w.r.t. the root costs, since node costs contain the penalties.
+// Nodes are bounded by a few message passing iterations warm-started from the snapshot of their parent, which also yield primal solutions.
+// The factor with the largest gap between primal cost and lower bound among the inconsistent ones and their neighbors is branched on: left restricts it to its current primal, right forbids the current primal.
+// Neighbors are included, since e.g. variables may be locally optimal while the factors coupling them are not.
+template<typename BASE_LP>
+class branch_and_bound : public BASE_LP {
+public:
+  branch_and_bound(TCLAP::CmdLine& cmd)
+  : BASE_LP(cmd)
+  , node_selection_arg_("", "bbNodeSelection", "node selection rule of branch and bound", false, "best-first", "{best-first|depth-first}", cmd)
+  , bounding_iterations_arg_("", "bbBoundingIterations", "message passing iterations for bounding a node", false, 5, &positiveIntegerConstraint, cmd)
+  , max_nodes_arg_("", "bbMaxNodes", "maximum number of branch and bound nodes", false, 100000, &positiveIntegerConstraint, cmd)
+  {}
+
+  void End() {
+    BASE_LP::End();
+
+    if (node_selection_arg_.getValue() != "best-first" && node_selection_arg_.getValue() != "depth-first")
+      throw std::runtime_error("node selection rule " + node_selection_arg_.getValue() + " unknown");
+    const bool depth_first = node_selection_arg_.getValue() == "depth-first";
+
+    // timestamps of primal computation must exceed those used during optimization
+    primal_iteration_ = std::numeric_limits<INDEX>::max()/4;
+
+    dual_archive root(this->f_.begin(), this->f_.end());
+    dual_archive node_dual(this->f_.begin(), this->f_.end());
+    const REAL root_bound = this->LowerBound();
+    std::unique_ptr<primal_archive> best_primal;
+    REAL upper_bound = std::numeric_limits<REAL>::infinity();
+    REAL unresolved_bound = std::numeric_limits<REAL>::infinity(); // lowest bound of nodes that could not be branched on
+
+    std::vector<node> queue;
+    queue.push_back({root_bound, 0, std::make_unique<dual_archive>(root)});
+    auto worse = [](const node& a, const node& b) { return a.bound > b.bound; };
+
+    INDEX no_nodes = 0;
+    for (; !queue.empty() && no_nodes < max_nodes_arg_.getValue(); ++no_nodes) {
+      if (!depth_first)
+        std::pop_heap(queue.begin(), queue.end(), worse);
+      node n = std::move(queue.back());
+      queue.pop_back();
+      if (!(n.bound < upper_bound - eps))
+        continue;
+
+      n.dual->load_all();
+      for (INDEX i = 0; i < bounding_iterations_arg_.getValue(); ++i)
+        this->ComputePassAndPrimal(primal_iteration_++);
+
+      const REAL lower_bound = this->LowerBound();
+      // penalties are finite, hence an infinite cost means the primal is inconsistent or infeasible
+      REAL primal_cost = this->EvaluatePrimal();
+      if (std::isfinite(primal_cost)) {
+        node_dual.save_all();
+        root.load_all();
+        primal_cost = this->EvaluatePrimal();
+        node_dual.load_all();
+      }
+      if (primal_cost < upper_bound) {
+        upper_bound = primal_cost;
+        best_primal = std::make_unique<primal_archive>(this->f_.begin(), this->f_.end());
+        if (debug())
+          std::cout << "branch and bound: new upper bound " << upper_bound << " at depth " << n.depth << "\n";
+      }
+      // costs that are infinite in the model itself may still yield an undefined bound, the node is then resolved with the bound of its parent
+      if (std::isnan(lower_bound)) {
+        unresolved_bound = std::min(unresolved_bound, n.bound);
+        continue;
+      }
+      // also prunes infeasible nodes, whose bound is infinite
+      if (!(lower_bound < upper_bound - eps))
+        continue;
+
+      FactorTypeAdapter* f = select_branching_factor();
+      if (f == nullptr) {
+        unresolved_bound = std::min(unresolved_bound, lower_bound);
+        continue;
+      }
+
+      // without an incumbent, the penalty is taken large relative to the root bound
+      const REAL penalty = std::isfinite(upper_bound) ? upper_bound - root_bound + 1.0 : 1e3*(1.0 + std::abs(root_bound));
+      dual_archive parent(this->f_.begin(), this->f_.end());
+      f->branch_right(penalty);
+      node right{lower_bound, n.depth+1, std::make_unique<dual_archive>(this->f_.begin(), this->f_.end())};
+      parent.load_all();
+      f->branch_left(penalty);
+      node left{lower_bound, n.depth+1, std::make_unique<dual_archive>(this->f_.begin(), this->f_.end())};
+
+      // the left child contains the current primal, hence depth first search dives along it
+      for (node* c : {&right, &left}) {
+        queue.push_back(std::move(*c));
+        if (!depth_first)
+          std::push_heap(queue.begin(), queue.end(), worse);
+      }
+    }
+
+    REAL lower_bound = std::min(unresolved_bound, upper_bound);
+    for (const auto& n : queue)
+      lower_bound = std::min(lower_bound, n.bound);
+    lower_bound_ = lower_bound;
+    upper_bound_ = upper_bound;
+    no_nodes_ = no_nodes;
+
+    // report the relaxation with the best primal solution found
+    root.load_all();
+    if (best_primal)
+      best_primal->load_all();
+
+    std::cout << "branch and bound: " << no_nodes << " nodes, lower bound = " << lower_bound << ", upper bound = " << upper_bound;
+    if (lower_bound >= upper_bound - eps)
+      std::cout << ", optimal";
+    std::cout << "\n";
+  }
+
+  // results of the last branch and bound run
+  REAL branch_and_bound_lower_bound() const { return lower_bound_; }
+  REAL branch_and_bound_upper_bound() const { return upper_bound_; }
+  INDEX branch_and_bound_nodes() const { return no_nodes_; }
+
+private:
+  using dual_archive = factor_archive<serialization_functor::dual>;
+  using primal_archive = factor_archive<serialization_functor::primal>;
+
+  struct node {
+    REAL bound; // lower bound of the parent
+    INDEX depth;
+    std::unique_ptr<dual_archive> dual;
+  };
+
+  // most inconsistent factor that supports branching, nullptr if there is none
+  FactorTypeAdapter* select_branching_factor()
+  {
+    const auto inconsistent = this->get_inconsistent_mask(1);
+    std::vector<REAL> gap(this->f_.size(), -std::numeric_limits<REAL>::infinity());
+#pragma omp parallel for schedule(guided)
+    for (INDEX i = 0; i < this->f_.size(); ++i) {
+      auto* f = this->f_[i];
+      if (inconsistent[i] && f->can_branch())
+        gap[i] = f->EvaluatePrimal() - f->LowerBound();
+    }
+    const auto it = std::max_element(gap.begin(), gap.end());
+    if (it == gap.end() || *it == -std::numeric_limits<REAL>::infinity())
+      return nullptr;
+    return this->f_[it - gap.begin()];
+  }
+
+  TCLAP::ValueArg<std::string> node_selection_arg_;
+  TCLAP::ValueArg<INDEX> bounding_iterations_arg_;
+  TCLAP::ValueArg<INDEX> max_nodes_arg_;
+  INDEX primal_iteration_;
+  REAL lower_bound_ = -std::numeric_limits<REAL>::infinity();
+  REAL upper_bound_ = std::numeric_limits<REAL>::infinity();
+  INDEX no_nodes_ = 0;
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_BRANCH_AND_BOUND_HXX
+
+// vim: set ts=2 sts=2 sw=2 et:
@@ -0,0 +1,385 @@
+#ifndef LP_MP_CHECKPOINT_HXX
+#define LP_MP_CHECKPOINT_HXX
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "LP_MP.h"
+#include "factor_archive.hxx"
+#include "snapshot_chain.hxx"
+
+namespace LP_MP {
+
+// snapshot of the solver state: dual of all factors, best primal, iteration counter and time spent in optimization.
+// The best primal is kept as string and, if it was recorded for the current factors, as primal of all factors.
+struct checkpoint_state {
+   using dual_archive = factor_archive<serialization_functor::dual>;
+   using primal_archive = factor_archive<serialization_functor::primal>;
+
+   std::unique_ptr<dual_archive> dual;
+   std::unique_ptr<primal_archive> primal; // may be empty
+   std::uint64_t iteration = 0;
+   double time = 0.0; // seconds
+   REAL lower_bound = -std::numeric_limits<REAL>::infinity();
+   REAL best_primal_cost = std::numeric_limits<REAL>::infinity();
+   std::string solution;
+};
+
+// file layout: magic, version, number of factors, dual size in bytes, primal size in bytes (0 if there is none), iteration, time, lower bound, best primal cost, solution length, solution, dual, primal
+// Delta checkpoint files keep all checkpoints of a run: magic, version, snapshot_chain header, then one record per checkpoint with
+// number of factors, iteration, time, lower bound, best primal cost, solution length, solution, primal size, primal and the dual as snapshot_chain frame.
+// Records are only appended, a record truncated by a crash is ignored when reading.
+namespace checkpoint_file {
+
+   constexpr static char magic[8] = {'L','P','M','P','C','K','P','T'};
+   constexpr static char delta_magic[8] = {'L','P','M','P','C','K','P','D'};
+   constexpr static std::uint32_t version = 3;
+
+   using file_ptr = std::unique_ptr<std::FILE, int(*)(std::FILE*)>;
+
+   template<typename T>
+   void write_pod(std::FILE* f, const T& x) { std::fwrite(&x, sizeof(T), 1, f); }
+   template<typename T>
+   void write_pod(std::ostream& s, const T& x) { s.write(reinterpret_cast<const char*>(&x), sizeof(T)); }
+   template<typename T>
+   void read_pod(std::ifstream& s, T& x) { s.read(reinterpret_cast<char*>(&x), sizeof(T)); }
+
+   inline std::uint64_t primal_size(const checkpoint_state& c) { return c.primal != nullptr ? c.primal->size() : 0; }
+
+   // archive for the primal of the given factors to be read into, nullptr if the checkpoint contains no primal
+   template<typename FACTOR_ITERATOR>
+   std::unique_ptr<checkpoint_state::primal_archive> primal_for_reading(const std::uint64_t size, const std::string& filename, FACTOR_ITERATOR factor_begin, FACTOR_ITERATOR factor_end)
+   {
+      if(size == 0) { return nullptr; }
+      auto primal = std::make_unique<checkpoint_state::primal_archive>(factor_begin, factor_end);
+      if(size != primal->size()) {
+         throw std::runtime_error("checkpoint " + filename + " does not match model: primal of " + std::to_string(size) + " bytes in checkpoint, " + std::to_string(primal->size()) + " in model");
+      }
+      return primal;
+   }
+
+   // make a rename in the directory of filename durable
+   inline void sync_directory(const std::string& filename)
+   {
+      const auto pos = filename.find_last_of('/');
+      const std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : filename.substr(0, pos));
+      const int fd = ::open(dir.c_str(), O_RDONLY);
+      if(fd < 0) { throw std::runtime_error("could not open directory " + dir); }
+      const int ret = ::fsync(fd);
+      const int err = errno;
+      ::close(fd);
+      // some file systems do not support syncing directories
+      if(ret != 0 && err != EINVAL) { throw std::runtime_error("could not sync directory " + dir); }
+   }
+
+   inline file_ptr open(const std::string& filename, const char* mode)
+   {
+      file_ptr f(std::fopen(filename.c_str(), mode), &std::fclose);
+      if(!f) { throw std::runtime_error("could not open checkpoint file " + filename); }
+      return f;
+   }
+
+   inline void sync_and_close(file_ptr f, const std::string& filename)
+   {
+      if(std::fflush(f.get()) != 0 || std::ferror(f.get()) || ::fsync(fileno(f.get())) != 0) {
+         throw std::runtime_error("could not write checkpoint file " + filename);
+      }
+      if(std::fclose(f.release()) != 0) {
+         throw std::runtime_error("could not write checkpoint file " + filename);
+      }
+   }
+
+   inline void replace(const std::string& tmp_filename, const std::string& filename)
+   {
+      if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+         throw std::runtime_error("could not rename " + tmp_filename + " to " + filename);
+      }
+      sync_directory(filename);
+   }
+
+   // write into a temporary file, sync it to disk and rename it afterwards, so that neither an interrupted write nor a crash destroys the previous checkpoint.
+   inline void write(const std::string& filename, const checkpoint_state& c)
+   {
+      assert(c.dual != nullptr);
+      const std::string tmp_filename = filename + ".tmp";
+      {
+         auto f = open(tmp_filename, "wb");
+         std::fwrite(magic, 1, sizeof(magic), f.get());
+         write_pod(f.get(), version);
+         write_pod(f.get(), std::uint64_t(c.dual->no_factors()));
+         write_pod(f.get(), std::uint64_t(c.dual->size()));
+         write_pod(f.get(), primal_size(c));
+         write_pod(f.get(), c.iteration);
+         write_pod(f.get(), c.time);
+         write_pod(f.get(), c.lower_bound);
+         write_pod(f.get(), c.best_primal_cost);
+         write_pod(f.get(), std::uint64_t(c.solution.size()));
+         std::fwrite(c.solution.data(), 1, c.solution.size(), f.get());
+         std::fwrite(c.dual->data(), 1, c.dual->size(), f.get());
+         if(c.primal != nullptr) {
+            std::fwrite(c.primal->data(), 1, c.primal->size(), f.get());
+         }
+         sync_and_close(std::move(f), tmp_filename);
+      }
+      replace(tmp_filename, filename);
+   }
+
+   // append checkpoint to a delta checkpoint file, encoded against the previous checkpoint in chain.
+   // With an empty chain a new file is started, which replaces an existing one only when completely written.
+   inline void append(const std::string& filename, const checkpoint_state& c, snapshot_chain& chain)
+   {
+      assert(c.dual != nullptr);
+      const bool new_file = chain.no_snapshots() == 0;
+      std::ostringstream s;
+      if(new_file) {
+         s.write(delta_magic, sizeof(delta_magic));
+         write_pod(s, version);
+         chain.write_header(s);
+      }
+      const std::size_t k = chain.push(c.dual->data(), c.dual->size());
+      write_pod(s, std::uint64_t(c.dual->no_factors()));
+      write_pod(s, c.iteration);
+      write_pod(s, c.time);
+      write_pod(s, c.lower_bound);
+      write_pod(s, c.best_primal_cost);
+      write_pod(s, std::uint64_t(c.solution.size()));
+      s.write(c.solution.data(), c.solution.size());
+      write_pod(s, primal_size(c));
+      if(c.primal != nullptr) {
+         s.write(c.primal->data(), c.primal->size());
+      }
+      chain.write_frame(s, k);
+      chain.release_frames();
+
+      const std::string record = s.str();
+      const std::string target = new_file ? filename + ".tmp" : filename;
+      auto f = open(target, new_file ? "wb" : "ab");
+      std::fwrite(record.data(), 1, record.size(), f.get());
+      sync_and_close(std::move(f), target);
+      if(new_file) {
+         replace(target, filename);
+      }
+   }
+
+   // read last complete checkpoint of a delta checkpoint file
+   template<typename FACTOR_ITERATOR>
+   checkpoint_state read_delta(std::ifstream& s, const std::string& filename, FACTOR_ITERATOR factor_begin, FACTOR_ITERATOR factor_end)
+   {
+      auto chain = snapshot_chain::read_header(s);
+      checkpoint_state c;
+      std::uint64_t no_factors = 0;
+      std::vector<char> primal;
+      while(true) {
+         checkpoint_state r;
+         std::uint64_t n, solution_size, primal_size;
+         read_pod(s, n);
+         read_pod(s, r.iteration);
+         read_pod(s, r.time);
+         read_pod(s, r.lower_bound);
+         read_pod(s, r.best_primal_cost);
+         read_pod(s, solution_size);
+         if(!s.good()) { break; }
+         r.solution.resize(solution_size);
+         s.read(&r.solution[0], solution_size);
+         read_pod(s, primal_size);
+         if(!s.good()) { break; }
+         std::vector<char> r_primal(primal_size);
+         s.read(r_primal.data(), primal_size);
+         if(!s.good() || !chain.read_frame(s)) { break; }
+         no_factors = n;
+         c = std::move(r);
+         primal = std::move(r_primal);
+      }
+      if(chain.no_snapshots() == 0) {
+         throw std::runtime_error("checkpoint file " + filename + " contains no complete checkpoint");
+      }
+
+      const std::size_t k = chain.no_snapshots()-1;
+      c.dual = std::make_unique<checkpoint_state::dual_archive>(factor_begin, factor_end);
+      if(no_factors != c.dual->no_factors() || chain.snapshot_size(k) != c.dual->size()) {
+         throw std::runtime_error("checkpoint " + filename + " does not match model: " + std::to_string(no_factors) + " factors in checkpoint, " + std::to_string(c.dual->no_factors()) + " in model");
+      }
+      c.primal = primal_for_reading(primal.size(), filename, factor_begin, factor_end);
+      chain.reconstruct(k, c.dual->data());
+      c.dual->load_all();
+      if(c.primal != nullptr) {
+         std::memcpy(c.primal->data(), primal.data(), primal.size());
+         c.primal->load_all();
+      }
+      return c;
+   }
+
+   // read checkpoint into the dual and, if contained, the primal of the given factors. Factors must be the same as when the checkpoint was written.
+   template<typename FACTOR_ITERATOR>
+   checkpoint_state read(const std::string& filename, FACTOR_ITERATOR factor_begin, FACTOR_ITERATOR factor_end)
+   {
+      std::ifstream s(filename, std::ios::binary);
+      if(!s.is_open()) { throw std::runtime_error("could not open checkpoint file " + filename); }
+
+      char m[sizeof(magic)];
+      s.read(m, sizeof(magic));
+      std::uint32_t v;
+      read_pod(s, v);
+      const bool delta = std::memcmp(m, delta_magic, sizeof(delta_magic)) == 0;
+      if(!s.good() || (std::memcmp(m, magic, sizeof(magic)) != 0 && !delta) || v != version) {
+         throw std::runtime_error(filename + " is not a valid checkpoint file");
+      }
+      if(delta) {
+         return read_delta(s, filename, factor_begin, factor_end);
+      }
+
+      std::uint64_t no_factors, dual_size, primal_size, solution_size;
+      checkpoint_state c;
+      read_pod(s, no_factors);
+      read_pod(s, dual_size);
+      read_pod(s, primal_size);
+      read_pod(s, c.iteration);
+      read_pod(s, c.time);
+      read_pod(s, c.lower_bound);
+      read_pod(s, c.best_primal_cost);
+      read_pod(s, solution_size);
+      c.solution.resize(solution_size);
+      s.read(&c.solution[0], solution_size);
+
+      c.dual = std::make_unique<checkpoint_state::dual_archive>(factor_begin, factor_end);
+      if(no_factors != c.dual->no_factors() || dual_size != c.dual->size()) {
+         throw std::runtime_error("checkpoint " + filename + " does not match model: " + std::to_string(no_factors) + " factors in checkpoint, " + std::to_string(c.dual->no_factors()) + " in model");
+      }
+      c.primal = primal_for_reading(primal_size, filename, factor_begin, factor_end);
+      s.read(c.dual->data(), dual_size);
+      if(c.primal != nullptr) {
+         s.read(c.primal->data(), primal_size);
+      }
+      if(!s.good()) { throw std::runtime_error("could not read checkpoint file " + filename); }
+      c.dual->load_all();
+      if(c.primal != nullptr) {
+         c.primal->load_all();
+      }
+
+      return c;
+   }
+
+} // namespace checkpoint_file
+
+// writes checkpoints in a background thread. The solver only pays for copying the dual into the snapshot.
+// If the previous checkpoint is still being written, new snapshots are dropped instead of stalling the solver.
+// In delta mode all checkpoints are kept in one file, each stored as compressed difference to its predecessor.
+class checkpoint_writer {
+public:
+   checkpoint_writer(const std::string& filename, const bool delta = false)
+      : filename_(filename),
+      delta_(delta),
+      thread_([this]() { this->run(); })
+   {}
+
+   ~checkpoint_writer()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         stop_ = true;
+      }
+      cv_.notify_one();
+      thread_.join();
+   }
+
+   bool busy()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return pending_ || writing_;
+   }
+
+   // best_primal may be nullptr, otherwise it must have been recorded for the given factors
+   template<typename FACTOR_ITERATOR>
+   bool submit(FACTOR_ITERATOR factor_begin, FACTOR_ITERATOR factor_end, const std::uint64_t iteration, const double time, const REAL lower_bound, const REAL best_primal_cost, const std::string& solution, const checkpoint_state::primal_archive* best_primal = nullptr)
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if(pending_ || writing_) { return false; }
+
+      // reuse the archive of the last snapshot when the factors did not change
+      if(state_.dual != nullptr && state_.dual->matches(factor_begin, factor_end)) {
+         lock.unlock();
+         state_.dual->save_all();
+      } else {
+         lock.unlock();
+         state_.dual = std::make_unique<checkpoint_state::dual_archive>(factor_begin, factor_end);
+      }
+      state_.iteration = iteration;
+      state_.time = time;
+      state_.lower_bound = lower_bound;
+      state_.best_primal_cost = best_primal_cost;
+      state_.solution = solution;
+      state_.primal = best_primal != nullptr ? std::make_unique<checkpoint_state::primal_archive>(*best_primal) : nullptr;
+
+      lock.lock();
+      pending_ = true;
+      lock.unlock();
+      cv_.notify_one();
+      return true;
+   }
+
+   // wait until all submitted checkpoints are on disk
+   void flush()
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [this]() { return !pending_ && !writing_; });
+   }
+
+private:
+   void run()
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while(true) {
+         cv_.wait(lock, [this]() { return pending_ || stop_; });
+         if(pending_) {
+            pending_ = false;
+            writing_ = true;
+            lock.unlock();
+            try {
+               if(delta_) {
+                  checkpoint_file::append(filename_, state_, chain_);
+               } else {
+                  checkpoint_file::write(filename_, state_);
+               }
+            } catch(std::exception& e) {
+               chain_ = snapshot_chain(); // a partially appended record must not be followed by further ones, start a new file
+               std::cerr << "checkpoint failed: " << e.what() << "\n";
+            }
+            lock.lock();
+            writing_ = false;
+            done_cv_.notify_all();
+         } else if(stop_) {
+            return;
+         }
+      }
+   }
+
+   const std::string filename_;
+   const bool delta_;
+   snapshot_chain chain_; // only touched by the writer thread
+   checkpoint_state state_; // only touched by the solver thread while !pending_ && !writing_, otherwise by the writer thread
+
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   std::condition_variable done_cv_;
+   bool pending_ = false;
+   bool writing_ = false;
+   bool stop_ = false;
+
+   std::thread thread_; // must be initialized last
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_CHECKPOINT_HXX
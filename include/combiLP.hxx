@@ -2,7 +2,8 @@
 #define LP_MP_combiLP_HXX
 
 #include <iostream>
-#include <unordered_set>
+#include <algorithm>
+#include <numeric>
 #include <vector>
 
 #include "LP_MP.h"
@@ -37,7 +38,7 @@ public:
   void End() {
     is_ilp_phase_ = true;
 
-    enum class State { LP, Active, ILP };
+    enum class State : unsigned char { LP, Active, ILP };
 
 #ifndef NDEBUG
     auto state_to_string = [](State s) {
@@ -52,10 +53,20 @@ public:
     };
 #endif
 
+    // Factors are addressed by their index in the LP and all per-factor state
+    // is held in flat arrays. Messages are traversed through the adjacency of
+    // factors, hence only the neighborhood of the active region and of the
+    // border is visited in every round.
     using primals = factor_archive<serialization_functor::primal>;
+    const indexed_message_graph<EXTERNAL_SOLVER> graph(*this);
+    const INDEX no_factors = graph.no_factors();
     INDEX size_lp, size_active, size_ilp;
-    std::unordered_map<FactorTypeAdapter*, State> factor_states;
-    partial_external_solver<EXTERNAL_SOLVER> external_solver;
+    std::vector<State> factor_states(no_factors, State::Active);
+    std::vector<INDEX> active(no_factors); // factors in state Active
+    std::iota(active.begin(), active.end(), 0);
+    std::vector<FactorTypeAdapter*> ilp_factors; // factors in state ILP in order of addition
+    std::vector<INDEX> border; // messages with exactly one factor in state ILP
+    partitioned_external_solver<EXTERNAL_SOLVER> external_solver(graph);
     primals primals_lp(this->f_.begin(), this->f_.end());
     double lower_bound = -std::numeric_limits<double>::infinity();
     double upper_bound = std::numeric_limits<double>::infinity();
@@ -69,21 +80,21 @@ public:
       // optimality checking by modifying the assignment and checking the
       // bounds.
       primals p(this->f_.begin(), this->f_.end());
-      this->for_each_factor([&](auto* f) {
-        assert(factor_states.find(f) != factor_states.end());
-        if (factor_states[f] == State::LP) {
-          assert(decltype(primals_lp)::check_factor_equality(primals_lp, p, f));
+      for (INDEX i = 0; i < no_factors; ++i) {
+        if (factor_states[i] == State::LP) {
+          assert(decltype(primals_lp)::check_factor_equality(primals_lp, p, graph.factor(i)));
         }
-      });
+      }
 
       // Messages inside LP (and ILP if ilp_must_be_consistent set) have to be
       // consistent (messages on borders are always excluded).
-      this->for_each_message([&](auto* m) {
-        auto* l = m->GetLeftFactor(); bool l_in_ilp = external_solver.has_factor(l);
-        auto* r = m->GetRightFactor(); bool r_in_ilp = external_solver.has_factor(r);
+      for (INDEX k = 0; k < graph.no_messages(); ++k) {
+        const auto& m = graph[k];
+        bool l_in_ilp = external_solver.has_factor(m.left);
+        bool r_in_ilp = external_solver.has_factor(m.right);
         if ( (!l_in_ilp && !r_in_ilp) || (ilp_must_be_consistent && l_in_ilp && r_in_ilp) )
-          assert(m->CheckPrimalConsistency());
-      });
+          assert(m.CheckPrimalConsistency());
+      }
     };
 #endif
 
@@ -92,84 +103,82 @@ public:
     //   - moves non-optimal "active" factors into ILP
     //   - checks message consistency on boundary (and moves factors into ILP)
     auto update_partition = [&](primals* primals_ilp) {
-      this->for_each_factor([&](auto* f) {
-        assert(f->LowerBound() <= f->EvaluatePrimal() + eps);
-        assert(factor_states.find(f) != factor_states.end());
-        switch (factor_states[f]) {
-        case State::LP:
-          primals_lp.load_factor(f);
-          break;
-        case State::Active:
-          if (f->LowerBound() < f->EvaluatePrimal() - eps) // not locally optimal
-            external_solver.add_factor(f);
-          break;
-        case State::ILP:
-          if (primals_ilp)
-            primals_ilp->load_factor(f);
-          break;
-        };
-      });
-
-      this->for_each_message([&](auto* m) {
-        if (!m->CheckPrimalConsistency()) { // no factor agreement
-#ifndef NDEBUG
-          bool handled = false;
-#endif
-          std::array<FactorTypeAdapter*, 2> tmp = { m->GetLeftFactor(), m->GetRightFactor() };
-          for (auto* f : tmp) {
-            assert(factor_states.find(f) != factor_states.end());
-            if (factor_states[f] == State::Active) {
-              external_solver.add_factor(f);
-#ifndef NDEBUG
-              handled = true;
-#endif
-            }
+#pragma omp parallel for schedule(guided)
+      for (INDEX i = 0; i < no_factors; ++i) {
+        assert(graph.factor(i)->LowerBound() <= graph.factor(i)->EvaluatePrimal() + eps);
+        if (factor_states[i] == State::LP)
+          primals_lp.load_factor(std::size_t(i));
+      }
+      // primals_ilp holds exactly the factors in state ILP
+      if (primals_ilp)
+        primals_ilp->load_all();
+
+      for (const INDEX i : active) {
+        auto* f = graph.factor(i);
+        if (f->LowerBound() < f->EvaluatePrimal() - eps) // not locally optimal
+          external_solver.add_factor(i);
+      }
+
+      // Only messages of active factors can be inconsistent, as the LP part
+      // has been restored and the ILP part is consistent.
+      for (const INDEX i : active) {
+        for (auto* k = graph.incident_begin(i); k != graph.incident_end(i); ++k) {
+          const auto& m = graph[*k];
+          if (!m.CheckPrimalConsistency()) { // no factor agreement
+            for (const INDEX j : {m.left, m.right})
+              if (factor_states[j] == State::Active)
+                external_solver.add_factor(j);
           }
-          assert(handled);
         }
-      });
+      }
+#ifndef NDEBUG
+      for (INDEX k = 0; k < graph.no_messages(); ++k) {
+        const auto& m = graph[k];
+        assert(m.CheckPrimalConsistency() || factor_states[m.left] == State::Active || factor_states[m.right] == State::Active);
+      }
+#endif
     };
 
-    // Updates the state of labeling. First LP and ILP parts are set and
-    // afterwards the "active" region is computed. Additionally
-    // size_{lp,active,ilp} are set.
+    // Updates the state of labeling: Factors added to the ILP since the last
+    // call are set to ILP and the border and the "active" region are updated
+    // incrementally. Additionally size_{lp,active,ilp} are set.
     auto update_states = [&]() {
-      size_lp = 0; size_active = 0; size_ilp = 0;
-      for (auto* f : this->f_) {
-        assert(factor_states.find(f) != factor_states.end());
-        if (external_solver.has_factor(f)) {
-          factor_states[f] = State::ILP;
-          ++size_ilp;
-        } else {
-          factor_states[f] = State::LP;
-          ++size_lp;
-        }
+      for (INDEX r = ilp_factors.size(); r < external_solver.GetNumberOfFactors(); ++r) {
+        const INDEX i = external_solver.GetFactor(r);
+        factor_states[i] = State::ILP;
+        ilp_factors.push_back(graph.factor(i));
+        border.insert(border.end(), graph.incident_begin(i), graph.incident_end(i));
       }
-      assert(size_lp + size_active + size_ilp == this->f_.size());
-
-      this->for_each_message([&](auto* m) {
-        auto* lf = m->GetLeftFactor();
-        auto* rf = m->GetRightFactor();
-        assert(factor_states.find(lf) != factor_states.end());
-        assert(factor_states.find(rf) != factor_states.end());
-        auto lfs = factor_states[lf];
-        auto rfs = factor_states[rf];
-        if (lfs == State::LP && rfs == State::ILP) {
-          factor_states[lf] = State::Active;
-          --size_lp;
-          ++size_active;
-        } else if (lfs == State::ILP && rfs == State::LP) {
-          factor_states[rf] = State::Active;
-          --size_lp;
-          ++size_active;
+
+      // As the ILP only grows, border messages become inner messages of the
+      // ILP but never return to the border. A message is in the border at most
+      // once, since it is added a second time only together with its removal.
+      border.erase(std::remove_if(border.begin(), border.end(), [&](const INDEX k) {
+        return factor_states[graph[k].left] == State::ILP && factor_states[graph[k].right] == State::ILP;
+      }), border.end());
+
+      // Active factors are the non-ILP factors adjacent to the ILP.
+      for (const INDEX i : active)
+        if (factor_states[i] == State::Active)
+          factor_states[i] = State::LP;
+      active.clear();
+      for (const INDEX k : border) {
+        const auto& m = graph[k];
+        const INDEX j = factor_states[m.left] == State::ILP ? m.right : m.left;
+        assert(factor_states[j] != State::ILP);
+        if (factor_states[j] == State::LP) {
+          factor_states[j] = State::Active;
+          active.push_back(j);
         }
-      });
-      assert(size_lp + size_active + size_ilp == this->f_.size());
+      }
+
+      size_ilp = ilp_factors.size();
+      size_active = active.size();
+      size_lp = no_factors - size_ilp - size_active;
+      assert(size_lp + size_active + size_ilp == no_factors);
     };
 
     // Initialize first ILP subproblem.
-    for (auto* f : this->f_)
-      factor_states[f] = State::Active;
     update_partition(nullptr);
     update_states();
 
@@ -185,14 +194,14 @@ public:
       // on Graphical Models. This should be a huge performance boost as it
       // reduces the number of iterations.
       if (bridge_factor_optimization_arg_.getValue()) {
-        INDEX bridge_count = external_solver.GetNumberOfFactors();
-        this->for_each_factor([&](auto* f) {
-        if (external_solver.has_factor(f))
-          if (f->no_messages() <= 2) // is bridging factor
-            for (auto& msg : f->get_messages())
-              external_solver.add_factor(msg.adjacent_factor);
-        });
-        bridge_count = external_solver.GetNumberOfFactors() - bridge_count;
+        const INDEX no_ilp_factors = external_solver.GetNumberOfFactors();
+        for (INDEX r = 0; r < no_ilp_factors; ++r) {
+          const INDEX i = external_solver.GetFactor(r);
+          if (graph.degree(i) <= 2) // is bridging factor
+            for (auto* k = graph.incident_begin(i); k != graph.incident_end(i); ++k)
+              external_solver.add_factor(graph[*k].other(i));
+        }
+        const INDEX bridge_count = external_solver.GetNumberOfFactors() - no_ilp_factors;
         std::cout << "CombiLP: Added " << bridge_count << " bridge factors." << std::endl;
         update_states();
       }
@@ -200,34 +209,34 @@ public:
       // Reparametrize border: Improves convergence.
       // TODO: Evaluate if this is really necessary and improves convergence
       // significantly.
-      this->for_each_message([&](auto* m) {
-        auto* l = m->GetLeftFactor();
-        auto* r = m->GetRightFactor();
-        if (external_solver.has_factor(l) && !external_solver.has_factor(r))
-          m->send_message_to_left();
-        if (!external_solver.has_factor(l) && external_solver.has_factor(r))
-          m->send_message_to_right();
-      });
+      for (const INDEX k : border) {
+        const auto& m = graph[k];
+        if (factor_states[m.left] == State::ILP)
+          m.send_message_to_left();
+        else
+          m.send_message_to_right();
+      }
 #ifndef NDEBUG
       check_invariant();
 #endif
 
       // Add messages connecting all factors in the ILP.
-      external_solver.add_messages(*this);
+      external_solver.add_messages();
 
       ++iteration;
       std::cout << std::endl << "CombiLP iteration " << iteration << ": "
                 << "lp=" << size_lp << " "
                 << "active=" << size_active << " "
                 << "ilp=" << size_ilp << " / "
-                << this->GetNumberOfFactors() << " ("
-                << (100.0f * size_ilp / this->GetNumberOfFactors())
-                << "%)" << std::endl;
+                << no_factors << " ("
+                << (100.0f * size_ilp / no_factors)
+                << "%), " << external_solver.GetNumberOfComponents()
+                << " components" << std::endl;
 
       const bool solved = external_solver.solve();
       if (!solved)
         throw std::runtime_error("External solver failed to solve the problem.");
-      primals primals_ilp(this->f_.begin(), this->f_.end());
+      primals primals_ilp(ilp_factors.begin(), ilp_factors.end());
 #ifndef NDEBUG
       check_invariant(true);
 #endif
@@ -244,9 +253,8 @@ public:
       // `UnarySimplexFactor`). This will be fixed in `update_partition` (LP
       // part gets restored, "active" part of LP remains modified, as
       // optimality is checked by comparing bounds).
-      for (auto* f : this->f_)
-        if (external_solver.has_factor(f))
-          f->propagate_primal_through_messages();
+      for (auto* f : ilp_factors)
+        f->propagate_primal_through_messages();
 #ifndef NDEBUG
       this->for_each_message([&](auto* m) { assert(m->CheckPrimalConsistency()); });
 #endif
@@ -283,10 +291,9 @@ public:
     // checked. Additionally to the normal `check_invariant` we just make sure
     // that the LP+Active region is really locally optimal.
     check_invariant(true);
-    for (auto* f : this->f_) {
-      assert(factor_states.find(f) != factor_states.end());
-      if (factor_states[f] != State::ILP)
-        assert(std::abs(f->LowerBound() - f->EvaluatePrimal()) <= eps);
+    for (INDEX i = 0; i < no_factors; ++i) {
+      if (factor_states[i] != State::ILP)
+        assert(std::abs(graph.factor(i)->LowerBound() - graph.factor(i)->EvaluatePrimal()) <= eps);
     }
 #endif
   }
@@ -11,6 +11,7 @@
 #include <cassert>
 #include <limits>
 #include "tclap/CmdLine.h"
+#include "solver_phase.hxx"
 
 #define SIMDPP_ARCH_X86_AVX2
 #include "simdpp/simd.h"
@@ -104,6 +105,9 @@ namespace LP_MP {
       bool error = false;
       INDEX tightenConstraints = 0; // when given as return type, indicates how many constraints are to be added. When given as parameter to visitor, indicates how many were added.
       REAL tightenMinDualIncrease = 0.0; // do zrobienia: obsolete
+      REAL tightenTimeBudget = std::numeric_limits<REAL>::infinity(); // maximal time in seconds to spend in separation when tightening
+      std::size_t memoryHeadroom = std::numeric_limits<std::size_t>::max(); // bytes that may still be allocated before the memory budget is approached, 0 under memory pressure. Tightening is restricted accordingly.
+      solver_phase_times phaseTime = {}; // when given as parameter to visitor: seconds spent in each phase during the last iteration. The visitor phase refers to the previous call of the visitor.
    };
 
 
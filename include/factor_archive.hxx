@@ -2,6 +2,11 @@
 #define LP_MP_factor_archive_HXX
 
 #include <unordered_map>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
+#include "serialization.hxx"
 
 namespace LP_MP {
 
@@ -30,32 +35,71 @@ public:
 
   factor_archive() { }
 
+  // Each factor gets a contiguous chunk of the archive. Offsets are computed by a prefix sum over the per-factor sizes, after which all chunks are written concurrently.
   template<typename FACTOR_ITERATOR>
   factor_archive(FACTOR_ITERATOR begin, FACTOR_ITERATOR end)
+  : factors_(begin, end)
   {
-    allocate_archive aa;
-    for (auto it = begin; it != end; ++it) {
-      factor_to_index_.insert(std::make_pair(*it, aa.size()));
-      functor(*it, aa);
+    offsets_.resize(factors_.size()+1);
+    offsets_[0] = 0;
+#pragma omp parallel for schedule(guided)
+    for (std::size_t i = 0; i < factors_.size(); ++i) {
+      SERIALIZATON_FUNCTOR fun;
+      allocate_archive aa;
+      fun(factors_[i], aa);
+      offsets_[i+1] = aa.size();
     }
-    archive_.aquire_memory(aa.size());
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
 
-    save_archive sa(archive_);
-    for (auto it = begin; it != end; ++it) {
-      functor(*it, sa);
+    archive_.aquire_memory(offsets_.back());
+    save_all();
+  }
+
+  // (re)write all factors into the archive in parallel
+  void save_all() {
+#pragma omp parallel for schedule(guided)
+    for (std::size_t i = 0; i < factors_.size(); ++i) {
+      access<save_archive>(i);
+    }
+  }
+
+  // restore all factors from the archive in parallel
+  void load_all() {
+#pragma omp parallel for schedule(guided)
+    for (std::size_t i = 0; i < factors_.size(); ++i) {
+      access<load_archive>(i);
     }
   }
 
+  std::size_t size() const { return archive_.size(); }
+  char* data() const { return archive_.data(); }
+  std::size_t no_factors() const { return factors_.size(); }
+
+  // whether the archive was built for exactly the given factors, i.e. save_all/load_all can be used instead of rebuilding
+  template<typename FACTOR_ITERATOR>
+  bool matches(FACTOR_ITERATOR begin, FACTOR_ITERATOR end) const {
+    return std::equal(factors_.begin(), factors_.end(), begin, end);
+  }
+
   // FIXME: LP does not implement this interface.
   //factor_archive(LP &lp)
   //: factor_archive(lp.begin(), lp.end()) { }
 
   void load_factor(FactorTypeAdapter* f) {
-    access<load_archive>(f);
+    access<load_archive>(index(f));
   }
 
   void save_factor(FactorTypeAdapter* f) {
-    access<save_archive>(f);
+    access<save_archive>(index(f));
+  }
+
+  // access by position in the factor range the archive was built from, without a lookup of the factor
+  void load_factor(const std::size_t i) {
+    access<load_archive>(i);
+  }
+
+  void save_factor(const std::size_t i) {
+    access<save_archive>(i);
   }
 
   bool operator==(const factor_archive_type& rhs) const {
@@ -63,36 +107,60 @@ public:
   }
 
   static bool check_factor_equality(factor_archive_type& fa1, factor_archive_type& fa2, FactorTypeAdapter *f) {
-    if (fa1.factor_to_index_.find(f) == fa1.factor_to_index_.end() ||
-        fa2.factor_to_index_.find(f) == fa2.factor_to_index_.end())
+    const auto& index1 = fa1.factor_to_index();
+    const auto& index2 = fa2.factor_to_index();
+    auto it1 = index1.find(f);
+    auto it2 = index2.find(f);
+    if (it1 == index1.end() || it2 == index2.end())
     {
       return false;
     }
 
-    SERIALIZATON_FUNCTOR functor;
-    allocate_archive aa;
-    functor(f, aa);
-
-    fa1.archive_.reset_cur();
-    fa1.archive_.advance(fa1.factor_to_index_[f]);
-
-    fa2.archive_.reset_cur();
-    fa2.archive_.advance(fa1.factor_to_index_[f]);
+    const std::size_t size1 = fa1.chunk_size(it1->second);
+    const std::size_t size2 = fa2.chunk_size(it2->second);
+    if (size1 != size2) {
+      return false;
+    }
 
-    return std::memcmp(fa1.archive_.cur_address(), fa2.archive_.cur_address(), aa.size()) == 0;
+    return std::memcmp(fa1.chunk(it1->second), fa2.chunk(it2->second), size1) == 0;
   }
 
 private:
-  SERIALIZATON_FUNCTOR functor;
   serialization_archive archive_;
-  std::unordered_map<FactorTypeAdapter*, INDEX> factor_to_index_;
+  std::vector<FactorTypeAdapter*> factors_;
+  std::vector<std::size_t> offsets_; // factor i occupies bytes [offsets_[i], offsets_[i+1])
+  mutable std::unordered_map<FactorTypeAdapter*, std::size_t> factor_to_index_; // built on first (non-concurrent) lookup by factor address
+
+  const std::unordered_map<FactorTypeAdapter*, std::size_t>& factor_to_index() const {
+    if (factor_to_index_.size() != factors_.size()) {
+      factor_to_index_.reserve(factors_.size());
+      for (std::size_t i = 0; i < factors_.size(); ++i) {
+        factor_to_index_.insert(std::make_pair(factors_[i], i));
+      }
+    }
+    return factor_to_index_;
+  }
+
+  std::size_t index(FactorTypeAdapter* f) const {
+    assert(factor_to_index().find(f) != factor_to_index().end());
+    return factor_to_index().find(f)->second;
+  }
 
+  char* chunk(const std::size_t i) const { return archive_.data() + offsets_[i]; }
+  std::size_t chunk_size(const std::size_t i) const { return offsets_[i+1] - offsets_[i]; }
+
+  // operates on a view of the factor's chunk only, hence distinct factors can be accessed concurrently
   template<typename ARCHIVE>
-  void access(FactorTypeAdapter* f) {
-    assert(factor_to_index_.find(f) != factor_to_index_.end());
-    ARCHIVE a(archive_);
-    archive_.advance(factor_to_index_[f]);
-    functor(f, a);
+  void access(const std::size_t i) {
+    assert(i < factors_.size());
+    if (chunk_size(i) == 0) {
+      return;
+    }
+    serialization_archive view(chunk(i), chunk_size(i));
+    ARCHIVE a(view);
+    SERIALIZATON_FUNCTOR fun;
+    fun(factors_[i], a);
+    assert(view.cur_address() == chunk(i) + chunk_size(i));
   }
 };
 
@@ -289,27 +289,32 @@ public:
 
    // return two possible variable states
    // branch on current primal vs. not current primal
-   void branch_left()
+   // With implicit origin the zero labeling always has cost 0 and cannot be forbidden, hence such factors are not branched on.
+   bool can_branch() const
    {
-      // set cost of label associated not with primal to infinity, i.e. current label should always be taken
+      return !has_implicit_origin() && EvaluatePrimal() < std::numeric_limits<REAL>::infinity();
+   }
+
+   void branch_left(const REAL penalty)
+   {
+      assert(can_branch());
+      // penalize labelings not associated with primal, i.e. current label should always be taken
       const INDEX labeling_no = LABELINGS::matching_labeling(primal_);
       assert(labeling_no < this->size());
       for(INDEX i=0; i<this->size(); ++i) {
-         (*this)[i] = std::numeric_limits<REAL>::infinity(); 
+         if(i != labeling_no) {
+            (*this)[i] += penalty;
+         }
       }
-      // also the zero labeling must be forbidden. How to do? IMPLICIT_ORIGIN must be dropped for this.
-      assert(false);
-      assert(!has_implicit_origin());
    }
 
-   void branch_right()
+   void branch_right(const REAL penalty)
    {
-      // set cost of primal label to infinity
-      assert(EvaluatePrimal() < std::numeric_limits<REAL>::infinity());
+      assert(can_branch());
+      // penalize primal label
       const INDEX labeling_no = LABELINGS::matching_labeling(primal_);
       assert(labeling_no < this->size());
-      (*this)[labeling_no] = std::numeric_limits<REAL>::infinity();
-      assert(LowerBound() < std::numeric_limits<REAL>::infinity());
+      (*this)[labeling_no] += penalty;
    }
 
    auto& primal() { return primal_; }
@@ -78,6 +78,10 @@ LP_MP_FUNCTION_EXISTENCE_CLASS(has_apply, apply)
 
 LP_MP_FUNCTION_EXISTENCE_CLASS(has_create_constraints, create_constraints)
 
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_branch_left, branch_left)
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_branch_right, branch_right)
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_can_branch, can_branch)
+
 LP_MP_ASSIGNMENT_FUNCTION_EXISTENCE_CLASS(IsAssignable, operator[])
 }
 
@@ -193,6 +197,7 @@ template<class MSG_CONTAINER, template<typename> class FuncGetter>
 struct MessageDispatcher
 {
    using ConnectedFactorType = typename FuncGetter<MSG_CONTAINER>::ConnectedFactorType; // this is the type of factor container to which the message is connected
+   using MessageContainerType = MSG_CONTAINER;
 
    static void ReceiveMessage(MSG_CONTAINER& t)
    {
@@ -1034,6 +1039,7 @@ public:
    RepamLeft(const ARRAY& m)
    { 
       //assert(false); // no -+ distinguishing
+      leftFactor_->reparametrized();
       if constexpr(CanBatchRepamLeft<ARRAY>()) {
             msg_op_.RepamLeft(*(leftFactor_->GetFactor()), m);
       } else {
@@ -1065,6 +1071,7 @@ public:
    //typename std::enable_if<IsAssignable == true>::type
    void
    RepamLeft(const REAL diff, const INDEX dim) {
+      leftFactor_->reparametrized();
       msg_op_.RepamLeft(*(leftFactor_->GetFactor()), diff, dim); // note: in right, we reparametrize by +diff, here by -diff
    }
    /*
@@ -1088,6 +1095,7 @@ public:
    RepamRight(const ARRAY& m)
    { 
       //assert(false); // no -+ distinguishing
+      rightFactor_->reparametrized();
       if constexpr(CanBatchRepamRight<ARRAY>()) {
             msg_op_.RepamRight(*(rightFactor_->GetFactor()), m);
       } else {
@@ -1119,6 +1127,7 @@ public:
    //typename std::enable_if<IsAssignable == true>::type
    void
    RepamRight(const REAL diff, const INDEX dim) {
+      rightFactor_->reparametrized();
       msg_op_.RepamRight(*(rightFactor_->GetFactor()), diff, dim);
    }
    /*
@@ -1586,6 +1595,8 @@ public:
     }
 
     static constexpr std::size_t capacity() { return N; }
+    // messages are held in place, hence they cannot be removed individually
+    static constexpr bool links_messages() { return false; }
 
     template<typename LEFT_FACTOR, typename RIGHT_FACTOR, typename ...ARGS>
     MESSAGE_CONTAINER_TYPE* push_back(LEFT_FACTOR* l, RIGHT_FACTOR* r, ARGS... args) {
@@ -1720,6 +1731,7 @@ public:
     }
 
     void set_next_message(MESSAGE_CONTAINER_TYPE* m) {}
+    static constexpr bool links_messages() { return false; }
 
     std::size_t size() const
     {
@@ -1888,6 +1900,33 @@ public:
         }
     }
 
+    // messages are held by the adjacent factors and only linked here, hence they can be unlinked when the adjacent factor is removed
+    static constexpr bool links_messages() { return true; }
+
+    void remove(MESSAGE_CONTAINER_TYPE* m)
+    {
+        assert(m != nullptr && ptr != nullptr);
+        auto next = [](MESSAGE_CONTAINER_TYPE* p) {
+            if constexpr(CHIRALITY == Chirality::left) { return p->next_left_msg(); }
+            else { return p->next_right_msg(); }
+        };
+        auto set_next = [](MESSAGE_CONTAINER_TYPE* p, MESSAGE_CONTAINER_TYPE* n) {
+            if constexpr(CHIRALITY == Chirality::left) { p->set_next_left_msg(n); }
+            else { p->set_next_right_msg(n); }
+        };
+
+        if(ptr == m) {
+            ptr = next(m);
+            return;
+        }
+        auto* p = ptr;
+        while(next(p) != m) {
+            p = next(p);
+            assert(p != nullptr);
+        }
+        set_next(p, next(m));
+    }
+
 
     class iterator {
       public:
@@ -1914,9 +1953,9 @@ public:
     auto begin() const { return iterator(ptr); }
     auto end() const { return iterator(nullptr); }
 
-    bool empty() const { return ptr != nullptr; }
+    bool empty() const { return ptr == nullptr; }
 private:
-    MESSAGE_CONTAINER_TYPE* ptr;
+    MESSAGE_CONTAINER_TYPE* ptr = nullptr;
 };
 
 // N=0 means variable number of messages, > 0 means compile time fixed number of messages and <0 means at most compile time number of messages
@@ -2067,6 +2106,84 @@ public:
        std::get<n>(msg_).set_next_message(m); 
    }
 
+   // unlink message m, which is held by the factor on the other side, from this factor
+   template<typename MESSAGE_CONTAINER_TYPE, Chirality CHIRALITY>
+   void remove_message(MESSAGE_CONTAINER_TYPE* m)
+   {
+       using message_dispatcher = std::conditional_t<CHIRALITY == Chirality::left, MessageDispatcher<MESSAGE_CONTAINER_TYPE, LeftMessageFuncGetter>, MessageDispatcher<MESSAGE_CONTAINER_TYPE, RightMessageFuncGetter>>;
+       constexpr INDEX n = FactorContainerType::FindMessageDispatcherTypeIndex<message_dispatcher>();
+       std::get<n>(msg_).remove(m);
+   }
+
+   // A factor can be removed if it holds all its messages itself and adjacent factors only link to them, e.g. triplets added in tightening.
+   template<typename MESSAGE_DISPATCHER_TYPE>
+   static constexpr bool adjacent_factor_links_messages()
+   {
+       using message_container_type = typename MESSAGE_DISPATCHER_TYPE::MessageContainerType;
+       using adjacent_factor_type = typename MESSAGE_DISPATCHER_TYPE::ConnectedFactorType;
+       using adjacent_dispatcher = std::conditional_t<MESSAGE_DISPATCHER_TYPE::get_chirality() == Chirality::left, MessageDispatcher<message_container_type, RightMessageFuncGetter>, MessageDispatcher<message_container_type, LeftMessageFuncGetter>>;
+       using adjacent_storage_type = meta::at_c<typename adjacent_factor_type::msg_container_type_list, adjacent_factor_type::template FindMessageDispatcherTypeIndex<adjacent_dispatcher>()>;
+       return adjacent_storage_type::links_messages();
+   }
+   template<typename... MESSAGE_DISPATCHER_TYPES>
+   static constexpr bool adjacent_factors_link_messages(meta::list<MESSAGE_DISPATCHER_TYPES...>)
+   {
+       return (adjacent_factor_links_messages<MESSAGE_DISPATCHER_TYPES>() && ...);
+   }
+
+   virtual bool can_remove() const final { return adjacent_factors_link_messages(MESSAGE_DISPATCHER_TYPELIST{}); }
+
+   virtual void unlink_messages() final
+   {
+       if constexpr(adjacent_factors_link_messages(MESSAGE_DISPATCHER_TYPELIST{})) {
+           meta::for_each(MESSAGE_DISPATCHER_TYPELIST{}, [&](auto l) {
+                   using message_dispatcher = decltype(l);
+                   using message_container_type = typename message_dispatcher::MessageContainerType;
+                   constexpr INDEX n = FactorContainerType::FindMessageDispatcherTypeIndex<message_dispatcher>();
+                   constexpr Chirality adjacent_chirality = message_dispatcher::get_chirality() == Chirality::left ? Chirality::right : Chirality::left;
+                   for(auto it = std::get<n>(msg_).begin(); it != std::get<n>(msg_).end(); ++it) {
+                       l.get_adjacent_factor(*it)->template remove_message<message_container_type, adjacent_chirality>(&*it);
+                   }
+           });
+       } else {
+           throw std::runtime_error("factor cannot be removed, its messages are held by adjacent factors");
+       }
+   }
+
+   constexpr static bool can_branch_constexpr()
+   {
+      return FunctionExistence::has_branch_left<FactorType, void, REAL>() && FunctionExistence::has_branch_right<FactorType, void, REAL>();
+   }
+
+   virtual bool can_branch() const final
+   {
+      if constexpr(can_branch_constexpr()) {
+         if constexpr(FunctionExistence::has_can_branch<const FactorType, bool>()) {
+            return factor_.can_branch();
+         }
+         return true;
+      }
+      return false;
+   }
+
+   virtual void branch_left(const REAL penalty) final
+   {
+      if constexpr(can_branch_constexpr()) {
+         factor_.branch_left(penalty);
+      } else {
+         throw std::runtime_error("factor does not support branching");
+      }
+   }
+
+   virtual void branch_right(const REAL penalty) final
+   {
+      if constexpr(can_branch_constexpr()) {
+         factor_.branch_right(penalty);
+      } else {
+         throw std::runtime_error("factor does not support branching");
+      }
+   }
+
    //template<typename MESSAGE_DISPATCHER_TYPE, typename MESSAGE_TYPE> 
    //void AddMessage(MESSAGE_TYPE* m) { 
    //   constexpr INDEX n = FactorContainerType::FindMessageDispatcherTypeIndex<MESSAGE_DISPATCHER_TYPE>();
@@ -2970,7 +3087,7 @@ public:
    }
 
    virtual void serialize_dual(load_archive& ar) final
-   { factor_.serialize_dual(ar); }
+   { factor_.serialize_dual(ar); reparametrized(); }
    virtual void serialize_primal(load_archive& ar) final
    { factor_.serialize_primal(ar); } 
    virtual void serialize_dual(save_archive& ar) final
@@ -2982,7 +3099,7 @@ public:
    virtual void serialize_primal(allocate_archive& ar) final
    { factor_.serialize_primal(ar); } 
    virtual void serialize_dual(addition_archive& ar) final
-   { factor_.serialize_dual(ar); }
+   { factor_.serialize_dual(ar); reparametrized(); }
 
    // returns size in bytes
    virtual INDEX dual_size() final
@@ -3002,6 +3119,7 @@ public:
    {
       arithmetic_archive<operation::division> ar(val);
       factor_.serialize_dual(ar);
+      reparametrized();
    }
 
    virtual INDEX primal_size_in_bytes() final
@@ -3026,6 +3144,11 @@ public:
    FactorType* GetFactor() const { return &factor_; }
    FactorType* GetFactor() { return &factor_; }
 
+   // counts changes of the reparametrization, so that quantities derived from it need only be recomputed for factors whose generation changed.
+   // Messages and dual archives count automatically, code writing to the factor through GetFactor() must call reparametrized() itself.
+   std::size_t reparametrization_generation() const { return reparametrization_generation_; }
+   void reparametrized() { ++reparametrization_generation_; }
+
   template<typename MESSAGE_TYPE>
   constexpr static 
   INDEX get_message_number()
@@ -3060,6 +3183,7 @@ public:
    
 protected:
    FactorType factor_; // the factor operation
+   std::size_t reparametrization_generation_ = 0;
 public:
    INDEX primal_access_ = 0; // counts when primal was accessed last, do zrobienia: make setter and getter for clean interface or make MessageContainer a friend
 
@@ -20,8 +20,10 @@ namespace LP_MP {
 
    };
 
+   // descending w.r.t. cost, ties are broken by indices. Being a total order, sorting results are deterministic irrespective of input order.
    inline bool operator<(const triplet_candidate& l, const triplet_candidate& r) {
-      return l.cost > r.cost;
+      if(l.cost != r.cost) { return l.cost > r.cost; }
+      return std::make_tuple(l.i, l.j, l.k) < std::make_tuple(r.i, r.j, r.k);
    }
    inline bool operator==(const triplet_candidate& l, const triplet_candidate& r) {
       return l.i == r.i && l.j == r.j && l.k == r.k;
@@ -110,6 +112,14 @@ namespace LP_MP {
          }
       }
 
+      // whether outgoing arcs of all nodes are descending w.r.t. cost, e.g. when edges were added in that order
+      bool is_sorted() const
+      {
+         return std::all_of(nodes_.begin(), nodes_.end(), [](const node& n) {
+               return std::is_sorted(n.begin(), n.end(), [](const arc& a, const arc& b) { return a.cost > b.cost; });
+         });
+      }
+
       private:
          std::vector<node> nodes_;
          std::vector<arc> arcs_;
@@ -204,7 +214,7 @@ namespace LP_MP {
             assert(g[i].begin() < g[i].end());
 
             if(Labelled1(i)) {
-               for(auto* a=g[i].begin(); a->cost>=th && a!=g[i].end(); ++a) { 
+               for(auto* a=g[i].begin(); a!=g[i].end() && a->cost>=th; ++a) { 
                   auto* head = a->head;
                   const INDEX j = g[head];
 
@@ -224,7 +234,7 @@ namespace LP_MP {
                }
             } else {
                assert(Labelled2(i));
-               for(auto* a=g[i].begin(); a->cost>=th && a!=g[i].end(); ++a) { 
+               for(auto* a=g[i].begin(); a!=g[i].end() && a->cost>=th; ++a) { 
                   auto* head = a->head;
                   const INDEX j = g[head];
 
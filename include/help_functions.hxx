@@ -12,6 +12,9 @@
 #include <cstring>
 
 #include <libgen.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace LP_MP {
 
@@ -208,8 +211,44 @@ class InputIt1, class InputIt2, class OutputIt, class Compare, class Merge >
    return d_first;
 }
 
+// sort chunks concurrently and merge them pairwise. For a strict total order comp the result equals that of std::sort, independently of the number of threads.
+template<typename ITERATOR, typename COMPARE>
+void parallel_sort(ITERATOR begin, ITERATOR end, COMPARE comp)
+{
+   const std::size_t n = std::distance(begin, end);
+#ifdef _OPENMP
+   const std::size_t no_chunks = std::min(std::size_t(omp_get_max_threads()), n/1024 + 1);
+#else
+   const std::size_t no_chunks = 1;
+#endif
+   if(no_chunks <= 1) {
+      std::sort(begin, end, comp);
+      return;
+   }
 
+   std::vector<std::size_t> bounds(no_chunks+1);
+   for(std::size_t c=0; c<=no_chunks; ++c) {
+      bounds[c] = c*n/no_chunks;
+   }
+#pragma omp parallel for schedule(static,1)
+   for(std::size_t c=0; c<no_chunks; ++c) {
+      std::sort(begin + bounds[c], begin + bounds[c+1], comp);
+   }
+   for(std::size_t width=1; width<no_chunks; width*=2) {
+#pragma omp parallel for schedule(static,1)
+      for(std::size_t c=0; c<no_chunks; c+=2*width) {
+         if(c+width < no_chunks) {
+            std::inplace_merge(begin + bounds[c], begin + bounds[c+width], begin + bounds[std::min(c+2*width, no_chunks)], comp);
+         }
+      }
+   }
+}
 
+template<typename ITERATOR>
+void parallel_sort(ITERATOR begin, ITERATOR end)
+{
+   parallel_sort(begin, end, std::less<typename std::iterator_traits<ITERATOR>::value_type>());
+}
 
 } // end namespace LP_MP
 
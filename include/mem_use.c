@@ -34,10 +34,10 @@ inline size_t memory_used (bool resident=false)
     size_t size = 0;
     std::ifstream file{"/proc/self/statm"};
     if (file) {
-        unsigned long vm = 0;
-        file >> vm;
+        unsigned long vm = 0, rss = 0;
+        file >> vm >> rss;
        file.close();
-       size = (size_t)vm * getpagesize();
+       size = (size_t)(resident ? rss : vm) * getpagesize();
     }
     return size;
 
@@ -701,6 +701,16 @@ std::array<block_allocator<REAL>, no_stack_allocators> make_block_allocator_arra
 static std::array<block_allocator<REAL>, no_stack_allocators> global_real_block_allocator_array ( make_block_allocator_array(global_real_block_arena_array, std::make_integer_sequence<size_t,no_stack_allocators>{} ) ) ;
 
 static thread_local INDEX stack_allocator_index = 0;
+
+// bytes currently reserved by the global arenas, reported next to the resident set size when enforcing memory budgets
+inline std::size_t arena_memory_reserved()
+{
+  std::size_t m = global_real_block_arena.mem_reserved() + std::size_t(global_real_stack_arena.size())*sizeof(int);
+  for(const auto& a : global_real_block_arena_array) {
+    m += a.mem_reserved();
+  }
+  return m;
+}
 // do zrobienia: both above allocators do not destroy their arenas
 } // end namespace LP_MP
 
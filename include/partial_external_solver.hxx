@@ -4,12 +4,23 @@
 #include "DD_ILP.hxx"
 #include "LP_MP.h"
 #include "external_solver_interface.hxx"
+#include "factor_archive.hxx"
+#include "union_find.hxx"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
 
 namespace LP_MP {
 
 // This class mimics an `LP_MP::LP` but does not inherit from it. This allows
 // reusing the very same factors and messages and computing their primal values
 // with an external solver.
+//
+// The model is built incrementally: constraints are emitted once for every
+// factor and message when it is added. Costs are loaded into the existing
+// model and only when they have changed, hence repeated calls to `solve` after
+// growing the region do not rebuild the model.
 template<typename EXTERNAL_SOLVER>
 class partial_external_solver {
 public:
@@ -26,55 +37,37 @@ public:
     }
   }
 
+  // Every message must be added once only, after both of its factors.
   template<typename MESSAGE_CONTAINER_TYPE>
   void add_message(MESSAGE_CONTAINER_TYPE* m) {
-    if (!has_message(m)) {
-      dirty_ = true;
-      auto* l = m->GetLeftFactor();
-      auto* r = m->GetRightFactor();
-      assert(has_factor(l) && has_factor(r));
-      auto li = factor_address_to_index_[l];
-      auto ri = factor_address_to_index_[r];
-      m->construct_constraints(s_, external_variable_counter_[li], external_variable_counter_[ri]);
-    }
-  }
-
-  template<class LP_TYPE>
-  void add_messages(const LP_TYPE &LP) {
-    LP.for_each_message([this](auto* m) {
-      if (has_factor(m->GetLeftFactor()) && has_factor(m->GetRightFactor()))
-        add_message(m);
-    });
+    dirty_ = true;
+    auto l = factor_address_to_index_.find(m->GetLeftFactor());
+    auto r = factor_address_to_index_.find(m->GetRightFactor());
+    assert(l != factor_address_to_index_.end() && r != factor_address_to_index_.end());
+    ++no_messages_;
+    m->construct_constraints(s_, external_variable_counter_[l->second], external_variable_counter_[r->second]);
   }
 
   bool has_factor(FactorTypeAdapter* f) {
     return factor_address_to_index_.find(f) != factor_address_to_index_.end();
   }
 
-  bool has_message(AbstractMessageContainer* m) {
-    return m_.find(m) != m_.end();
-  }
-
   INDEX GetNumberOfFactors() const { return f_.size(); }
-  INDEX GetNumberOfMessages() const { return f_.size(); }
+  INDEX GetNumberOfMessages() const { return no_messages_; }
 
+  // Re-solves only if the model or its costs changed. The primal solution is
+  // written back to the factors in any case.
   bool solve() {
-    bool result = true;
-
-    if (dirty_) {
-      s_.init_variable_loading();
-      for (auto* f : f_)
-        f->load_costs(s_);
-      result = s_.solve();
-
-      s_.init_variable_loading();
-      for (auto* f : f_)
-        f->convert_primal(s_);
-
+    if (load_costs() || dirty_) {
+      solved_ = s_.solve();
       dirty_ = false;
     }
 
-    return result;
+    s_.init_variable_loading();
+    for (auto* f : f_)
+      f->convert_primal(s_);
+
+    return solved_;
   }
 
   void write_to_file(const std::string& filename) {
@@ -87,12 +80,246 @@ public:
   bool dirty () const { return dirty_; }
 
 private:
+  // Loads costs into the model if a factor was added or a reparametrization
+  // changed since the last call. Returns whether costs were loaded.
+  bool load_costs() {
+    auto costs = std::make_unique<factor_archive<serialization_functor::dual>>(f_.begin(), f_.end());
+    if (loaded_costs_ && loaded_costs_->matches(f_.begin(), f_.end()) && *costs == *loaded_costs_)
+      return false;
+
+    s_.init_variable_loading();
+    for (auto* f : f_)
+      f->load_costs(s_);
+    loaded_costs_ = std::move(costs);
+    return true;
+  }
+
   DD_ILP::external_solver_interface<EXTERNAL_SOLVER> s_;
   std::vector<FactorTypeAdapter*> f_;
-  std::unordered_set<AbstractMessageContainer*> m_;
+  INDEX no_messages_ = 0;
   std::unordered_map<FactorTypeAdapter*, INDEX> factor_address_to_index_;
   std::vector<typename DD_ILP::variable_counters> external_variable_counter_;
-  bool dirty_;
+  std::unique_ptr<factor_archive<serialization_functor::dual>> loaded_costs_;
+  bool dirty_ = false;
+  bool solved_ = true; // result of the last call to the external solver
+};
+
+// A message of an LP with dense indices of its factors. The message type is
+// erased, such that messages of all types can be held in one array.
+template<typename EXTERNAL_SOLVER>
+class indexed_message {
+public:
+  template<typename MESSAGE_CONTAINER_TYPE>
+  indexed_message(MESSAGE_CONTAINER_TYPE* m, const INDEX left, const INDEX right)
+  : left(left), right(right), m_(m), ops_(operations_of<MESSAGE_CONTAINER_TYPE>()) { }
+
+  INDEX other(const INDEX i) const { assert(i == left || i == right); return i == left ? right : left; }
+
+  bool CheckPrimalConsistency() const { return ops_->check_primal_consistency(m_); }
+  void send_message_to_left() const { ops_->send_message_to_left(m_); }
+  void send_message_to_right() const { ops_->send_message_to_right(m_); }
+  void add_to(partial_external_solver<EXTERNAL_SOLVER>& s) const { ops_->add_to(m_, s); }
+
+  INDEX left, right;
+
+private:
+  struct operations {
+    bool (*check_primal_consistency)(void*);
+    void (*send_message_to_left)(void*);
+    void (*send_message_to_right)(void*);
+    void (*add_to)(void*, partial_external_solver<EXTERNAL_SOLVER>&);
+  };
+
+  template<typename MESSAGE_CONTAINER_TYPE>
+  static const operations* operations_of() {
+    using M = MESSAGE_CONTAINER_TYPE;
+    static const operations o = {
+      [](void* m) { return static_cast<M*>(m)->CheckPrimalConsistency(); },
+      [](void* m) { static_cast<M*>(m)->send_message_to_left(); },
+      [](void* m) { static_cast<M*>(m)->send_message_to_right(); },
+      [](void* m, partial_external_solver<EXTERNAL_SOLVER>& s) { s.add_message(static_cast<M*>(m)); }
+    };
+    return &o;
+  }
+
+  void* m_;
+  const operations* ops_;
+};
+
+// All messages of an LP with dense factor indices (as in `LP::GetFactor`) and
+// the messages incident to every factor. Allows traversing neighborhoods of
+// factors without hash lookups.
+template<typename EXTERNAL_SOLVER>
+class indexed_message_graph {
+public:
+  using message = indexed_message<EXTERNAL_SOLVER>;
+
+  template<class LP_TYPE>
+  indexed_message_graph(const LP_TYPE& LP) {
+    f_.reserve(LP.GetNumberOfFactors());
+    std::unordered_map<FactorTypeAdapter*, INDEX> factor_address_to_index;
+    factor_address_to_index.reserve(LP.GetNumberOfFactors());
+    for (INDEX i = 0; i < LP.GetNumberOfFactors(); ++i) {
+      f_.push_back(LP.GetFactor(i));
+      factor_address_to_index.insert(std::make_pair(f_.back(), i));
+    }
+
+    std::vector<INDEX> degree(f_.size(), 0);
+    LP.for_each_message([&](auto* m) {
+      const INDEX l = factor_address_to_index.find(m->GetLeftFactor())->second;
+      const INDEX r = factor_address_to_index.find(m->GetRightFactor())->second;
+      m_.push_back(message(m, l, r));
+      ++degree[l];
+      ++degree[r];
+    });
+
+    incident_offsets_.resize(f_.size()+1);
+    incident_offsets_[0] = 0;
+    std::partial_sum(degree.begin(), degree.end(), incident_offsets_.begin()+1);
+    incident_.resize(incident_offsets_.back());
+    for (INDEX k = 0; k < m_.size(); ++k) {
+      incident_[incident_offsets_[m_[k].left+1] - degree[m_[k].left]--] = k;
+      incident_[incident_offsets_[m_[k].right+1] - degree[m_[k].right]--] = k;
+    }
+  }
+
+  INDEX no_factors() const { return f_.size(); }
+  INDEX no_messages() const { return m_.size(); }
+  FactorTypeAdapter* factor(const INDEX i) const { return f_[i]; }
+  const message& operator[](const INDEX k) const { return m_[k]; }
+
+  // indices of the messages incident to factor i
+  const INDEX* incident_begin(const INDEX i) const { return incident_.data() + incident_offsets_[i]; }
+  const INDEX* incident_end(const INDEX i) const { return incident_.data() + incident_offsets_[i+1]; }
+  INDEX degree(const INDEX i) const { return incident_offsets_[i+1] - incident_offsets_[i]; }
+
+private:
+  std::vector<FactorTypeAdapter*> f_;
+  std::vector<message> m_;
+  std::vector<INDEX> incident_offsets_;
+  std::vector<INDEX> incident_;
+};
+
+// Solves a region of factors of an `indexed_message_graph` as independent
+// subproblems, one for every connected component w.r.t. the messages with
+// both endpoints in the region. Components are solved in parallel, each by
+// its own `partial_external_solver`. Since the region only grows, every
+// component of the previous call is contained in one current component. The
+// subproblem of the largest such component is kept and extended by the
+// remaining factors and messages, hence subproblems are built incrementally
+// and the solution of unchanged components is reused unless costs changed.
+template<typename EXTERNAL_SOLVER>
+class partitioned_external_solver {
+public:
+  partitioned_external_solver(const indexed_message_graph<EXTERNAL_SOLVER>& graph)
+  : graph_(graph), region_index_(graph.no_factors(), not_in_region) { }
+
+  void add_factor(const INDEX i) {
+    if (!has_factor(i)) {
+      dirty_ = true;
+      region_index_[i] = f_.size();
+      f_.push_back(i);
+    }
+  }
+
+  bool has_factor(const INDEX i) const { return region_index_[i] != not_in_region; }
+
+  // index of the r-th factor added to the region
+  INDEX GetFactor(const INDEX r) const { return f_[r]; }
+  INDEX GetNumberOfFactors() const { return f_.size(); }
+  INDEX GetNumberOfComponents() const { return components_.size(); }
+
+  // Partitions the region into components and extends the subproblems of all
+  // components that changed since the last call.
+  void add_messages() {
+    UnionFind uf(f_.size());
+    for (INDEX r = 0; r < f_.size(); ++r)
+      for_each_inner_message(f_[r], [&](const auto& m) {
+        uf.merge(region_index_[m.left], region_index_[m.right]);
+      });
+
+    // contiguous ids are indexed by the root of a set
+    const auto root_ids = uf.get_contiguous_ids();
+    std::vector<component> components(uf.count());
+    for (INDEX r = 0; r < f_.size(); ++r)
+      components[root_ids[uf.find(r)]].factors.push_back(f_[r]);
+
+    // keep the subproblem of the largest previous component within each component
+    for (auto& c : components_) {
+      auto& n = components[root_ids[uf.find(region_index_[c.factors[0]])]];
+      if (!n.solver || n.solver->GetNumberOfFactors() < c.solver->GetNumberOfFactors())
+        n.solver = std::move(c.solver);
+    }
+
+    std::vector<unsigned char> is_new(f_.size(), false);
+    for (auto& c : components) {
+      if (!c.solver)
+        c.solver = std::make_unique<partial_external_solver<EXTERNAL_SOLVER>>();
+      auto& s = *c.solver;
+      if (s.GetNumberOfFactors() == c.factors.size())
+        continue;
+
+      // Messages between factors present in the kept subproblem have been added already.
+      std::vector<INDEX> new_factors;
+      for (const INDEX i : c.factors)
+        if (!s.has_factor(graph_.factor(i)))
+          new_factors.push_back(i);
+      for (const INDEX i : new_factors) {
+        s.add_factor(graph_.factor(i));
+        is_new[region_index_[i]] = true;
+      }
+      // messages between two new factors are added from their left factor
+      for (const INDEX i : new_factors)
+        for_each_inner_message(i, [&](const auto& m) {
+          if (m.left == i || !is_new[region_index_[m.other(i)]])
+            m.add_to(s);
+        });
+    }
+
+    // largest components first for better load balancing
+    std::sort(components.begin(), components.end(), [](const auto& a, const auto& b) {
+      return a.factors.size() > b.factors.size();
+    });
+    components_ = std::move(components);
+  }
+
+  bool solve() {
+    assert(std::accumulate(components_.begin(), components_.end(), std::size_t(0),
+      [](std::size_t s, const auto& c) { return s + c.factors.size(); }) == f_.size());
+    bool result = true;
+#pragma omp parallel for schedule(dynamic,1) reduction(&&:result)
+    for (INDEX c = 0; c < components_.size(); ++c)
+      result = components_[c].solver->solve() && result;
+
+    dirty_ = false;
+    return result;
+  }
+
+  bool dirty () const { return dirty_; }
+
+private:
+  static constexpr INDEX not_in_region = std::numeric_limits<INDEX>::max();
+
+  struct component {
+    std::vector<INDEX> factors;
+    std::unique_ptr<partial_external_solver<EXTERNAL_SOLVER>> solver;
+  };
+
+  // messages of factor i with both endpoints in the region
+  template<typename FUNC>
+  void for_each_inner_message(const INDEX i, FUNC&& func) const {
+    for (auto* k = graph_.incident_begin(i); k != graph_.incident_end(i); ++k) {
+      const auto& m = graph_[*k];
+      if (has_factor(m.other(i)))
+        func(m);
+    }
+  }
+
+  const indexed_message_graph<EXTERNAL_SOLVER>& graph_;
+  std::vector<INDEX> f_; // factors of the region in order of addition
+  std::vector<INDEX> region_index_; // position of a factor in f_
+  std::vector<component> components_;
+  bool dirty_ = false;
 };
 
 } // end namespace LP_MP
@@ -12,14 +12,43 @@
 #include <list>
 #include <map>
 #include <queue>
+#include <array>
+#include <tuple>
+#include <chrono>
+#include <atomic>
 
 #include "config.hxx"
 #include "vector.hxx"
 #include "graph.hxx"
 #include "union_find.hxx"
+#include "help_functions.hxx"
 
 namespace LP_MP {
 
+// wall clock budget for separation. Searches check it periodically and return the candidates found so far once it is exceeded.
+class separation_budget {
+public:
+   separation_budget(const REAL seconds = std::numeric_limits<REAL>::infinity())
+      : unlimited_(!(seconds < std::numeric_limits<REAL>::infinity()))
+   {
+      if(!unlimited_) {
+         deadline_ = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<REAL>(std::max(seconds, REAL(0.0))));
+      }
+   }
+
+   bool unlimited() const { return unlimited_; }
+   bool exceeded() const { return !unlimited_ && std::chrono::steady_clock::now() >= deadline_; }
+   REAL remaining() const
+   {
+      if(unlimited_) { return std::numeric_limits<REAL>::infinity(); }
+      return std::max(REAL(0.0), std::chrono::duration<REAL>(deadline_ - std::chrono::steady_clock::now()).count());
+   }
+
+private:
+   bool unlimited_;
+   std::chrono::steady_clock::time_point deadline_;
+};
+
 template<typename MRF_CONSTRUCTOR>
 class triplet_search 
 {
@@ -32,39 +61,47 @@ public:
    {}
    ~triplet_search() {};
 
-   std::vector<triplet_candidate> search()
+   std::vector<triplet_candidate> search(const separation_budget& budget = separation_budget())
    {
-      // Initialize adjacency list (filled in later) TODO: only do this when needed
-      std::vector<std::vector<INDEX> > adjacency_list(gm_.GetNumberOfVariables());
+      const INDEX no_pairwise = gm_.GetNumberOfPairwiseFactors();
 
-      // Construct adjacency list for the graph
-      // Iterate over all of the edges (we do this by looking at the edge intersection sets)
-      for(size_t factorId=0; factorId<gm_.GetNumberOfPairwiseFactors(); factorId++) {
+      // Construct adjacency lists in compressed form: collect both directions of every edge, sort them, and record offsets per node.
+      // Sorted adjacency lists allow for fast intersections later.
+      std::vector<std::array<INDEX,2>> arcs(2*no_pairwise);
+#pragma omp parallel for schedule(static)
+      for(INDEX factorId=0; factorId<no_pairwise; factorId++) {
          auto vars = gm_.GetPairwiseVariables(factorId);
-         // Get the two nodes i & j
-         const size_t i=std::get<0>(vars);
-         const size_t j=std::get<1>(vars);
+         const INDEX i=std::get<0>(vars);
+         const INDEX j=std::get<1>(vars);
          assert(i<j);
-         adjacency_list[i].push_back(j);
-         adjacency_list[j].push_back(i);
+         arcs[2*factorId] = {i,j};
+         arcs[2*factorId+1] = {j,i};
       }
+      parallel_sort(arcs.begin(), arcs.end());
 
-      // Sort the adjacency list, for fast intersections later
-#pragma omp parallel for schedule(guided)
-      for(INDEX i=0; i < adjacency_list.size(); i++) {
-         std::sort(adjacency_list[i].begin(), adjacency_list[i].end());
+      std::vector<INDEX> adjacency_offsets(gm_.GetNumberOfVariables()+1, 0);
+      std::vector<INDEX> adjacency(arcs.size());
+      for(std::size_t a=0; a<arcs.size(); ++a) {
+         adjacency_offsets[arcs[a][0]+1]++;
+         adjacency[a] = arcs[a][1];
       }
+      std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+      auto neighbors_begin = [&](const INDEX i) { return adjacency.begin() + adjacency_offsets[i]; };
+      auto neighbors_end = [&](const INDEX i) { return adjacency.begin() + adjacency_offsets[i+1]; };
 
       std::vector<triplet_candidate> triplet_candidates;
-      INDEX index=0;
 
-      // Iterate over all of the edge intersection sets
+      // Iterate over all of the edge intersection sets. Candidates are collected per thread and merged in arbitrary order, the final sort w.r.t. a total order makes the result deterministic.
+      // When the budget is exceeded, remaining edges are skipped and the triplets found so far are returned.
+      std::atomic<bool> out_of_budget(false);
 #pragma omp parallel 
       {
-         std::vector<INDEX> commonNodes(gm_.GetNumberOfVariables()-1);
+         std::vector<INDEX> commonNodes;
          std::vector<triplet_candidate> triplet_candidates_local;
 #pragma omp for schedule(guided)
-         for(size_t factorId=0; factorId<gm_.GetNumberOfPairwiseFactors(); factorId++) {
+         for(INDEX factorId=0; factorId<no_pairwise; factorId++) {
+            if(out_of_budget.load(std::memory_order_relaxed)) { continue; }
+            if(factorId % 64 == 0 && budget.exceeded()) { out_of_budget = true; continue; }
             auto vars = gm_.GetPairwiseVariables(factorId);
             const INDEX i=std::get<0>(vars);
             const INDEX j=std::get<1>(vars);
@@ -72,8 +109,8 @@ public:
             const REAL lb_ij = factor_ij.LowerBound();
 
             // Now find all neighbors of both i and j to see where the triangles are
-            auto intersects_iter_end = set_intersection(adjacency_list[i].begin(), adjacency_list[i].end(), adjacency_list[j].begin(), adjacency_list[j].end(), commonNodes.begin());
-            assert(adjacency_list[i].size() <= commonNodes.size() && adjacency_list[j].size() <= commonNodes.size());
+            commonNodes.resize(std::min(adjacency_offsets[i+1] - adjacency_offsets[i], adjacency_offsets[j+1] - adjacency_offsets[j]));
+            auto intersects_iter_end = std::set_intersection(neighbors_begin(i), neighbors_end(i), neighbors_begin(j), neighbors_end(j), commonNodes.begin());
 
             for(auto n=commonNodes.begin(); n != intersects_iter_end; ++n) {
                INDEX k = *n;
@@ -101,9 +138,10 @@ public:
          }
       }
 
-      std::sort(triplet_candidates.begin(), triplet_candidates.end());
+      if(out_of_budget && diagnostics()) { std::cout << "triplet search ran out of time budget\n"; }
+      parallel_sort(triplet_candidates.begin(), triplet_candidates.end());
 
-      return std::move(triplet_candidates);
+      return triplet_candidates;
    }
 
 protected:
@@ -140,15 +178,21 @@ public:
       eps_(epsilon)
    {}
 
-   std::vector<triplet_candidate> search(const INDEX max_triplets = std::numeric_limits<INDEX>::max())
+   // the projection graph is kept between calls to search. Edges are only recomputed for pairwise factors which changed in the meantime.
+   void set_epsilon(const REAL epsilon) { eps_ = epsilon; }
+
+   std::vector<triplet_candidate> search(const INDEX max_triplets = std::numeric_limits<INDEX>::max(), const separation_budget& budget = separation_budget())
    {
+      if(budget.exceeded()) { return {}; }
+      bool constructed;
       if(!EXTENDED) {
-         construct_projection_graph();
+         constructed = construct_projection_graph(budget);
       } else {
          auto partitions = compute_partitions(); 
-         construct_projection_graph(std::move(partitions));
+         constructed = construct_projection_graph(budget, std::move(partitions));
       }
-      return find_cycles(max_triplets);
+      if(!constructed) { return {}; }
+      return find_cycles(max_triplets, budget);
    }
 
    template<typename PAIRWISE_REPAM>
@@ -164,7 +208,8 @@ protected:
    std::pair<std::vector<bool>,std::vector<bool>> compute_partitions(const PAIRWISE_REPAM& f);
    std::vector<std::vector<std::vector<bool>>> compute_partitions(); 
 
-   void construct_projection_graph(const std::vector<std::vector<std::vector<bool>>> partitions = {});
+   // returns false if the budget was exceeded before the graph was complete. Edges computed so far are kept for the next call.
+   bool construct_projection_graph(const separation_budget& budget, const std::vector<std::vector<std::vector<bool>>> partitions = {});
 
    template<typename PAIRWISE_REPAM, typename V>
    REAL compute_projection_weight_singleton_2(const PAIRWISE_REPAM& f, const std::vector<bool>& part_i, const INDEX x2, const V& row_minima);
@@ -177,17 +222,40 @@ protected:
    template<typename PAIRWISE_REPAM>
    REAL compute_projection_weight_on_partitions(const PAIRWISE_REPAM& f, const std::vector<bool>& part_i, const std::vector<bool>& part_j);
 
-   std::vector<triplet_candidate> find_cycles(const INDEX max_triplets);
+   std::vector<triplet_candidate> find_cycles(const INDEX max_triplets, const separation_budget& budget);
    void triangulate(std::vector<triplet_candidate>& triplet_candidates, std::tuple<REAL,std::vector<INDEX>>& path);
 
-   std::vector<std::tuple<INDEX,INDEX,REAL>> projection_edges_;
+   // edges above threshold as (projection node, projection node, weight, pairwise factor), sorted by projection_edge_order
+   std::vector<std::tuple<INDEX,INDEX,REAL,INDEX>> projection_edges_;
+   REAL projection_edges_eps_ = std::numeric_limits<REAL>::infinity(); // threshold projection_edges_ was assembled with
    std::vector<INDEX> proj_graph_offsets_;
    std::vector<INDEX> proj_graph_to_gm_node_;
    std::vector<std::tuple<INDEX,INDEX,REAL>> proj_graph_edges_;
    Graph proj_graph_;
 
+   // descending w.r.t. absolute weight, ties are broken by indices, so that graph and cycle search are deterministic.
+   template<typename EDGE>
+   static bool projection_edge_order(const EDGE& a, const EDGE& b)
+   {
+      const REAL abs_a = std::abs(std::get<2>(a));
+      const REAL abs_b = std::abs(std::get<2>(b));
+      if(abs_a != abs_b) { return abs_a > abs_b; }
+      return std::make_tuple(std::get<0>(a), std::get<1>(a), std::get<3>(a)) < std::make_tuple(std::get<0>(b), std::get<1>(b), std::get<3>(b));
+   }
+
+   // projection edges of each pairwise factor, together with the reparametrization generation (and partitions) they were computed from.
+   // Edges of factors recomputed since projection_edges_ was assembled last are pending and replace their previous edges there.
+   static constexpr std::size_t no_generation = std::numeric_limits<std::size_t>::max();
+   std::vector<std::vector<std::tuple<INDEX,INDEX,REAL>>> factor_projection_edges_;
+   std::vector<std::size_t> factor_generation_;
+   std::vector<unsigned char> factor_pending_;
+   std::vector<std::vector<std::vector<bool>>> partitions_;
+   // calls to construct_projection_graph and the call in which each factor's edges were computed last
+   std::size_t construction_pass_ = 0;
+   std::vector<std::size_t> factor_pass_;
+
    const MRF_CONSTRUCTOR& gm_;
-   const REAL eps_;
+   REAL eps_;
 };
 
 
@@ -266,9 +334,10 @@ matrix<REAL> k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::princip
 }
 
 // Given an undirected graph, finds odd-signed cycles.
+// Thresholds are lowered successively, cycles found for larger thresholds being more violated. Hence, when the budget is exceeded, the cycles found so far are the most valuable ones and are returned.
 template<typename MRF_CONSTRUCTOR, bool EXTENDED>
 std::vector<triplet_candidate> 
-k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::find_cycles(const INDEX max_triplets)
+k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::find_cycles(const INDEX max_triplets, const separation_budget& budget)
 {
    REAL largest_th;
    UnionFind uf(proj_graph_.size());
@@ -302,11 +371,12 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::find_cycles(const IN
    }
 
    std::vector<triplet_candidate> triplet_candidates;
-   std::vector<bool> already_searched(proj_graph_to_gm_node_.size(),false);
+   std::vector<unsigned char> already_searched(proj_graph_to_gm_node_.size(),false); // not std::vector<bool>, entries are written concurrently
    //BfsData bfs(proj_graph_);
    // first update union find datastructure by merging additional edges with cost greater than th
    REAL th = 0.5*largest_th;
-   for(INDEX iter=0; iter<8 && th>=eps_; ++iter, th*=0.1) {
+   std::atomic<bool> out_of_budget(false);
+   for(INDEX iter=0; iter<8 && th>=eps_ && !out_of_budget; ++iter, th*=0.1) {
       // update connectivity information
       for(; e<projection_edges_.size(); ++e) {
          const INDEX i = std::get<0>(projection_edges_[e]);
@@ -326,7 +396,9 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::find_cycles(const IN
          BfsData bfs(proj_graph_);
 #pragma omp for schedule(guided)
          for(INDEX i=0; i<proj_graph_to_gm_node_.size(); ++i) {
+            if(out_of_budget.load(std::memory_order_relaxed)) { continue; }
             if(!already_searched[i] && uf.thread_safe_connected(2*i, 2*i+1)) {
+               if(budget.exceeded()) { out_of_budget = true; continue; }
                already_searched[i] = true;
                auto path = bfs.FindPath(2*i, 2*i+1, proj_graph_, th);
                assert(std::get<1>(path).size() >= 3);
@@ -344,13 +416,18 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::find_cycles(const IN
          break;
       }
    }
+   if(out_of_budget && diagnostics()) { std::cout << "cycle search ran out of time budget\n"; }
 
-   std::sort(triplet_candidates.begin(), triplet_candidates.end());
+   // remove duplicates, keeping the one with largest cost, and sort descending w.r.t. cost
+   parallel_sort(triplet_candidates.begin(), triplet_candidates.end(), [](const auto& a, const auto& b) {
+         return std::make_tuple(a.i, a.j, a.k, -a.cost) < std::make_tuple(b.i, b.j, b.k, -b.cost); 
+   });
+   triplet_candidates.erase( unique( triplet_candidates.begin(), triplet_candidates.end() ), triplet_candidates.end() );
+   parallel_sort(triplet_candidates.begin(), triplet_candidates.end());
    if(triplet_candidates.size() > 0) {
       assert(triplet_candidates[0].cost >= triplet_candidates.back().cost);
    }
-   triplet_candidates.erase( unique( triplet_candidates.begin(), triplet_candidates.end() ), triplet_candidates.end() );
-   return std::move(triplet_candidates);
+   return triplet_candidates;
 }
 
  
@@ -556,7 +633,7 @@ REAL min_same_part = std::numeric_limits<REAL>::infinity();
    for(INDEX x1=0; x1<f.dim1(); ++x1) {
       for(INDEX x2_iter=0; x2_iter<f.dim2(); ++x2_iter) {
          const REAL val_xij = f(x1,x2_iter);
-         if(x2 == x2_iter) {
+         if(part_i[x1] == (x2 == x2_iter)) {
             min_same_part = std::min(min_same_part, val_xij);
          } else {
             min_different_part = std::min(min_different_part, val_xij);
@@ -610,7 +687,7 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::compute_projection_w
    for(INDEX x1_iter=0; x1_iter<f.dim1(); ++x1_iter) {
       for(INDEX x2=0; x2<f.dim2(); ++x2) {
          const REAL val_xij = f(x1_iter,x2);
-         if(x1 == x1_iter) {
+         if((x1 == x1_iter) == part_j[x2]) {
             min_same_part = std::min(min_same_part, val_xij);
          } else {
             min_different_part = std::min(min_different_part, val_xij);
@@ -644,26 +721,36 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::compute_projection_w
 }
 
 template<typename MRF_CONSTRUCTOR, bool EXTENDED>
-void 
-k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::construct_projection_graph(const std::vector<std::vector<std::vector<bool>>> partitions)
+bool
+k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::construct_projection_graph(const separation_budget& budget, const std::vector<std::vector<std::vector<bool>>> partitions)
 {
-   proj_graph_offsets_ = std::vector<INDEX>(gm_.GetNumberOfVariables());
-   proj_graph_offsets_[0] = 0;
+   std::vector<INDEX> proj_graph_offsets(gm_.GetNumberOfVariables());
+   proj_graph_offsets[0] = 0;
    for(INDEX i=1; i<gm_.GetNumberOfVariables(); i++) {
-      proj_graph_offsets_[i] = gm_.GetNumberOfLabels(i-1);
+      proj_graph_offsets[i] = gm_.GetNumberOfLabels(i-1);
       if(EXTENDED) { 
-         proj_graph_offsets_[i] += partitions[i-1].size();
+         proj_graph_offsets[i] += partitions[i-1].size();
       }
    }
 
-   std::partial_sum(proj_graph_offsets_.begin(), proj_graph_offsets_.end(), proj_graph_offsets_.begin());
-   INDEX proj_graph_nodes = proj_graph_offsets_.back() + gm_.GetNumberOfLabels(gm_.GetNumberOfVariables()-1);
+   std::partial_sum(proj_graph_offsets.begin(), proj_graph_offsets.end(), proj_graph_offsets.begin());
+   INDEX proj_graph_nodes = proj_graph_offsets.back() + gm_.GetNumberOfLabels(gm_.GetNumberOfVariables()-1);
    if(EXTENDED) {
       proj_graph_nodes += partitions.back().size();
    }
 
-   proj_graph_to_gm_node_ = std::vector<INDEX>(proj_graph_nodes);
-   {
+   // node layout changed: all edges computed previously are invalid
+   if(proj_graph_offsets != proj_graph_offsets_ || proj_graph_nodes != proj_graph_to_gm_node_.size()) {
+      proj_graph_offsets_ = std::move(proj_graph_offsets);
+      factor_projection_edges_.clear();
+      factor_generation_.clear();
+      factor_pending_.clear();
+      factor_pass_.clear();
+      partitions_.clear();
+      projection_edges_.clear();
+      projection_edges_eps_ = std::numeric_limits<REAL>::infinity();
+
+      proj_graph_to_gm_node_ = std::vector<INDEX>(proj_graph_nodes);
       INDEX c=0;
       for(INDEX i=0; i<gm_.GetNumberOfVariables(); i++) {
          INDEX no_proj_graph_nodes_for_label = gm_.GetNumberOfLabels(i);
@@ -678,97 +765,184 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::construct_projection
       assert(c == proj_graph_nodes);
    }
 
-   std::vector<INDEX> no_outgoing_arcs(2*proj_graph_nodes,0);
-   projection_edges_.clear();
+   const INDEX no_pairwise = gm_.GetNumberOfPairwiseFactors();
+   // pairwise factors may have been added by tightening
+   factor_projection_edges_.resize(no_pairwise);
+   factor_generation_.resize(no_pairwise, no_generation);
+   factor_pending_.resize(no_pairwise, false);
+   factor_pass_.resize(no_pairwise, 0);
+   const std::size_t pass = ++construction_pass_;
+
+   // edges to and between general projections of a variable whose partitions changed must be recomputed
+   std::vector<unsigned char> partitions_changed(EXTENDED ? gm_.GetNumberOfVariables() : 0, false);
+   if(EXTENDED) {
+      partitions_.resize(gm_.GetNumberOfVariables());
+      for(INDEX i=0; i<gm_.GetNumberOfVariables(); ++i) {
+         partitions_changed[i] = partitions[i] != partitions_[i];
+      }
+   }
 
-   auto add_to_projection_edges = [this,&no_outgoing_arcs](auto& projection_edges, const INDEX n, const INDEX m, const REAL val) {
-      if(std::abs(val) >= eps_ && !std::isnan(val)) {          
+   // edges are stored independently of eps_ and thresholded when assembling the graph, so that they can be reused when eps_ changes
+   auto add_to_projection_edges = [](auto& projection_edges, const INDEX n, const INDEX m, const REAL val) {
+      if(std::abs(val) >= std::numeric_limits<REAL>::epsilon() && !std::isnan(val)) {          
          projection_edges.push_back(std::make_tuple(m,n,val));
       } 
    };
 
-#pragma omp parallel
-   {
-      auto projection_edges_local = projection_edges_;
-#pragma omp for schedule(guided)
-      for(size_t factorId=0; factorId<gm_.GetNumberOfPairwiseFactors(); factorId++) {
-         // Get the two nodes i & j and the edge intersection set. Put in right order.
-         const INDEX i = std::get<0>(gm_.GetPairwiseVariables(factorId));
-         const INDEX j = std::get<1>(gm_.GetPairwiseVariables(factorId));
-
-         // Check to see if i and j have at least two states each -- otherwise, cannot be part of any frustrated edge
-         if(gm_.GetNumberOfLabels(i) <= 1 || gm_.GetNumberOfLabels(j) <= 1)
-            continue;
-
-         // For each of their singleton states efficiently compute edge weights
-         const auto& factor_ij = *gm_.GetPairwiseFactor(i,j)->GetFactor(); // better retrieve by factor id
-
-         const auto row_min = row_minima(factor_ij);
-         const auto col_min = column_minima(factor_ij);
-         const auto principal_min = principal_minima(factor_ij, col_min);
-
-         assert(i<j);
-         for(INDEX xi=0; xi<factor_ij.dim1(); xi++) {
-            const INDEX m = proj_graph_offsets_[i] + xi;
-            assert(i == proj_graph_to_gm_node_[m]);
-
-            for(INDEX xj=0; xj<factor_ij.dim2(); xj++) {
-               const INDEX n = proj_graph_offsets_[j] + xj;
-               assert(j == proj_graph_to_gm_node_[n]);
-
-               const REAL val_xij = factor_ij(xi,xj);
-
-               const REAL val_not_xi = row_min(xi,0) == val_xij ? row_min(xi,1) : row_min(xi,0);
-               const REAL val_not_xj = col_min(xj,0) == val_xij ? col_min(xj,1) : col_min(xj,0);
-
-               // val_s < 0 means same projection < different projection, > 0 the opposite
-               // Hence we search for a cycle with an odd number of entries > 0      
-               const REAL cost_projection_same = std::min(val_xij, principal_min(xi,xj));
-               const REAL cost_projection_different = std::min(val_not_xi, val_not_xj);
-               const REAL val_s = cost_projection_same - cost_projection_different;
+   INDEX no_recomputed = 0;
+   std::atomic<bool> out_of_budget(false);
+#pragma omp parallel for schedule(guided) reduction(+:no_recomputed)
+   for(INDEX factorId=0; factorId<no_pairwise; factorId++) {
+      if(out_of_budget.load(std::memory_order_relaxed)) { continue; }
+      if(factorId % 64 == 0 && budget.exceeded()) { out_of_budget = true; continue; }
+      // Get the two nodes i & j and the edge intersection set. Put in right order.
+      const INDEX i = std::get<0>(gm_.GetPairwiseVariables(factorId));
+      const INDEX j = std::get<1>(gm_.GetPairwiseVariables(factorId));
+      auto* pairwise = gm_.GetPairwiseFactor(factorId);
+      const std::size_t generation = pairwise->reparametrization_generation();
+
+      if(factor_generation_[factorId] == generation && !(EXTENDED && (partitions_changed[i] || partitions_changed[j]))) {
+         continue;
+      }
+      ++no_recomputed;
+      factor_generation_[factorId] = generation;
+      factor_pending_[factorId] = true;
+      factor_pass_[factorId] = pass;
+      const auto& factor_ij = *pairwise->GetFactor();
+      auto& projection_edges_local = factor_projection_edges_[factorId];
+      projection_edges_local.clear();
+
+      // Check to see if i and j have at least two states each -- otherwise, cannot be part of any frustrated edge
+      if(gm_.GetNumberOfLabels(i) <= 1 || gm_.GetNumberOfLabels(j) <= 1)
+         continue;
+
+      // For each of their singleton states efficiently compute edge weights
+      const auto row_min = row_minima(factor_ij);
+      const auto col_min = column_minima(factor_ij);
+      const auto principal_min = principal_minima(factor_ij, col_min);
+
+      assert(i<j);
+      for(INDEX xi=0; xi<factor_ij.dim1(); xi++) {
+         const INDEX m = proj_graph_offsets_[i] + xi;
+         assert(i == proj_graph_to_gm_node_[m]);
+
+         for(INDEX xj=0; xj<factor_ij.dim2(); xj++) {
+            const INDEX n = proj_graph_offsets_[j] + xj;
+            assert(j == proj_graph_to_gm_node_[n]);
+
+            const REAL val_xij = factor_ij(xi,xj);
+
+            const REAL val_not_xi = row_min(xi,0) == val_xij ? row_min(xi,1) : row_min(xi,0);
+            const REAL val_not_xj = col_min(xj,0) == val_xij ? col_min(xj,1) : col_min(xj,0);
+
+            // val_s < 0 means same projection < different projection, > 0 the opposite
+            // Hence we search for a cycle with an odd number of entries > 0      
+            const REAL cost_projection_same = std::min(val_xij, principal_min(xi,xj));
+            const REAL cost_projection_different = std::min(val_not_xi, val_not_xj);
+            const REAL val_s = cost_projection_same - cost_projection_different;
+
+            add_to_projection_edges(projection_edges_local,n,m,val_s);
+         }
+      }
 
-               // TODO: use threshold here, to make next stage faster
+      if(EXTENDED) {
+         // add edge weights between each general projection and each singleton state 
+         for(INDEX x1=0; x1<factor_ij.dim1(); ++x1) {
+            const INDEX m = proj_graph_offsets_[i] + x1;
+            for(INDEX p2=0; p2<partitions[j].size(); ++p2) {
+               const INDEX n = proj_graph_offsets_[j] + gm_.GetNumberOfLabels(j) + p2;
+               const REAL val_s = compute_projection_weight_singleton_1(factor_ij, x1, partitions[j][p2], col_min);
                add_to_projection_edges(projection_edges_local,n,m,val_s);
             }
          }
-
-         if(EXTENDED) {
-            // add edge weights between each general projection and each singleton state 
-            for(INDEX x1=0; x1<factor_ij.dim1(); ++x1) {
-               const INDEX m = proj_graph_offsets_[i] + x1;
-               for(INDEX p2=0; p2<partitions[j].size(); ++p2) {
-                  const INDEX n = proj_graph_offsets_[j] + gm_.GetNumberOfLabels(j) + p2;
-                  const REAL val_s = compute_projection_weight_singleton_1(factor_ij, x1, partitions[j][p2], col_min);
-                  add_to_projection_edges(projection_edges_local,n,m,val_s);
-               }
-            }
-            for(INDEX x2=0; x2<factor_ij.dim2(); ++x2) {
-               const INDEX m = proj_graph_offsets_[j] + x2;
-               for(INDEX p1=0; p1<partitions[i].size(); ++p1) {
-                  const INDEX n = proj_graph_offsets_[i] + gm_.GetNumberOfLabels(i) + p1;
-                  const REAL val_s = compute_projection_weight_singleton_2(factor_ij, partitions[i][p1], x2, row_min);
-                  add_to_projection_edges(projection_edges_local,n,m,val_s);
-               }
-            }
-
-            // compute edge weights between general projections
+         for(INDEX x2=0; x2<factor_ij.dim2(); ++x2) {
+            const INDEX m = proj_graph_offsets_[j] + x2;
             for(INDEX p1=0; p1<partitions[i].size(); ++p1) {
                const INDEX n = proj_graph_offsets_[i] + gm_.GetNumberOfLabels(i) + p1;
-               for(INDEX p2=0; p2<partitions[j].size(); ++p2) {
-                  const INDEX m = proj_graph_offsets_[j] + gm_.GetNumberOfLabels(j) + p2;
-                  const REAL val_s = compute_projection_weight_on_partitions(factor_ij, partitions[i][p1], partitions[j][p2]);
-                  add_to_projection_edges(projection_edges_local,n,m,val_s);
-               }
+               const REAL val_s = compute_projection_weight_singleton_2(factor_ij, partitions[i][p1], x2, row_min);
+               add_to_projection_edges(projection_edges_local,n,m,val_s);
+            }
+         }
+
+         // compute edge weights between general projections
+         for(INDEX p1=0; p1<partitions[i].size(); ++p1) {
+            const INDEX n = proj_graph_offsets_[i] + gm_.GetNumberOfLabels(i) + p1;
+            for(INDEX p2=0; p2<partitions[j].size(); ++p2) {
+               const INDEX m = proj_graph_offsets_[j] + gm_.GetNumberOfLabels(j) + p2;
+               const REAL val_s = compute_projection_weight_on_partitions(factor_ij, partitions[i][p1], partitions[j][p2]);
+               add_to_projection_edges(projection_edges_local,n,m,val_s);
             }
          }
       }
-#pragma omp critical
-      {
-         projection_edges_.insert(projection_edges_.end(), projection_edges_local.begin(), projection_edges_local.end());
+   }
+   if(debug()) { std::cout << "recomputed projection edges of " << no_recomputed << " out of " << no_pairwise << " pairwise factors\n"; }
+   if(EXTENDED) {
+      // edges of factors not reached for lack of time were computed with the previous partitions
+      if(out_of_budget) {
+         for(INDEX factorId=0; factorId<no_pairwise; factorId++) {
+            const auto v = gm_.GetPairwiseVariables(factorId);
+            if(factor_pass_[factorId] != pass && (partitions_changed[std::get<0>(v)] || partitions_changed[std::get<1>(v)])) {
+               factor_generation_[factorId] = no_generation;
+            }
+         }
+      }
+      partitions_ = partitions;
+   }
+   if(out_of_budget) {
+      if(diagnostics()) { std::cout << "projection graph construction ran out of time budget\n"; }
+      return false;
+   }
+
+   // Only edges of pending factors are replaced in the sorted edge list. All edges are assembled anew only when the threshold was lowered.
+   const bool reassemble = eps_ < projection_edges_eps_;
+   std::vector<INDEX> pending;
+   for(INDEX factorId=0; factorId<no_pairwise; factorId++) {
+      if(reassemble || factor_pending_[factorId]) {
+         pending.push_back(factorId);
       }
    }
+   if(pending.empty() && eps_ == projection_edges_eps_) {
+      return true;
+   }
 
-   for(const auto edge : projection_edges_) {
+   auto above_threshold = [this](const auto& e) { return std::abs(std::get<2>(e)) >= eps_; };
+   if(reassemble) {
+      projection_edges_.clear();
+   } else {
+      projection_edges_.erase(std::remove_if(projection_edges_.begin(), projection_edges_.end(), [&](const auto& e) { 
+               return factor_pending_[std::get<3>(e)] || !above_threshold(e);
+               }), projection_edges_.end());
+   }
+
+   std::vector<std::size_t> edge_offsets(pending.size()+1, 0);
+#pragma omp parallel for schedule(guided)
+   for(INDEX k=0; k<pending.size(); k++) {
+      const auto& edges = factor_projection_edges_[pending[k]];
+      edge_offsets[k+1] = std::count_if(edges.begin(), edges.end(), above_threshold);
+   }
+   std::partial_sum(edge_offsets.begin(), edge_offsets.end(), edge_offsets.begin());
+   const std::size_t no_kept_edges = projection_edges_.size();
+   projection_edges_.resize(no_kept_edges + edge_offsets.back());
+   auto new_edges_begin = projection_edges_.begin() + no_kept_edges;
+#pragma omp parallel for schedule(guided)
+   for(INDEX k=0; k<pending.size(); k++) {
+      auto it = new_edges_begin + edge_offsets[k];
+      for(const auto& e : factor_projection_edges_[pending[k]]) {
+         if(above_threshold(e)) {
+            *it++ = std::make_tuple(std::get<0>(e), std::get<1>(e), std::get<2>(e), pending[k]);
+         }
+      }
+      factor_pending_[pending[k]] = false;
+   }
+
+   auto edge_order = [](const auto& a, const auto& b) { return projection_edge_order(a,b); };
+   parallel_sort(new_edges_begin, projection_edges_.end(), edge_order);
+   std::inplace_merge(projection_edges_.begin(), new_edges_begin, projection_edges_.end(), edge_order);
+   projection_edges_eps_ = eps_;
+
+   // edges are added in descending order of weight, hence outgoing arcs of each node are sorted without further sorting the graph
+   std::vector<INDEX> no_outgoing_arcs(2*proj_graph_nodes,0);
+   for(const auto& edge : projection_edges_) {
       const INDEX m = std::get<0>(edge);
       const INDEX n = std::get<1>(edge);
       no_outgoing_arcs[2*m]++;
@@ -778,7 +952,7 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::construct_projection
    }
 
    proj_graph_ = Graph(2*proj_graph_nodes, 4*projection_edges_.size(), no_outgoing_arcs);
-   for(const auto edge : projection_edges_) {
+   for(const auto& edge : projection_edges_) {
       const INDEX m = std::get<0>(edge);
       const INDEX n = std::get<1>(edge);
       const REAL s = std::get<2>(edge);
@@ -790,14 +964,10 @@ k_ary_cycle_inequalities_search<MRF_CONSTRUCTOR, EXTENDED>::construct_projection
          proj_graph_.add_edge(2*n+1, 2*m, s);
       }
    }
+   assert(proj_graph_.is_sorted());
 
-   proj_graph_.sort();
-
-   //assert(false); // should sorting be done on absolute value?
-   //std::sort(projection_edges_.begin(), projection_edges_.end(), [](auto a, auto b) { return std::get<2>(a) > std::get<2>(b); }); 
-   std::sort(projection_edges_.begin(), projection_edges_.end(), [](auto a, auto b) { return std::abs(std::get<2>(a)) > std::abs(std::get<2>(b)); }); 
+   return true;
 }
 } // end namespace LP_MP
 
 #endif // LP_MP_CYCLE_INEQUALITIES_HXX
-
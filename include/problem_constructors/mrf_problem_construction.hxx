@@ -6,7 +6,6 @@
 #include "parse_rules.h"
 #include "pegtl/parse.hh"
 #include "tree_decomposition.hxx"
-#include "arboricity.h"
 
 #include <string>
 
@@ -43,8 +42,7 @@ public:
    }
    UnaryFactorContainer* AddUnaryFactor(const INDEX node_number, const std::vector<REAL>& cost)
    {
-      //UnaryFactorContainer* u = new UnaryFactorContainer(UnaryFactorType(cost), cost);
-      auto* u = new UnaryFactorContainer( cost.size() );
+      auto* u = lp_->template add_factor<UnaryFactorContainer>( cost.size() );
       ConstructUnaryFactor( *(u->GetFactor()), cost );
       if(node_number >= unaryFactor_.size()) {
          unaryFactor_.resize(node_number+1,nullptr);
@@ -55,8 +53,6 @@ public:
       if(node_number > 0 && unaryFactor_[node_number-1]) { // fails for non-contiguous access
          lp_->AddFactorRelation(unaryFactor_[node_number-1], unaryFactor_[node_number]);
       }
-      
-      lp_->AddFactor(u);;
 
       return u;
    }
@@ -78,9 +74,7 @@ public:
       assert(!HasPairwiseFactor(var1,var2));
       //assert(cost.size() == GetNumberOfLabels(var1) * GetNumberOfLabels(var2));
       //assert(pairwiseMap_.find(std::make_tuple(var1,var2)) == pairwiseMap_.end());
-      //PairwiseFactorContainer* p = new PairwiseFactorContainer(PairwiseFactor(cost), cost);
-      auto* p = new PairwiseFactorContainer(GetNumberOfLabels(var1), GetNumberOfLabels(var2), cost);
-      lp_->AddFactor(p);
+      auto* p = lp_->template add_factor<PairwiseFactorContainer>(GetNumberOfLabels(var1), GetNumberOfLabels(var2), cost);
       ConstructPairwiseFactor(*(p->GetFactor()), var1, var2);
       pairwiseFactor_.push_back(p);
       pairwiseIndices_.push_back(std::array<INDEX,2>({var1,var2}));
@@ -96,10 +90,8 @@ public:
 
    void LinkUnaryPairwiseFactor(UnaryFactorContainer* const left, PairwiseFactorContainer* const p, UnaryFactorContainer* right)
    {
-      auto* l = new LeftMessageContainer(ConstructLeftUnaryPairwiseMessage(left, p), left, p);
-      lp_->AddMessage(l);
-      auto* r = new RightMessageContainer(ConstructRightUnaryPairwiseMessage(right, p), right, p);
-      lp_->AddMessage(r);
+      lp_->template add_message<LeftMessageContainer>(left, p, ConstructLeftUnaryPairwiseMessage(left, p));
+      lp_->template add_message<RightMessageContainer>(right, p, ConstructRightUnaryPairwiseMessage(right, p));
    }
 
 
@@ -161,6 +153,51 @@ public:
    }
 
 
+   // warm start: change costs of existing factors. The delta is folded into the current reparametrization, so messages stay valid and no factor ordering or weights need to be recomputed.
+   void AddToUnaryCost(const INDEX i, const std::vector<REAL>& delta)
+   {
+      auto* u = GetUnaryFactor(i);
+      assert(delta.size() == GetNumberOfLabels(i));
+      for(INDEX x=0; x<delta.size(); ++x) {
+         (*u->GetFactor())[x] += delta[x];
+      }
+      u->reparametrized();
+   }
+
+   void UpdateUnaryCost(const INDEX i, const std::vector<REAL>& previous_cost, const std::vector<REAL>& cost)
+   {
+      assert(previous_cost.size() == cost.size() && cost.size() == GetNumberOfLabels(i));
+      auto* u = GetUnaryFactor(i);
+      for(INDEX x=0; x<cost.size(); ++x) {
+         (*u->GetFactor())[x] += cost[x] - previous_cost[x];
+      }
+      u->reparametrized();
+   }
+
+   template<typename COST>
+   void AddToPairwiseCost(const INDEX var1, const INDEX var2, const COST& delta)
+   {
+      auto* p = GetPairwiseFactor(var1, var2);
+      for(INDEX x1=0; x1<GetNumberOfLabels(var1); ++x1) {
+         for(INDEX x2=0; x2<GetNumberOfLabels(var2); ++x2) {
+            p->GetFactor()->cost(x1,x2) += delta(x1,x2);
+         }
+      }
+      p->reparametrized();
+   }
+
+   template<typename COST>
+   void UpdatePairwiseCost(const INDEX var1, const INDEX var2, const COST& previous_cost, const COST& cost)
+   {
+      auto* p = GetPairwiseFactor(var1, var2);
+      for(INDEX x1=0; x1<GetNumberOfLabels(var1); ++x1) {
+         for(INDEX x2=0; x2<GetNumberOfLabels(var2); ++x2) {
+            p->GetFactor()->cost(x1,x2) += cost(x1,x2) - previous_cost(x1,x2);
+         }
+      }
+      p->reparametrized();
+   }
+
    template<typename SOLVER>
    void Construct(SOLVER& pd) 
    {
@@ -189,150 +226,35 @@ public:
       }
    }
 
-  // build tree of unary and pairwise factors
-  LP_tree add_tree(std::vector<PairwiseFactorContainer*> p)
-  {
-     LP_tree t;
-     assert(p.size() > 0);
-
-     // extract messages joining unaries and pairwise
-     std::set<UnaryFactorContainer*> u_set; // u_set is not strictly needed, but helps in checking correctness of algorithm
-     std::set<PairwiseFactorContainer*> p_set;
-     std::vector<std::tuple<Chirality, MessageTypeAdapter*>> ordered_msgs;
-     UnaryFactorContainer* root = nullptr;
-     for(auto* f : p) {
-        p_set.insert(f); 
-
-        auto left_msgs = f->template get_messages<LeftMessageContainer>();
-        assert(left_msgs.size() == 1);
-        UnaryFactorContainer* left = (*left_msgs.begin())->GetLeftFactor();
-        u_set.insert(left);
-
-        auto right_msgs = f->template get_messages<RightMessageContainer>();
-        assert(right_msgs.size() == 1);
-        UnaryFactorContainer* right = (*right_msgs.begin())->GetLeftFactor(); 
-        u_set.insert(right);
-
-        assert(left != right);
-
-        root = left;
-     }
-
-     // assume some arbitrary root. build tree recursively from root
-     assert(u_set.size() == p_set.size() + 1);
-
-     std::deque<UnaryFactorContainer*> u_stack;
-     u_stack.push_back(root);
-
-     while(!u_stack.empty()) {
-        auto* f = u_stack.front();
-        u_stack.pop_front();
-        u_set.erase(f);
-
-        {
-           auto msgs = f->template get_messages<LeftMessageContainer>();
-           for(auto it=msgs.begin(); it!= msgs.end(); ++it) {
-              auto* p_cand = (*it)->GetRightFactor();
-              if(p_set.find(p_cand) != p_set.end()) {
-                 p_set.erase(p_cand);
-                 //t.AddMessage((*it), Chirality::left); // or right?
-                 ordered_msgs.push_back(std::make_tuple(Chirality::left, *it));
-                 // search for the other unary connected to p_cand
-                 auto msgs_other = p_cand->template get_messages<RightMessageContainer>();
-                 assert(msgs_other.size() == 1);
-                 auto* u_other = (*msgs_other.begin())->GetLeftFactor();
-                 assert(u_set.find(u_other) != u_set.end());
-                 //t.AddMessage(*(msgs_other.begin()), Chirality::right);
-                 ordered_msgs.push_back(std::make_tuple(Chirality::right, *(msgs_other.begin())));
-                 u_stack.push_back(u_other);
-              }
-           }
-        }
-
-        {
-           auto msgs = f->template get_messages<RightMessageContainer>();
-           for(auto it=msgs.begin(); it!= msgs.end(); ++it) {
-              auto* p_cand = (*it)->GetRightFactor();
-              if(p_set.find(p_cand) != p_set.end()) {
-                 p_set.erase(p_cand);
-                 //t.AddMessage((*it), Chirality::left); // or right?
-                 ordered_msgs.push_back(std::make_tuple(Chirality::left, *it));
-                 // search for the other unary connected to p_cand
-                 auto msgs_other = p_cand->template get_messages<LeftMessageContainer>();
-                 assert(msgs_other.size() == 1);
-                 auto* u_other = (*msgs_other.begin())->GetLeftFactor();
-                 assert(u_set.find(u_other) != u_set.end());
-                 //t.AddMessage(*(msgs_other.begin()), Chirality::right);
-                 ordered_msgs.push_back(std::make_tuple(Chirality::right, *(msgs_other.begin())));
-                 u_stack.push_back(u_other);
-              }
-           }
-        }
-     }
-
-     assert(p_set.empty());
-
-     std::reverse(ordered_msgs.begin(), ordered_msgs.end());
-     for(auto e : ordered_msgs) {
-        t.AddMessage(std::get<1>(e), std::get<0>(e));
-     }
-
-     t.init();
-
-     t.compute_subgradient();
-     assert(std::abs(t.lower_bound() - t.primal_cost()) <= eps);
-
-     return std::move(t);
-  }
-
   // compute forest cover of MRF and add each resulting tree
 
   auto compute_forest_cover()
   {
      return compute_forest_cover(pairwiseIndices_);
   }
-  std::vector<LP_tree> compute_forest_cover(const std::vector<std::array<INDEX,2>>& pairwiseIndices)
+  // Trees consist of unary and pairwise factors. An edge (i,j) oriented towards unary j results in the pairwise factor being upper for unary i and lower for unary j.
+  std::vector<factor_tree<FMC>> compute_forest_cover(const std::vector<std::array<INDEX,2>>& pairwiseIndices)
   {
-     UndirectedGraph g = UndirectedGraph(unaryFactor_.size(), pairwiseFactor_.size());
-     for(auto e : pairwiseIndices) {
-        const auto i = e[0];
-        const auto j = e[1];
-        g.AddEdge(i,j,1);
+     const auto forests = greedy_forest_cover(unaryFactor_.size(), pairwiseIndices);
+     if(diagnostics()) {
+        std::cout << "decomposed mrf into " << forests.size() << " trees\n";
      }
-     
-     const INDEX forest_num = g.Solve();
-     std::cout << "decomposed mrf into " << forest_num << " trees\n";
-     std::vector<LP_tree> trees;
-
-     std::vector<int> parents(unaryFactor_.size());
-     for(INDEX k=0; k<forest_num; ++k) {
-        g.GetForestParents(k, parents.data()); // possible GetForestEdges will return pairwise ids, hence GetPairwiseFactor(id) then can be called, which is faster
-
-        UnionFind uf(unaryFactor_.size());
-        for(INDEX i=0; i<parents.size(); ++i) {
-           if(parents[i] != -1) {
-              uf.merge(i, parents[i]);
-           }
-        }
-        auto contiguous_ids = uf.get_contiguous_ids();
-        
-        const INDEX no_trees = uf.count();
-        std::vector<std::vector<PairwiseFactorContainer*>> pairwise(no_trees);
-
-        for(INDEX i=0; i<parents.size(); ++i) {
-           if(parents[i] != -1) {
-              const INDEX tree_id = contiguous_ids[uf.find(i)];
-              const INDEX j = parents[i];
-              assert(tree_id == contiguous_ids[uf.find(j)]);
-              PairwiseFactorContainer* p = GetPairwiseFactor(std::min(i,j), std::max(i,j));
-              pairwise[tree_id].push_back(p);
-           } 
-        }
-        for(INDEX t=0; t<no_trees; ++t) {
-           if(pairwise[t].size() > 0) {
-              trees.push_back(add_tree(pairwise[t])); 
-           }
+
+     std::vector<factor_tree<FMC>> trees;
+     trees.reserve(forests.size());
+     for(const auto& forest : forests) {
+        factor_tree<FMC> t;
+        for(const auto& e : forest) {
+           const INDEX i = pairwiseIndices[e.edge][0];
+           const INDEX j = pairwiseIndices[e.edge][1];
+           auto* left_msg = get_left_message(i,j);
+           auto* right_msg = get_right_message(i,j);
+           // unary is left and pairwise factor right in both messages
+           t.add_message(*left_msg, e.lower == i ? Chirality::right : Chirality::left);
+           t.add_message(*right_msg, e.lower == j ? Chirality::right : Chirality::left);
         }
+        t.init();
+        trees.push_back(std::move(t));
      }
 
      auto check_pairwise_factors_present = [&trees]() -> INDEX {
@@ -348,7 +270,7 @@ public:
      };
      assert(check_pairwise_factors_present() == pairwiseIndices.size());
 
-     return std::move(trees);
+     return trees;
   }
 
 protected:
@@ -361,7 +283,7 @@ protected:
 
    //INDEX unaryFactorIndexBegin_, unaryFactorIndexEnd_; // do zrobienia: not needed anymore
 
-   LP* lp_;
+   LP<FMC>* lp_;
 };
 
 // overloads virtual functions above for standard SimplexFactor and SimplexMarginalizationMessage
@@ -510,7 +432,9 @@ protected:
 public:
    template<typename SOLVER>
    TighteningMRFProblemConstructor(SOLVER& pd)
-      : MRF_PROBLEM_CONSTRUCTOR(pd)
+      : MRF_PROBLEM_CONSTRUCTOR(pd),
+      k_projection_search_(*this),
+      expanded_projection_search_(*this)
    {}
 
    TripletFactorContainer* AddTripletFactor(const INDEX var1, const INDEX var2, const INDEX var3, const std::vector<REAL>& cost)
@@ -527,12 +451,12 @@ public:
       const INDEX factor13Id = this->pairwiseMap_.find(std::make_tuple(var1,var3))->second;
       const INDEX factor23Id = this->pairwiseMap_.find(std::make_tuple(var2,var3))->second;
 
-      TripletFactorContainer* t = new TripletFactorContainer(this->GetNumberOfLabels(var1), this->GetNumberOfLabels(var2), this->GetNumberOfLabels(var3));
-      this->lp_->AddFactor(t);
+      TripletFactorContainer* t = this->lp_->template add_factor<TripletFactorContainer>(this->GetNumberOfLabels(var1), this->GetNumberOfLabels(var2), this->GetNumberOfLabels(var3));
       tripletFactor_.push_back(t);
       tripletIndices_.push_back(std::array<INDEX,3>({var1,var2,var3}));
       const INDEX factorId = tripletFactor_.size()-1;
       tripletMap_.insert(std::make_pair(std::array<INDEX,3>({var1,var2,var3}), factorId));
+      triplet_zero_since_.push_back(std::numeric_limits<INDEX>::max());
 
       LinkPairwiseTripletFactor<PairwiseTripletMessage12Container>(factor12Id,factorId);
       LinkPairwiseTripletFactor<PairwiseTripletMessage13Container>(factor13Id,factorId);
@@ -571,9 +495,7 @@ public:
       assert(pairwiseDim1*pairwiseDim2 == p->GetFactor()->size());
 
       using MessageType = typename PAIRWISE_TRIPLET_MESSAGE_CONTAINER::MessageType;
-      MessageType m = MessageType(tripletDim1, tripletDim2, tripletDim3);
-      PAIRWISE_TRIPLET_MESSAGE_CONTAINER* mc = new PAIRWISE_TRIPLET_MESSAGE_CONTAINER(m, p, t);
-      this->lp_->AddMessage(mc);
+      this->lp_->template add_message<PAIRWISE_TRIPLET_MESSAGE_CONTAINER>(p, t, MessageType(tripletDim1, tripletDim2, tripletDim3));
    }
    INDEX GetNumberOfTripletFactors() const { return tripletFactor_.size(); }
 
@@ -593,6 +515,11 @@ public:
    bool AddTighteningTriplet(const INDEX var1, const INDEX var2, const INDEX var3)//, const std::vector<INDEX> pi1, const std::vector<INDEX> pi2, const std::vector<INDEX> pi3)
    {
       assert(var1 < var2 && var2 < var3 && var3 < this->GetNumberOfVariables());
+      // a recently retired triplet would most likely become inactive again
+      auto retired_it = retired_triplets_.find(std::array<INDEX,3>({var1,var2,var3}));
+      if(retired_it != retired_triplets_.end() && retire_iteration_ - retired_it->second < retire_cooldown_) {
+         return false;
+      }
       if(tripletMap_.find(std::array<INDEX,3>({var1,var2,var3})) == tripletMap_.end()) {
          // first check whether necessary pairwise factors are present. If not, add them.
          if(this->pairwiseMap_.find(std::make_tuple(var1,var2)) == this->pairwiseMap_.end()) {
@@ -628,39 +555,46 @@ public:
    }
 
    INDEX Tighten(const INDEX noTripletsToAdd)
+   {
+      return Tighten(noTripletsToAdd, std::numeric_limits<REAL>::infinity());
+   }
+
+   // separation stops after time_budget seconds. Triplets found until then are still added, later search stages are skipped.
+   INDEX Tighten(const INDEX noTripletsToAdd, const REAL time_budget)
    {
       assert(noTripletsToAdd > 0);
       if(debug()) {
-         std::cout << "Tighten mrf with cycle inequalities, no triplets to add = " << noTripletsToAdd << "\n";
+         std::cout << "Tighten mrf with cycle inequalities, no triplets to add = " << noTripletsToAdd << ", time budget = " << time_budget << "s\n";
       }
+      const separation_budget budget(time_budget);
 
       //auto fp = [this](const INDEX v1, const INDEX v2, const INDEX v3) { return this->AddTighteningTriplet(v1,v2,v3); }; // do zrobienia: do not give this via template, as Cycle already has gm_ object.
 
       triplet_search<typename std::remove_reference<decltype(*this)>::type> triplets(*this, eps);
       if(debug()) { std::cout << "search for triplets\n"; }
-      auto triplet_candidates = triplets.search();
+      auto triplet_candidates = triplets.search(budget);
       if(debug()) { std::cout << "done\n"; }
       INDEX no_triplets_added = add_triplets(triplet_candidates, noTripletsToAdd);
       if(diagnostics()) { std::cout << "added " << no_triplets_added << " by triplet search\n"; }
 
-      if(no_triplets_added < 0.2*noTripletsToAdd) {
+      if(no_triplets_added < 0.2*noTripletsToAdd && !budget.exceeded()) {
          if(debug()) {
             std::cout << "----------------- do cycle search with k-projection graph---------------\n";
          }
-         k_ary_cycle_inequalities_search<typename std::remove_reference<decltype(*this)>::type, false> cycle_search(*this, eps);
-         triplet_candidates = cycle_search.search();
+         k_projection_search_.set_epsilon(eps);
+         triplet_candidates = k_projection_search_.search(std::numeric_limits<INDEX>::max(), budget);
          if(debug()) { std::cout << "... done\n"; }
          const INDEX no_triplet_k_projection_graph = add_triplets(triplet_candidates, noTripletsToAdd-no_triplets_added);
          if(diagnostics()) {std::cout << "added " << no_triplet_k_projection_graph << " by cycle search in k-projection graph\n"; }
          no_triplets_added += no_triplet_k_projection_graph;
 
          // search in expanded projection graph
-         if(no_triplets_added < 0.2*noTripletsToAdd) {
+         if(no_triplets_added < 0.2*noTripletsToAdd && !budget.exceeded()) {
             if(debug()) {
                std::cout << "----------------- do cycle search with expanded projection graph---------------\n";
             }
-            k_ary_cycle_inequalities_search<typename std::remove_reference<decltype(*this)>::type, true> cycle_search(*this, eps);
-            triplet_candidates = cycle_search.search();
+            expanded_projection_search_.set_epsilon(eps);
+            triplet_candidates = expanded_projection_search_.search(std::numeric_limits<INDEX>::max(), budget);
             if(debug()) { std::cout << "... done\n"; }
             const INDEX no_triplet_k_projection_graph = add_triplets(triplet_candidates, noTripletsToAdd-no_triplets_added);
             if(diagnostics()) { std::cout << "added " << no_triplet_k_projection_graph << " by cycle search in expanded projection graph\n";
@@ -675,12 +609,12 @@ public:
        
       assert(eps >= std::numeric_limits<REAL>::epsilon());
 
-      if(no_triplets_added == 0) {
+      if(no_triplets_added == 0 && !budget.exceeded()) {
          triplet_search<typename std::remove_reference<decltype(*this)>::type> triplets(*this, std::numeric_limits<REAL>::epsilon());
          if(debug()) {
             std::cout << "search for triplets (any will do)\n";
          }
-         auto triplet_candidates = triplets.search();
+         auto triplet_candidates = triplets.search(budget);
          if(debug()) {
             std::cout << "done\n";
          }
@@ -690,12 +624,12 @@ public:
          }
       }
 
-      if(no_triplets_added == 0) {
+      if(no_triplets_added == 0 && !budget.exceeded()) {
          if(debug()) {
             std::cout << "----------------- do cycle search with k-projection graph, add all---------------\n";
          }
-         k_ary_cycle_inequalities_search<typename std::remove_reference<decltype(*this)>::type, false> cycle_search(*this, std::numeric_limits<REAL>::epsilon());
-         triplet_candidates = cycle_search.search();
+         k_projection_search_.set_epsilon(std::numeric_limits<REAL>::epsilon());
+         triplet_candidates = k_projection_search_.search(std::numeric_limits<INDEX>::max(), budget);
          if(debug()) { std::cout << "... done\n"; }
          const INDEX no_triplet_k_projection_graph = add_triplets(triplet_candidates, noTripletsToAdd-no_triplets_added);
          if(diagnostics()) {
@@ -704,12 +638,12 @@ public:
          no_triplets_added += no_triplet_k_projection_graph;
       }
 
-      if(no_triplets_added == 0) {
+      if(no_triplets_added == 0 && !budget.exceeded()) {
          if(debug()) {
             std::cout << "----------------- do cycle search with expanded projection graph, add all---------------\n";
          }
-         k_ary_cycle_inequalities_search<typename std::remove_reference<decltype(*this)>::type, true> cycle_search(*this, std::numeric_limits<REAL>::epsilon());
-         triplet_candidates = cycle_search.search();
+         expanded_projection_search_.set_epsilon(std::numeric_limits<REAL>::epsilon());
+         triplet_candidates = expanded_projection_search_.search(std::numeric_limits<INDEX>::max(), budget);
          if(debug()) { std::cout << "... done\n"; }
          const INDEX no_triplet_k_projection_graph = add_triplets(triplet_candidates, noTripletsToAdd-no_triplets_added);
          if(diagnostics()) {
@@ -721,11 +655,128 @@ public:
       return no_triplets_added;
    }
 
+   // Remove triplets whose reparametrization has been zero, up to a tolerance relative to the largest entry of their pairwise factors, since at least max_inactive_iterations iterations.
+   // Triplets are only inspected when this function is called, i.e. before tightening, hence a triplet must be found zero in successive calls spanning that many iterations.
+   // The reparametrization a triplet induced is held by its pairwise factors. Its remaining cost, which lies within the tolerance, is moved into the pairwise factor of its first two variables by minimizing out the third one.
+   // This does not decrease the lower bound, and the bound stays valid, since the moved cost is nowhere larger than the triplet's cost.
+   // Retired triplets are not added again by tightening for the next max_inactive_iterations iterations.
+   INDEX retire_inactive_triplets(const INDEX iteration, const INDEX max_inactive_iterations)
+   {
+      assert(triplet_zero_since_.size() == tripletFactor_.size());
+      retire_iteration_ = iteration;
+      retire_cooldown_ = max_inactive_iterations;
+      for(auto it=retired_triplets_.begin(); it!=retired_triplets_.end();) {
+         it = iteration - it->second >= max_inactive_iterations ? retired_triplets_.erase(it) : std::next(it);
+      }
+
+#pragma omp parallel for schedule(dynamic, 64)
+      for(INDEX t=0; t<tripletFactor_.size(); ++t) {
+         const auto& triplet = *tripletFactor_[t]->GetFactor();
+         const auto& idx = tripletIndices_[t];
+         REAL scale = 1.0;
+         for(const auto& ij : {std::make_pair(idx[0],idx[1]), std::make_pair(idx[0],idx[2]), std::make_pair(idx[1],idx[2])}) {
+            const auto& pairwise = *this->GetPairwiseFactor(ij.first, ij.second)->GetFactor();
+            for(INDEX x1=0; x1<this->GetNumberOfLabels(ij.first); ++x1) {
+               for(INDEX x2=0; x2<this->GetNumberOfLabels(ij.second); ++x2) {
+                  if(std::isfinite(pairwise(x1,x2))) { scale = std::max(scale, std::abs(pairwise(x1,x2))); }
+               }
+            }
+         }
+         const REAL tolerance = inactive_tolerance * scale;
+         bool zero = true;
+         for(INDEX x1=0; x1<this->GetNumberOfLabels(idx[0]) && zero; ++x1) {
+            for(INDEX x2=0; x2<this->GetNumberOfLabels(idx[1]) && zero; ++x2) {
+               for(INDEX x3=0; x3<this->GetNumberOfLabels(idx[2]) && zero; ++x3) {
+                  zero = std::abs(triplet(x1,x2,x3)) <= tolerance;
+               }
+            }
+         }
+         if(!zero) {
+            triplet_zero_since_[t] = std::numeric_limits<INDEX>::max();
+         } else if(triplet_zero_since_[t] == std::numeric_limits<INDEX>::max()) {
+            triplet_zero_since_[t] = iteration;
+         }
+      }
+
+      auto retire = [&](const INDEX t) {
+         return triplet_zero_since_[t] != std::numeric_limits<INDEX>::max() && iteration - triplet_zero_since_[t] >= max_inactive_iterations;
+      };
+      std::vector<FactorTypeAdapter*> retired;
+      for(INDEX t=0; t<tripletFactor_.size(); ++t) {
+         if(retire(t)) {
+            retired.push_back(tripletFactor_[t]);
+         }
+      }
+      if(retired.empty()) { return 0; }
+
+      std::vector<std::pair<typename MRFPC::PairwiseFactorContainer*, matrix<REAL>>> leftover_cost;
+      leftover_cost.reserve(retired.size());
+      for(INDEX t=0; t<tripletFactor_.size(); ++t) {
+         if(!retire(t)) { continue; }
+         const auto& triplet = *tripletFactor_[t]->GetFactor();
+         const auto& idx = tripletIndices_[t];
+         matrix<REAL> m(this->GetNumberOfLabels(idx[0]), this->GetNumberOfLabels(idx[1]));
+         for(INDEX x1=0; x1<m.dim1(); ++x1) {
+            for(INDEX x2=0; x2<m.dim2(); ++x2) {
+               m(x1,x2) = std::numeric_limits<REAL>::infinity();
+               for(INDEX x3=0; x3<this->GetNumberOfLabels(idx[2]); ++x3) {
+                  m(x1,x2) = std::min(m(x1,x2), triplet(x1,x2,x3));
+               }
+            }
+         }
+         leftover_cost.push_back(std::make_pair(this->GetPairwiseFactor(idx[0], idx[1]), std::move(m)));
+      }
+
+      this->lp_->remove_factors(retired.begin(), retired.end());
+      for(auto& c : leftover_cost) {
+         auto& pairwise = *c.first->GetFactor();
+         for(INDEX x1=0; x1<c.second.dim1(); ++x1) {
+            for(INDEX x2=0; x2<c.second.dim2(); ++x2) {
+               pairwise.cost(x1,x2) += c.second(x1,x2);
+            }
+         }
+         c.first->reparametrized();
+      }
+      // bookkeeping is only changed after the factors have been removed, since remove_factors may throw
+      INDEX no_kept = 0;
+      for(INDEX t=0; t<tripletFactor_.size(); ++t) {
+         if(retire(t)) {
+            retired_triplets_[tripletIndices_[t]] = iteration;
+         } else {
+            tripletFactor_[no_kept] = tripletFactor_[t];
+            tripletIndices_[no_kept] = tripletIndices_[t];
+            triplet_zero_since_[no_kept] = triplet_zero_since_[t];
+            ++no_kept;
+         }
+      }
+      tripletFactor_.resize(no_kept);
+      tripletIndices_.resize(no_kept);
+      triplet_zero_since_.resize(no_kept);
+      tripletMap_.clear();
+      for(INDEX t=0; t<tripletIndices_.size(); ++t) {
+         tripletMap_.insert(std::make_pair(tripletIndices_[t], t));
+      }
+
+      if(diagnostics()) {
+         std::cout << "retired " << retired.size() << " inactive triplets, " << tripletFactor_.size() << " remain\n";
+      }
+      return retired.size();
+   }
+
 
 protected:
    std::vector<TripletFactorContainer*> tripletFactor_;
    std::vector<std::array<INDEX,3>> tripletIndices_;
    std::map<std::array<INDEX,3>, INDEX> tripletMap_; // given two sorted indices, return factorId belonging to that index.
+   std::vector<INDEX> triplet_zero_since_; // iteration from which on the triplet's reparametrization has been zero, max() if nonzero
+   std::map<std::array<INDEX,3>, INDEX> retired_triplets_; // iteration in which a triplet was retired, kept while it must not be added again
+   INDEX retire_iteration_ = 0;
+   INDEX retire_cooldown_ = 0;
+   static constexpr REAL inactive_tolerance = 1e-9;
+
+   // kept alive between calls to Tighten, so that projection graphs are only updated for changed pairwise factors
+   k_ary_cycle_inequalities_search<MrfConstructorType, false> k_projection_search_;
+   k_ary_cycle_inequalities_search<MrfConstructorType, true> expanded_projection_search_;
 };
 
 
@@ -0,0 +1,296 @@
+#ifndef LP_MP_PROXIMAL_BUNDLE_HXX
+#define LP_MP_PROXIMAL_BUNDLE_HXX
+
+#include "config.hxx"
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <limits>
+#include <cassert>
+
+namespace LP_MP {
+
+struct proximal_bundle_options {
+   INDEX max_bundle_size = 10;
+   REAL proximal_weight = 1.0; // u
+   REAL min_proximal_weight = 1e-6;
+   REAL max_proximal_weight = 1e6;
+   REAL serious_step_fraction = 0.1; // serious step if f increases by this fraction of the predicted increase
+   INDEX max_qp_iterations = 200;
+   REAL tolerance = 1e-9;
+};
+
+// Proximal bundle method for maximizing a concave nonsmooth function f, e.g. the dual of a Lagrangean decomposition.
+// An oracle returns f(x) and a supergradient g at x.
+// Cuts are stored relative to the current center c as f(y) <= f(c) + alpha_i + <g_i, y - c> with linearization errors alpha_i >= 0.
+// The next candidate maximizes the cutting plane model minus u/2 ||y - c||^2. Its dual is the quadratic program
+//    min_{lambda in simplex} 1/(2u) lambda^T Q lambda + alpha^T lambda,   Q = Gram matrix of the g_i,
+// solved by pairwise coordinate descent warm started from the previous lambda. Q is updated in place when cuts are added, dropped or aggregated.
+// At most max_bundle_size cuts are held. All memory is allocated in the constructor.
+class proximal_bundle {
+public:
+   using options = proximal_bundle_options;
+
+   proximal_bundle(const INDEX dim, const options& o = options())
+      : dim_(dim),
+      o_(o),
+      u_(o.proximal_weight),
+      cuts_(std::size_t(o.max_bundle_size)*dim),
+      alpha_(o.max_bundle_size),
+      lambda_(o.max_bundle_size),
+      Q_(std::size_t(o.max_bundle_size)*o.max_bundle_size),
+      Q_lambda_(o.max_bundle_size),
+      dots_(o.max_bundle_size),
+      kept_(o.max_bundle_size),
+      center_(dim, 0.0),
+      candidate_(dim),
+      direction_(dim),
+      subgradient_(dim)
+   {
+      assert(o_.max_bundle_size >= 2);
+      assert(o_.serious_step_fraction > 0.0 && o_.serious_step_fraction < 1.0);
+   }
+
+   // evaluate oracle at the initial center
+   template<typename ORACLE>
+   void init(ORACLE& oracle)
+   {
+      f_center_ = oracle(center_, subgradient_);
+      no_cuts_ = 0;
+      add_cut(0.0, subgradient_);
+      lambda_[0] = 1.0;
+      Q_lambda_[0] = Q(0,0);
+   }
+
+   // one bundle iteration. Returns true for a serious step, i.e. when the center moved.
+   template<typename ORACLE>
+   bool step(ORACLE& oracle)
+   {
+      assert(no_cuts_ > 0);
+      solve_qp();
+
+      // direction d = 1/u sum_i lambda_i g_i, predicted increase = alpha^T lambda + lambda^T Q lambda / u
+      std::fill(direction_.begin(), direction_.end(), 0.0);
+      for(INDEX i=0; i<no_cuts_; ++i) {
+         if(lambda_[i] == 0.0) { continue; }
+         const REAL s = lambda_[i] / u_;
+         const REAL* g = cut(i);
+#pragma omp parallel for
+         for(INDEX k=0; k<dim_; ++k) {
+            direction_[k] += s*g[k];
+         }
+      }
+      REAL alpha_lambda = 0.0;
+      REAL lambda_Q_lambda = 0.0;
+      for(INDEX i=0; i<no_cuts_; ++i) {
+         alpha_lambda += alpha_[i]*lambda_[i];
+         lambda_Q_lambda += lambda_[i]*Q_lambda_[i];
+      }
+      predicted_increase_ = alpha_lambda + lambda_Q_lambda / u_;
+      if(converged()) {
+         return false;
+      }
+
+      for(INDEX k=0; k<dim_; ++k) {
+         candidate_[k] = center_[k] + direction_[k];
+      }
+      const REAL f_candidate = oracle(candidate_, subgradient_);
+
+      // dot products of the new supergradient with d and all cuts
+      REAL g_d = 0.0;
+      REAL g_g = 0.0;
+#pragma omp parallel for reduction(+:g_d,g_g)
+      for(INDEX k=0; k<dim_; ++k) {
+         g_d += subgradient_[k]*direction_[k];
+         g_g += subgradient_[k]*subgradient_[k];
+      }
+      for(INDEX i=0; i<no_cuts_; ++i) {
+         const REAL* g = cut(i);
+         REAL d = 0.0;
+#pragma omp parallel for reduction(+:d)
+         for(INDEX k=0; k<dim_; ++k) {
+            d += g[k]*subgradient_[k];
+         }
+         dots_[i] = d;
+      }
+
+      const REAL increase = f_candidate - f_center_;
+      const REAL alpha_new = std::max(REAL(0.0), f_candidate - g_d - f_center_); // cut at candidate, relative to the current center
+      if(no_cuts_ == o_.max_bundle_size) {
+         make_room();
+      }
+      add_cut(alpha_new, subgradient_, g_g);
+
+      const bool serious = increase >= o_.serious_step_fraction * predicted_increase_;
+      if(serious) {
+         // shift linearization errors to the new center: alpha_i += <g_i, d> - increase, where <g_i, d> = (Q lambda)_i / u
+         for(INDEX i=0; i+1<no_cuts_; ++i) {
+            alpha_[i] = std::max(REAL(0.0), alpha_[i] + Q_lambda_[i]/u_ - increase);
+         }
+         alpha_[no_cuts_-1] = 0.0;
+         std::swap(center_, candidate_);
+         f_center_ = f_candidate;
+         if(increase >= 0.5 * predicted_increase_) {
+            u_ = std::max(o_.min_proximal_weight, 0.5*u_);
+         }
+      } else if(alpha_new > 10.0*predicted_increase_) {
+         // model far off at the candidate: step was too long
+         u_ = std::min(o_.max_proximal_weight, 2.0*u_);
+      }
+      return serious;
+   }
+
+   // predicted increase is an upper bound on the possible improvement for the current model
+   bool converged() const { return predicted_increase_ <= o_.tolerance * (1.0 + std::abs(f_center_)); }
+
+   REAL value() const { return f_center_; }
+   const std::vector<REAL>& center() const { return center_; }
+   REAL predicted_increase() const { return predicted_increase_; }
+   REAL proximal_weight() const { return u_; }
+   INDEX no_cuts() const { return no_cuts_; }
+
+private:
+   REAL* cut(const INDEX i) { return &cuts_[std::size_t(i)*dim_]; }
+   REAL& Q(const INDEX i, const INDEX j) { return Q_[i*o_.max_bundle_size + j]; }
+
+   // append cut with dot products to the other cuts in dots_. Its multiplier is zero, hence Q lambda is unchanged except for the new entry.
+   template<typename VECTOR>
+   void add_cut(const REAL alpha, const VECTOR& g, const REAL g_g)
+   {
+      assert(no_cuts_ < o_.max_bundle_size);
+      const INDEX k = no_cuts_++;
+      std::copy(g.begin(), g.end(), cut(k));
+      alpha_[k] = alpha;
+      lambda_[k] = 0.0;
+      Q(k,k) = g_g;
+      Q_lambda_[k] = 0.0;
+      for(INDEX i=0; i<k; ++i) {
+         Q(i,k) = dots_[i];
+         Q(k,i) = dots_[i];
+         Q_lambda_[k] += lambda_[i]*dots_[i];
+      }
+   }
+   template<typename VECTOR>
+   void add_cut(const REAL alpha, const VECTOR& g)
+   {
+      assert(no_cuts_ == 0);
+      add_cut(alpha, g, std::inner_product(g.begin(), g.end(), g.begin(), 0.0));
+   }
+
+   // drop cuts with zero multiplier. If all are active, replace them by their aggregate sum_i lambda_i (g_i, alpha_i), which keeps the current subproblem solution.
+   void make_room()
+   {
+      INDEX k = 0;
+      for(INDEX i=0; i<no_cuts_; ++i) {
+         if(lambda_[i] > 0.0) {
+            kept_[k++] = i;
+         }
+      }
+      if(k < no_cuts_) {
+         // kept_[a] >= a, hence moving entries in increasing order never overwrites an entry still to be read
+         for(INDEX a=0; a<k; ++a) {
+            const INDEX i = kept_[a];
+            if(i != a) {
+               std::copy(cut(i), cut(i) + dim_, cut(a));
+            }
+            alpha_[a] = alpha_[i];
+            lambda_[a] = lambda_[i];
+            Q_lambda_[a] = Q_lambda_[i];
+            dots_[a] = dots_[i];
+            for(INDEX b=0; b<k; ++b) {
+               Q(a,b) = Q(i,kept_[b]);
+            }
+         }
+         no_cuts_ = k;
+         return;
+      }
+
+      REAL* g = cut(0);
+      const REAL s_0 = lambda_[0];
+#pragma omp parallel for
+      for(INDEX l=0; l<dim_; ++l) {
+         g[l] *= s_0;
+      }
+      for(INDEX i=1; i<no_cuts_; ++i) {
+         const REAL* g_i = cut(i);
+         const REAL s = lambda_[i];
+#pragma omp parallel for
+         for(INDEX l=0; l<dim_; ++l) {
+            g[l] += s*g_i[l];
+         }
+      }
+      REAL alpha = 0.0;
+      REAL lambda_Q_lambda = 0.0;
+      REAL dot = 0.0;
+      for(INDEX i=0; i<no_cuts_; ++i) {
+         alpha += lambda_[i]*alpha_[i];
+         lambda_Q_lambda += lambda_[i]*Q_lambda_[i];
+         dot += lambda_[i]*dots_[i];
+      }
+      alpha_[0] = alpha;
+      lambda_[0] = 1.0;
+      Q(0,0) = lambda_Q_lambda;
+      Q_lambda_[0] = lambda_Q_lambda;
+      dots_[0] = dot;
+      no_cuts_ = 1;
+   }
+
+   // pairwise coordinate descent: move weight from the active cut with largest gradient to the one with smallest gradient, with exact line search
+   void solve_qp()
+   {
+      for(INDEX iter=0; iter<o_.max_qp_iterations; ++iter) {
+         INDEX i_max = no_cuts_;
+         INDEX i_min = 0;
+         REAL grad_max = -std::numeric_limits<REAL>::infinity();
+         REAL grad_min = std::numeric_limits<REAL>::infinity();
+         for(INDEX i=0; i<no_cuts_; ++i) {
+            const REAL grad = Q_lambda_[i]/u_ + alpha_[i];
+            if(lambda_[i] > 0.0 && grad > grad_max) { grad_max = grad; i_max = i; }
+            if(grad < grad_min) { grad_min = grad; i_min = i; }
+         }
+         assert(i_max < no_cuts_);
+         if(i_max == i_min || grad_max - grad_min <= o_.tolerance) { break; }
+
+         const REAL curvature = (Q(i_max,i_max) + Q(i_min,i_min) - 2.0*Q(i_max,i_min)) / u_;
+         REAL t = lambda_[i_max];
+         if(curvature > 0.0) {
+            t = std::min(t, (grad_max - grad_min) / curvature);
+         }
+         lambda_[i_max] -= t;
+         lambda_[i_min] += t;
+         if(lambda_[i_max] < o_.tolerance) {
+            lambda_[i_min] += lambda_[i_max];
+            t += lambda_[i_max];
+            lambda_[i_max] = 0.0;
+         }
+         for(INDEX k=0; k<no_cuts_; ++k) {
+            Q_lambda_[k] += t*(Q(k,i_min) - Q(k,i_max));
+         }
+      }
+   }
+
+   const INDEX dim_;
+   const options o_;
+   REAL u_;
+
+   INDEX no_cuts_ = 0;
+   std::vector<REAL> cuts_; // max_bundle_size x dim, row-wise
+   std::vector<REAL> alpha_;
+   std::vector<REAL> lambda_;
+   std::vector<REAL> Q_; // max_bundle_size x max_bundle_size
+   std::vector<REAL> Q_lambda_;
+   std::vector<REAL> dots_; // scalar products of cuts with the newest supergradient
+   std::vector<INDEX> kept_;
+
+   std::vector<REAL> center_;
+   std::vector<REAL> candidate_;
+   std::vector<REAL> direction_;
+   std::vector<REAL> subgradient_;
+   REAL f_center_ = -std::numeric_limits<REAL>::infinity();
+   REAL predicted_increase_ = std::numeric_limits<REAL>::infinity();
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_PROXIMAL_BUNDLE_HXX
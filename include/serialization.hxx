@@ -6,6 +6,7 @@
 #include "vector.hxx"
 #include <bitset>
 #include <cstring>
+#include <cstddef>
 
 namespace LP_MP {
 
@@ -14,16 +15,16 @@ namespace LP_MP {
 template<typename T>
 class binary_data {
 public:
-   binary_data(T* const _p, const INDEX _no_elements) : pointer(_p), no_elements(_no_elements) {}
+   binary_data(T* const _p, const std::size_t _no_elements) : pointer(_p), no_elements(_no_elements) {}
    T* const pointer;
-   const INDEX no_elements; 
+   const std::size_t no_elements; 
 };
 
 class allocate_archive {
 public:
   // for plain data
   template<typename T>
-  static typename std::enable_if<std::is_arithmetic<T>::value,INDEX>::type
+  static typename std::enable_if<std::is_arithmetic<T>::value,std::size_t>::type
   serialize(const T&)
   {
     return sizeof(T); 
@@ -31,46 +32,46 @@ public:
   
   // for arrays
   template<typename T>
-  static INDEX serialize(const T*, const INDEX s)
+  static std::size_t serialize(const T*, const std::size_t s)
   {
     return sizeof(T)*s;
   }
   template<typename T>
-  static INDEX serialize( const binary_data<T> b )
+  static std::size_t serialize( const binary_data<T> b )
   {
      return serialize(b.pointer, b.no_elements); 
   }
 
   // for std::array<T>
   template<typename T, std::size_t N>
-  static INDEX serialize(const std::array<T,N>&)
+  static std::size_t serialize(const std::array<T,N>&)
   {
     return sizeof(T)*N;
   }
 
   // for vector<T>
   template<typename T>
-  static INDEX serialize(const vector<T>& v)
+  static std::size_t serialize(const vector<T>& v)
   {
      return serialize(v.begin(), v.size());
   }
 
   template<typename T>
-  static INDEX serialize(const matrix<T>& m)
+  static std::size_t serialize(const matrix<T>& m)
   {
      return m.size()*sizeof(T);
   }
 
   // for std::vector<T>
   template<typename T>
-  static INDEX serialize(const std::vector<T>& v)
+  static std::size_t serialize(const std::vector<T>& v)
   {
      return serialize(v.data(), v.size());
   }
 
   // for std::bitset<N>
   template<std::size_t N>
-  static INDEX serialize(const std::bitset<N>& v)
+  static std::size_t serialize(const std::bitset<N>& v)
   {
      return sizeof(std::bitset<N>);
   }
@@ -85,13 +86,13 @@ public:
      (*this)(types...);
   }
 
-  INDEX size() const
+  std::size_t size() const
   {
     return size_in_bytes_; 
   }
 
 private:
-  INDEX size_in_bytes_ = 0;
+  std::size_t size_in_bytes_ = 0;
 };
 
 class serialization_archive {
@@ -106,7 +107,7 @@ public:
       serialization_fun(*it,s);
     }
 
-    const INDEX size_in_bytes = s.size();
+    const std::size_t size_in_bytes = s.size();
 
     archive_ = new char[size_in_bytes];
     end_ = archive_ + size_in_bytes;
@@ -116,7 +117,7 @@ public:
 
   serialization_archive(const allocate_archive& a)
   {
-     const INDEX size_in_bytes = a.size();
+     const std::size_t size_in_bytes = a.size();
 
      archive_ = new char[size_in_bytes];
      assert(archive_ != nullptr);
@@ -126,7 +127,7 @@ public:
 
   serialization_archive(const serialization_archive& o)
   {
-     const INDEX size_in_bytes = o.size();
+     const std::size_t size_in_bytes = o.size();
 
      archive_ = new char[size_in_bytes];
      assert(archive_ != nullptr);
@@ -141,18 +142,21 @@ public:
      archive_ = o.archive_;
      end_ = o.end_;
      cur_ = o.cur_;
+     owns_memory_ = o.owns_memory_;
 
      o.archive_ = nullptr;
      o.end_ = nullptr;
      o.cur_ = nullptr;
   }
 
-  serialization_archive(const void* mem, INDEX size_in_bytes)
+  // view onto memory held elsewhere. The memory is not freed by release_memory or the destructor.
+  serialization_archive(const void* mem, const std::size_t size_in_bytes)
   {
      assert(mem != nullptr);
      archive_ = (char*) mem;
      cur_ = archive_;
      end_ = archive_ + size_in_bytes;
+     owns_memory_ = false;
   }
 
   ~serialization_archive()
@@ -160,7 +164,7 @@ public:
      release_memory();
   }
 
-  void aquire_memory(const INDEX size_in_bytes)
+  void aquire_memory(const std::size_t size_in_bytes)
   {
      release_memory();
      archive_ = new char[size_in_bytes];
@@ -172,7 +176,10 @@ public:
   void release_memory()
   {
      if(archive_ != nullptr) {
-        delete[] archive_;
+        if(owns_memory_) {
+           delete[] archive_;
+        }
+        owns_memory_ = true;
         archive_ = nullptr;
         cur_ = nullptr;
         end_ = nullptr;
@@ -187,7 +194,7 @@ public:
      return std::memcmp(archive_, o.archive_, size()) == 0;
   }
 
-  INDEX size() const 
+  std::size_t size() const 
   {
      return end_ - archive_;
   }
@@ -197,7 +204,12 @@ public:
     return cur_;
   }
 
-  void advance(const SIGNED_INDEX bytes) 
+  char* data() const
+  {
+    return archive_;
+  }
+
+  void advance(const std::ptrdiff_t bytes) 
   {
     cur_ += bytes;
     assert(cur_ >= archive_);
@@ -212,7 +224,8 @@ public:
 private:
   char* archive_ = nullptr;
   char* end_ = nullptr;
-  char* cur_;
+  char* cur_ = nullptr;
+  bool owns_memory_ = true;
 
 };
 
@@ -227,11 +240,11 @@ public:
 
   // for arrays
   template<typename T>
-  void serialize(const T* p, const INDEX size)
+  void serialize(const T* p, const std::size_t size)
   {
-      INDEX* s = (INDEX*) ar.cur_address();
+      T* s = (T*) ar.cur_address();
       std::memcpy((void*) s, (void*) p, size*sizeof(T));
-      const INDEX size_in_bytes = sizeof(T)*size;
+      const std::size_t size_in_bytes = sizeof(T)*size;
       ar.advance(size_in_bytes);
   }
   template<typename T>
@@ -249,7 +262,7 @@ public:
        *s = x;
        ++s; 
     }
-    const INDEX size_in_bytes = sizeof(T)*N;
+    const std::size_t size_in_bytes = sizeof(T)*N;
     ar.advance(size_in_bytes);
   } 
  
@@ -268,7 +281,7 @@ public:
        *s = *it;
        ++s; 
      }
-     const INDEX size_in_bytes = sizeof(T)*m.size();
+     const std::size_t size_in_bytes = sizeof(T)*m.size();
      ar.advance(size_in_bytes);
   }
 
@@ -281,7 +294,7 @@ public:
 
   // for std::bitset<N>
   template<std::size_t N>
-  static INDEX serialize(const std::bitset<N>& v)
+  static std::size_t serialize(const std::bitset<N>& v)
   {
     assert(false);
   }
@@ -325,11 +338,11 @@ public:
 
    // for arrays
   template<typename T>
-  void serialize(T* pointer, const INDEX size)
+  void serialize(T* pointer, const std::size_t size)
   {
       T* s = (T*) ar.cur_address();
       std::memcpy((void*) pointer, (void*) s, size*sizeof(T));
-      const INDEX size_in_bytes = sizeof(T)*size;
+      const std::size_t size_in_bytes = sizeof(T)*size;
       ar.advance(size_in_bytes);
   }
   template<typename T>
@@ -347,7 +360,7 @@ public:
        x = *s;
        ++s; 
     }
-    const INDEX size_in_bytes = sizeof(T)*N;
+    const std::size_t size_in_bytes = sizeof(T)*N;
     ar.advance(size_in_bytes);
   } 
  
@@ -366,7 +379,7 @@ public:
        *it = *s;
        ++s; 
      }
-     const INDEX size_in_bytes = sizeof(T)*m.size();
+     const std::size_t size_in_bytes = sizeof(T)*m.size();
      ar.advance(size_in_bytes);
   }
 
@@ -379,7 +392,7 @@ public:
 
   // for std::bitset<N>
   template<std::size_t N>
-  static INDEX serialize(const std::bitset<N>& v)
+  static std::size_t serialize(const std::bitset<N>& v)
   {
     assert(false);
   }
@@ -421,10 +434,10 @@ public:
 
    // for arrays
    template<typename T, typename OP>
-     void serialize(T* pointer, const INDEX size, OP op)
+     void serialize(T* pointer, const std::size_t size, OP op)
      {
        static_assert(std::is_same<T,float>::value || std::is_same<T,double>::value,"");
-       for(INDEX i=0; i<size; ++i) {
+       for(std::size_t i=0; i<size; ++i) {
          pointer[i] = op(pointer[i], T(val_));
        }
      }
@@ -516,14 +529,14 @@ public:
 
    // for arrays
    template<typename T>
-     void serialize(T* pointer, const INDEX size)
+     void serialize(T* pointer, const std::size_t size)
      {
        static_assert(std::is_same<T,float>::value || std::is_same<T,double>::value,"");
        T* val = (T*) ar.cur_address();
-       for(INDEX i=0; i<size; ++i) {
+       for(std::size_t i=0; i<size; ++i) {
          pointer[i] += T(scaling_) * val[i]; 
        }
-       const INDEX size_in_bytes = sizeof(T)*size;
+       const std::size_t size_in_bytes = sizeof(T)*size;
        ar.advance(size_in_bytes);
      }
    template<typename T>
@@ -542,7 +555,7 @@ public:
          x += T(scaling_) * (*s);
          ++s; 
        }
-       const INDEX size_in_bytes = sizeof(T)*N;
+       const std::size_t size_in_bytes = sizeof(T)*N;
        ar.advance(size_in_bytes);
      } 
 
@@ -562,7 +575,7 @@ public:
          *it += T(scaling_) * (*val); 
          ++val;
        }
-       const INDEX size_in_bytes = sizeof(T)*m.size();
+       const std::size_t size_in_bytes = sizeof(T)*m.size();
        ar.advance(size_in_bytes);
      }
 
@@ -575,7 +588,7 @@ public:
 
   // for std::bitset<N>
   template<std::size_t N>
-  static INDEX serialize(const std::bitset<N>& v)
+  static std::size_t serialize(const std::bitset<N>& v)
   {
     assert(false);
   }
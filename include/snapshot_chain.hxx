@@ -0,0 +1,291 @@
+#ifndef LP_MP_SNAPSHOT_CHAIN_HXX
+#define LP_MP_SNAPSHOT_CHAIN_HXX
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+
+namespace LP_MP {
+
+// Sequence of binary snapshots (e.g. the dual held in a factor_archive), each stored as the XOR against its predecessor.
+// Unchanged 8 byte words XOR to zero and are run-length encoded, changed words only store their nonzero low order bytes.
+// For doubles differing slightly, sign, exponent and high mantissa bytes coincide, so most of their XOR is zero as well.
+// Every keyframe_interval-th snapshot (and every snapshot whose size differs from its predecessor) is a keyframe, i.e. encoded against zero.
+class snapshot_chain {
+public:
+   snapshot_chain(const std::size_t keyframe_interval = 16)
+      : keyframe_interval_(keyframe_interval)
+   {
+      assert(keyframe_interval_ > 0);
+   }
+
+   // returns index of the snapshot
+   std::size_t push(const char* data, const std::size_t size)
+   {
+      const bool keyframe = frames_.empty() || size != last_.size() || (frames_.size() - last_keyframe_) >= keyframe_interval_;
+      if(keyframe) {
+         last_.assign(size, 0);
+         last_keyframe_ = frames_.size();
+      }
+
+      frame f;
+      f.keyframe = keyframe;
+      f.size = size;
+      encode(data, last_.data(), size, f.data);
+      std::memcpy(last_.data(), data, size);
+      frames_.push_back(std::move(f));
+      return frames_.size()-1;
+   }
+
+   std::size_t no_snapshots() const { return frames_.size(); }
+   std::size_t snapshot_size(const std::size_t k) const { assert(k < frames_.size()); return frames_[k].size; }
+
+   // bytes needed to store the chain
+   std::size_t encoded_size() const
+   {
+      std::size_t s = 0;
+      for(const auto& f : frames_) { s += f.data.size(); }
+      return s;
+   }
+
+   // write snapshot k into out, which must hold snapshot_size(k) bytes
+   void reconstruct(const std::size_t k, char* out) const
+   {
+      assert(k < frames_.size());
+      std::size_t j = k;
+      while(!frames_[j].keyframe) { --j; }
+      std::memset(out, 0, frames_[k].size);
+      for(; j<=k; ++j) {
+         assert(frames_[j].size == frames_[k].size && !frames_[j].released);
+         if(!decode(frames_[j].data, out, frames_[j].size)) { throw std::runtime_error("corrupted snapshot chain"); }
+      }
+   }
+
+   void write(std::ostream& s) const
+   {
+      write_header(s);
+      write_pod(s, std::uint64_t(frames_.size()));
+      for(std::size_t k=0; k<frames_.size(); ++k) {
+         write_frame(s, k);
+      }
+   }
+
+   static snapshot_chain read(std::istream& s)
+   {
+      auto c = read_header(s);
+      std::uint64_t no_frames = 0;
+      read_pod(s, no_frames);
+      if(!s.good()) { throw std::runtime_error("could not read snapshot chain"); }
+      for(std::size_t i=0; i<no_frames; ++i) {
+         if(!c.read_frame(s)) { throw std::runtime_error("could not read snapshot chain"); }
+      }
+      return c;
+   }
+
+   // Chains can also be written incrementally: the header once, then each frame after it has been pushed.
+   // Such streams are read frame by frame until read_frame fails, e.g. at a frame truncated by a crash.
+   void write_header(std::ostream& s) const
+   {
+      write_pod(s, std::uint64_t(keyframe_interval_));
+   }
+
+   static snapshot_chain read_header(std::istream& s)
+   {
+      std::uint64_t keyframe_interval;
+      read_pod(s, keyframe_interval);
+      if(!s.good() || keyframe_interval == 0) { throw std::runtime_error("could not read snapshot chain"); }
+      return snapshot_chain(keyframe_interval);
+   }
+
+   void write_frame(std::ostream& s, const std::size_t k) const
+   {
+      assert(k < frames_.size() && !frames_[k].released);
+      const auto& f = frames_[k];
+      write_pod(s, std::uint8_t(f.keyframe));
+      write_pod(s, std::uint64_t(f.size));
+      write_pod(s, std::uint64_t(f.data.size()));
+      s.write(reinterpret_cast<const char*>(f.data.data()), f.data.size());
+   }
+
+   // append next frame from stream. Returns false and leaves the chain unchanged if no complete and valid frame could be read.
+   bool read_frame(std::istream& s)
+   {
+      frame f;
+      std::uint8_t keyframe;
+      std::uint64_t size, data_size;
+      read_pod(s, keyframe);
+      read_pod(s, size);
+      read_pod(s, data_size);
+      if(!s.good() || keyframe > 1 || (frames_.empty() && !keyframe) || (!keyframe && size != last_.size())) { return false; }
+      if(size > std::numeric_limits<std::size_t>::max() - 7 || data_size / max_encoded_word_size > no_words(size)) { return false; }
+      f.keyframe = keyframe;
+      f.size = size;
+      // read in chunks, so that a corrupted data size cannot allocate more memory than the stream holds
+      constexpr std::uint64_t chunk_size = 1 << 20;
+      while(f.data.size() < data_size) {
+         const std::size_t offset = f.data.size();
+         const std::size_t n = std::min(chunk_size, data_size - offset);
+         f.data.resize(offset + n);
+         s.read(reinterpret_cast<char*>(f.data.data() + offset), n);
+         if(!s.good()) { return false; }
+      }
+      if(!decode(f.data, nullptr, size)) { return false; }
+
+      if(f.keyframe) {
+         last_.assign(size, 0);
+         last_keyframe_ = frames_.size();
+      }
+      decode(f.data, last_.data(), size);
+      frames_.push_back(std::move(f));
+      return true;
+   }
+
+   // free encoded frames, e.g. after they have been written. The chain can still be extended, but released snapshots cannot be reconstructed anymore.
+   void release_frames()
+   {
+      for(auto& f : frames_) {
+         std::vector<std::uint8_t>().swap(f.data);
+         f.released = true;
+      }
+   }
+
+private:
+   struct frame {
+      bool keyframe;
+      bool released = false;
+      std::size_t size;
+      std::vector<std::uint8_t> data;
+   };
+
+   template<typename T>
+   static void write_pod(std::ostream& s, const T& x) { s.write(reinterpret_cast<const char*>(&x), sizeof(T)); }
+   template<typename T>
+   static void read_pod(std::istream& s, T& x) { s.read(reinterpret_cast<char*>(&x), sizeof(T)); }
+
+   static void put_varint(std::vector<std::uint8_t>& out, std::uint64_t x)
+   {
+      while(x >= 0x80) {
+         out.push_back(std::uint8_t(x) | 0x80);
+         x >>= 7;
+      }
+      out.push_back(std::uint8_t(x));
+   }
+   // returns false if the varint is not terminated before end or does not fit into 64 bits
+   static bool get_varint(const std::uint8_t*& p, const std::uint8_t* const end, std::uint64_t& x)
+   {
+      x = 0;
+      for(std::size_t shift=0; shift<64; shift+=7) {
+         if(p == end) { return false; }
+         const std::uint8_t b = *p++;
+         x |= std::uint64_t(b & 0x7f) << shift;
+         if(!(b & 0x80)) { return true; }
+      }
+      return false;
+   }
+
+   static std::size_t no_words(const std::size_t size) { return (size + 7) / 8; }
+   // a word is encoded by at most two varints (for a block of its own) and a byte count followed by eight bytes
+   static constexpr std::size_t max_encoded_word_size = 2*10 + 1 + 8;
+
+   static std::uint64_t load_word(const char* p, const std::size_t bytes)
+   {
+      std::uint64_t w = 0;
+      std::memcpy(&w, p, bytes);
+      return w;
+   }
+
+   // xor words of cur and prev. Emit blocks of (zero word run, literal count, literals), each literal stored as byte count followed by its low order bytes.
+   static void encode(const char* cur, const char* prev, const std::size_t size, std::vector<std::uint8_t>& out)
+   {
+      out.clear();
+      const std::size_t no_words = snapshot_chain::no_words(size);
+      auto xor_word = [&](const std::size_t i) {
+         const std::size_t bytes = std::min(std::size_t(8), size - 8*i);
+         return load_word(cur + 8*i, bytes) ^ load_word(prev + 8*i, bytes);
+      };
+
+      std::size_t i = 0;
+      while(i < no_words) {
+         std::size_t zero_run = 0;
+         while(i < no_words && xor_word(i) == 0) { ++zero_run; ++i; }
+         std::size_t literal_end = i;
+         while(literal_end < no_words && xor_word(literal_end) != 0) { ++literal_end; }
+         put_varint(out, zero_run);
+         put_varint(out, literal_end - i);
+         for(; i<literal_end; ++i) {
+            std::uint64_t w = xor_word(i);
+            std::uint8_t no_bytes = 8;
+            while(no_bytes > 0 && (w >> (8*(no_bytes-1))) == 0) { --no_bytes; }
+            out.push_back(no_bytes);
+            for(std::uint8_t b=0; b<no_bytes; ++b) {
+               out.push_back(std::uint8_t(w >> (8*b)));
+            }
+         }
+      }
+   }
+
+   // xor encoded delta onto out. Returns false if in is no valid encoding of size bytes, in which case out may have been partially written.
+   // With out == nullptr the encoding is only validated.
+   static bool decode(const std::vector<std::uint8_t>& in, char* out, const std::size_t size)
+   {
+      const std::uint8_t* p = in.data();
+      const std::uint8_t* const end = in.data() + in.size();
+      const std::size_t no_words = snapshot_chain::no_words(size);
+      std::size_t i = 0;
+      while(p < end) {
+         std::uint64_t zero_run, no_literals;
+         if(!get_varint(p, end, zero_run) || zero_run > no_words - i) { return false; }
+         i += zero_run;
+         if(!get_varint(p, end, no_literals) || no_literals > no_words - i || zero_run + no_literals == 0) { return false; }
+         for(std::uint64_t l=0; l<no_literals; ++l, ++i) {
+            const std::size_t bytes = std::min(std::size_t(8), size - 8*i);
+            if(p == end || *p > bytes || std::size_t(end - p) <= *p) { return false; }
+            const std::uint8_t no_bytes = *p++;
+            std::uint64_t w = 0;
+            for(std::uint8_t b=0; b<no_bytes; ++b) {
+               w |= std::uint64_t(*p++) << (8*b);
+            }
+            if(out != nullptr) {
+               const std::uint64_t x = load_word(out + 8*i, bytes) ^ w;
+               std::memcpy(out + 8*i, &x, bytes);
+            }
+         }
+      }
+      // the encoder covers every word
+      return i == no_words;
+   }
+
+   std::size_t keyframe_interval_;
+   std::size_t last_keyframe_ = 0;
+   std::vector<frame> frames_;
+   std::vector<char> last_; // most recent snapshot, against which the next one is encoded
+};
+
+// store current content of a factor_archive in the chain
+template<typename FACTOR_ARCHIVE>
+std::size_t push_snapshot(snapshot_chain& chain, FACTOR_ARCHIVE& fa)
+{
+   fa.save_all();
+   return chain.push(fa.data(), fa.size());
+}
+
+// write snapshot k back into the factors of a factor_archive
+template<typename FACTOR_ARCHIVE>
+void load_snapshot(const snapshot_chain& chain, const std::size_t k, FACTOR_ARCHIVE& fa)
+{
+   if(chain.snapshot_size(k) != fa.size()) {
+      throw std::runtime_error("snapshot does not match factor archive");
+   }
+   chain.reconstruct(k, fa.data());
+   fa.load_all();
+}
+
+} // namespace LP_MP
+
+#endif // LP_MP_SNAPSHOT_CHAIN_HXX
@@ -7,6 +7,10 @@
 #include <condition_variable>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <cmath>
 
 #include "LP_MP.h"
 #include "function_existence.hxx"
@@ -14,6 +18,8 @@
 #include "static_if.hxx"
 #include "tclap/CmdLine.h"
 #include "lp_interface/lp_interface.h"
+#include "checkpoint.hxx"
+#include "mem_use.c"
 
 namespace LP_MP {
 
@@ -59,6 +65,12 @@ private:
         inputFileArg_("i","inputFile","file from which to read problem instance",false,"","file name",cmd_),
         outputFileArg_("o","outputFile","file to write solution",false,"","file name",cmd_),
         verbosity_arg_("v","verbosity","verbosity level: 0 = silent, 1 = important runtime information, 2 = further diagnostics",false,1,"0,1,2",cmd_),
+        checkpointFileArg_("","checkpointFile","file into which the dual state is periodically written",false,"","file name",cmd_),
+        checkpointIntervalArg_("","checkpointInterval","write checkpoint every n iterations, 0 = never",false,0,"non-negative integer",cmd_),
+        checkpointTimeArg_("","checkpointTime","write checkpoint every t seconds, 0 = never",false,0,"seconds",cmd_),
+        checkpointDeltaArg_("","checkpointDelta","keep all checkpoints in checkpointFile, each stored as compressed difference to its predecessor. resumeFrom continues from the last one",cmd_,false),
+        resumeFromArg_("","resumeFrom","checkpoint file from which to resume optimization after the model has been constructed",false,"","file name",cmd_),
+        retireFactorsAfterArg_("","retireFactorsAfter","remove tightening factors whose reparametrization has been zero for n iterations, checked before tightening, 0 = never",false,0,"non-negative integer",cmd_),
         visitor_(cmd_)
    {
       for_each_tuple(this->problemConstructor_, [this](auto& l) {
@@ -88,6 +100,10 @@ public:
          outputFile_ = outputFileArg_.getValue();
          verbosity = verbosity_arg_.getValue();
          if(verbosity > 2) { throw TCLAP::ArgException("verbosity must be 0,1 or 2"); }
+         if(checkpointFileArg_.isSet() && checkpointIntervalArg_.getValue() == 0 && checkpointTimeArg_.getValue() == 0) {
+            throw TCLAP::ArgException("checkpointFile requires checkpointInterval or checkpointTime");
+         }
+         resume_pending_ = resumeFromArg_.isSet();
       } catch (TCLAP::ArgException &e) {
          std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl; 
          exit(1);
@@ -194,20 +210,74 @@ public:
    {
       return HasTighten<PROBLEM_CONSTRUCTOR, INDEX, INDEX>();
    }
+   template<typename PROBLEM_CONSTRUCTOR>
+   constexpr static bool
+   CanTightenWithBudget()
+   {
+      return HasTighten<PROBLEM_CONSTRUCTOR, INDEX, INDEX, REAL>();
+   }
 
    // maxConstraints gives maximum number of constraints to add for each problem constructor
-   INDEX Tighten(const INDEX maxConstraints) 
+   // time_budget (seconds) is shared among all problem constructors. Those not supporting a budget run unrestricted.
+   INDEX Tighten(const INDEX maxConstraints, const REAL time_budget = std::numeric_limits<REAL>::infinity()) 
    {
       INDEX constraints_added = 0;
-      for_each_tuple(this->problemConstructor_, [this,maxConstraints,&constraints_added](auto* l) {
+      const auto begin_time = std::chrono::steady_clock::now();
+      for_each_tuple(this->problemConstructor_, [this,maxConstraints,time_budget,begin_time,&constraints_added](auto* l) {
             using pc_type = typename std::remove_pointer<decltype(l)>::type;
-            static_if<SolverType::CanTighten<pc_type>()>([&](auto f) {
-                  constraints_added += f(*l).Tighten(maxConstraints);
-            });
+            if constexpr(SolverType::CanTightenWithBudget<pc_type>()) {
+               const REAL remaining_time = time_budget - std::chrono::duration<REAL>(std::chrono::steady_clock::now() - begin_time).count();
+               constraints_added += l->Tighten(maxConstraints, std::max(remaining_time, REAL(0.0)));
+            } else if constexpr(SolverType::CanTighten<pc_type>()) {
+               constraints_added += l->Tighten(maxConstraints);
+            }
        });
 
       return constraints_added;
    }
+
+   // when a memory budget is given, the number of constraints is limited by the memory headroom divided by the memory observed per constraint in previous tightenings
+   INDEX TightenWithinMemory(const LpControl c)
+   {
+      if(c.memoryHeadroom == std::numeric_limits<std::size_t>::max()) {
+         return Tighten(c.tightenConstraints, c.tightenTimeBudget);
+      }
+      INDEX max_constraints = c.tightenConstraints;
+      if(memory_per_constraint_ > 0.0) {
+         max_constraints = std::min(REAL(max_constraints), std::floor(c.memoryHeadroom / memory_per_constraint_));
+      }
+      if(max_constraints == 0) { return 0; }
+      const std::size_t memory_before = memory_used(true);
+      const INDEX constraints_added = Tighten(max_constraints, c.tightenTimeBudget);
+      const std::size_t memory_after = memory_used(true);
+      if(constraints_added > 0) {
+         // resident memory grows in chunks, hence average over tightenings
+         const REAL m = REAL(memory_after > memory_before ? memory_after - memory_before : 0) / constraints_added;
+         memory_per_constraint_ = memory_per_constraint_ > 0.0 ? 0.5*(memory_per_constraint_ + m) : m;
+      }
+      return constraints_added;
+   }
+
+   LP_MP_FUNCTION_EXISTENCE_CLASS(HasRetireInactiveTriplets,retire_inactive_triplets)
+   template<typename PROBLEM_CONSTRUCTOR>
+   constexpr static bool
+   CanRetireInactiveFactors()
+   {
+      return HasRetireInactiveTriplets<PROBLEM_CONSTRUCTOR, INDEX, INDEX, INDEX>();
+   }
+
+   // remove tightening factors which have not been active for max_inactive_iterations
+   INDEX RetireInactiveFactors(const INDEX max_inactive_iterations)
+   {
+      INDEX factors_removed = 0;
+      for_each_tuple(this->problemConstructor_, [this,max_inactive_iterations,&factors_removed](auto* l) {
+            using pc_type = typename std::remove_pointer<decltype(l)>::type;
+            if constexpr(SolverType::CanRetireInactiveFactors<pc_type>()) {
+               factors_removed += l->retire_inactive_triplets(iter, max_inactive_iterations);
+            }
+      });
+      return factors_removed;
+   }
    
    template<INDEX PROBLEM_CONSTRUCTOR_NO>
    meta::at_c<ProblemDecompositionList, PROBLEM_CONSTRUCTOR_NO>& GetProblemConstructor() 
@@ -224,6 +294,13 @@ public:
    {
       return has_solution<VISITOR, void, std::string>();
    }
+
+   LP_MP_FUNCTION_EXISTENCE_CLASS(has_resume,resume)
+   constexpr static bool
+   visitor_has_resume()
+   {
+      return has_resume<VISITOR, void, INDEX, double>();
+   }
    
 
    
@@ -234,13 +311,55 @@ public:
       }
 
       this->Begin();
+      // the checkpoint is loaded in the first call only, later calls continue from the current dual, e.g. after a warm start
+      const bool resume = resume_pending_;
+      if(resume) {
+         Resume(resumeFromArg_.getValue());
+         resume_pending_ = false;
+      }
+      if(checkpointFileArg_.isSet()) {
+         checkpoint_writer_ = std::make_unique<checkpoint_writer>(checkpointFileArg_.getValue(), checkpointDeltaArg_.getValue());
+         last_checkpoint_time_ = std::chrono::steady_clock::now();
+      }
+      solve_begin_time_ = std::chrono::steady_clock::now();
       LpControl c = visitor_.begin(this->lp_);
+      if(resume) {
+         // iteration limit and timeout continue from where the checkpointed run stopped
+         static_if<visitor_has_resume()>([this](auto f) {
+               f(this)->visitor_.resume(this->iter, this->resumed_time_);
+         });
+      }
+      solver_phase_times total_phase_time = {};
+      double previous_visitor_time = 0.0;
+      lp_.take_weight_computation_time();
       while(!c.end && !c.error) {
-         this->PreIterate(c);
-         this->Iterate(c);
-         this->PostIterate(c);
-         c = visitor_.visit(c, this->lowerBound_, this->bestPrimalCost_);
+         phase_timer_.reset();
+         {
+            auto t = phase_timer_.measure(solver_phase::message_passing);
+            this->PreIterate(c);
+            this->Iterate(c);
+            this->PostIterate(c);
+         }
+         phase_timer_.transfer(solver_phase::message_passing, solver_phase::weights, lp_.take_weight_computation_time());
+         {
+            // visitor overhead is only known after the visitor returned, hence it is reported in the next iteration
+            c.phaseTime = phase_timer_.times();
+            c.phaseTime[std::size_t(solver_phase::visitor)] = previous_visitor_time;
+            auto t = phase_timer_.measure(solver_phase::visitor);
+            c = visitor_.visit(c, this->lowerBound_, this->bestPrimalCost_);
+         }
          ++iter;
+         {
+            auto t = phase_timer_.measure(solver_phase::checkpoint);
+            Checkpoint();
+         }
+         previous_visitor_time = phase_timer_.times()[std::size_t(solver_phase::visitor)];
+         for(std::size_t i=0; i<no_solver_phases; ++i) {
+            total_phase_time[i] += phase_timer_.times()[i];
+         }
+      }
+      if(checkpoint_writer_) {
+         checkpoint_writer_->flush();
       }
       if(!c.error) {
          this->End();
@@ -253,6 +372,9 @@ public:
          });
          this->WritePrimal();
       }
+      if(verbosity >= 1) {
+         print_phase_times(total_phase_time);
+      }
       return !c.error;
    }
 
@@ -278,12 +400,25 @@ public:
    virtual void PostIterate(LpControl c) 
    {
       if(c.computeLowerBound) {
+         auto t = phase_timer_.measure(solver_phase::lower_bound);
          lowerBound_ = lp_.LowerBound();
          assert(std::isfinite(lowerBound_));
       }
-      if(c.tighten) {
-         Tighten(c.tightenConstraints);
+      // under memory pressure no constraints are added and all tightening factors with zero reparametrization are retired,
+      // once when pressure sets in and again whenever tightening would have taken place
+      const bool memory_pressure = c.memoryHeadroom == 0;
+      if(memory_pressure && (c.tighten || !memory_pressure_)) {
+         auto t = phase_timer_.measure(solver_phase::tighten);
+         const INDEX removed = RetireInactiveFactors(0);
+         if(verbosity >= 1) { std::cout << "memory pressure: retired " << removed << " inactive factors\n"; }
+      } else if(c.tighten) {
+         auto t = phase_timer_.measure(solver_phase::tighten);
+         if(retireFactorsAfterArg_.getValue() > 0) {
+            RetireInactiveFactors(retireFactorsAfterArg_.getValue());
+         }
+         TightenWithinMemory(c);
       }
+      memory_pressure_ = memory_pressure;
    } 
 
    // called after last iteration
@@ -320,6 +455,7 @@ public:
    // evaluate and register primal solution
    void RegisterPrimal()
    {
+      auto t = phase_timer_.measure(solver_phase::primal);
       const REAL cost = lp_.EvaluatePrimal();
       if(debug()) { std::cout << "register primal cost = " << cost << "\n"; }
       if(cost < bestPrimalCost_) {
@@ -331,6 +467,14 @@ public:
             }
             bestPrimalCost_ = cost;
             solution_ = write_primal_into_string();
+            // only needed for checkpoints
+            if(checkpointFileArg_.isSet()) {
+               if(best_primal_ != nullptr && best_primal_->matches(lp_.factor_begin(), lp_.factor_end())) {
+                  best_primal_->save_all();
+               } else {
+                  best_primal_ = std::make_unique<checkpoint_state::primal_archive>(lp_.factor_begin(), lp_.factor_end());
+               }
+            }
          } else {
             if(debug()) {
                std::cout << "solution infeasible\n";
@@ -339,9 +483,64 @@ public:
       }
    }
 
+   // after costs have been changed in place for a warm start, the primal of the previous problem is meaningless. The dual is kept and the next call to Solve continues from it.
+   void ResetPrimal()
+   {
+      bestPrimalCost_ = std::numeric_limits<REAL>::infinity();
+      solution_.clear();
+      best_primal_.reset();
+   }
+
    REAL lower_bound() const { return lowerBound_; }
    REAL primal_cost() const { return bestPrimalCost_; }
 
+   // summary of where the optimization loop spent its time
+   static void print_phase_times(const solver_phase_times& t)
+   {
+      const double total = std::accumulate(t.begin(), t.end(), 0.0);
+      std::cout << "time per phase:";
+      for(std::size_t i=0; i<no_solver_phases; ++i) {
+         std::cout << (i == 0 ? " " : ", ") << solver_phase_names[i] << " = " << t[i] << "s";
+         if(total > 0.0) {
+            std::cout << " (" << std::round(1000.0*t[i]/total)/10.0 << "%)";
+         }
+      }
+      std::cout << "\n";
+   }
+
+   // hand over snapshot of dual to background writer if checkpoint is due
+   void Checkpoint()
+   {
+      if(!checkpoint_writer_) { return; }
+      const INDEX interval = checkpointIntervalArg_.getValue();
+      const INDEX seconds = checkpointTimeArg_.getValue();
+      const auto now = std::chrono::steady_clock::now();
+      const bool due = (interval > 0 && iter % interval == 0) || (seconds > 0 && now - last_checkpoint_time_ >= std::chrono::seconds(seconds));
+      const double time = resumed_time_ + std::chrono::duration<double>(now - solve_begin_time_).count();
+      // factors added or removed by tightening since the best primal was found are not covered by it
+      const auto* best_primal = due && best_primal_ != nullptr && best_primal_->matches(lp_.factor_begin(), lp_.factor_end()) ? best_primal_.get() : nullptr;
+      if(due && checkpoint_writer_->submit(lp_.factor_begin(), lp_.factor_end(), iter, time, lowerBound_, bestPrimalCost_, solution_, best_primal)) {
+         last_checkpoint_time_ = now;
+         if(debug()) { std::cout << "checkpoint at iteration " << iter << "\n"; }
+      }
+   }
+
+   // load dual, best primal, iteration counter and time spent. Must be called after the model has been constructed.
+   // If the checkpoint contains the primal of the best solution, it is loaded into the factors as well.
+   void Resume(const std::string& filename)
+   {
+      auto c = checkpoint_file::read(filename, lp_.factor_begin(), lp_.factor_end());
+      iter = c.iteration;
+      resumed_time_ = c.time;
+      lowerBound_ = c.lower_bound;
+      bestPrimalCost_ = c.best_primal_cost;
+      solution_ = std::move(c.solution);
+      best_primal_ = std::move(c.primal);
+      if(verbosity > 0) {
+         std::cout << "resumed from " << filename << " at iteration " << iter << ", lower bound = " << lp_.LowerBound() << ", best primal = " << bestPrimalCost_ << "\n";
+      }
+   }
+
 protected:
    TCLAP::CmdLine cmd_;
 
@@ -368,13 +567,29 @@ protected:
 
    TCLAP::ValueArg<INDEX> verbosity_arg_;
 
+   TCLAP::ValueArg<std::string> checkpointFileArg_;
+   TCLAP::ValueArg<INDEX> checkpointIntervalArg_;
+   TCLAP::ValueArg<INDEX> checkpointTimeArg_;
+   TCLAP::SwitchArg checkpointDeltaArg_;
+   TCLAP::ValueArg<std::string> resumeFromArg_;
+   TCLAP::ValueArg<INDEX> retireFactorsAfterArg_;
+   std::unique_ptr<checkpoint_writer> checkpoint_writer_;
+   std::chrono::steady_clock::time_point last_checkpoint_time_;
+   std::chrono::steady_clock::time_point solve_begin_time_;
+   double resumed_time_ = 0.0; // seconds spent in optimization before resuming from a checkpoint
+   bool resume_pending_ = false;
+
    REAL lowerBound_;
    // while Solver does not know how to compute primal, derived solvers do know. After computing a primal, they are expected to register their primals with the base solver
    REAL bestPrimalCost_ = std::numeric_limits<REAL>::infinity();
    std::string solution_;
+   std::unique_ptr<checkpoint_state::primal_archive> best_primal_; // primal of all factors for the best solution, for checkpoints
 
    VISITOR visitor_;
    INDEX iter = 0;
+   solver_phase_timer phase_timer_; // times phases of the current iteration
+   bool memory_pressure_ = false;
+   REAL memory_per_constraint_ = 0.0; // resident bytes per constraint added in tightening
 };
 
 // local rounding interleaved with message passing 
@@ -430,6 +645,7 @@ public:
    {
       if(c.computePrimal) {
          // do zrobienia: possibly run this in own thread similar to lp solver
+         auto t = this->phase_timer_.measure(solver_phase::primal);
          ComputePrimal();
          this->RegisterPrimal();
       }
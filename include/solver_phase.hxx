@@ -0,0 +1,94 @@
+#ifndef LP_MP_SOLVER_PHASE_HXX
+#define LP_MP_SOLVER_PHASE_HXX
+
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cassert>
+
+namespace LP_MP {
+
+// phases of one solver iteration, timed separately by Solver::Solve
+enum class solver_phase : std::size_t { message_passing, weights, lower_bound, primal, tighten, visitor, checkpoint };
+constexpr std::array<const char*, 7> solver_phase_names = {"message_passing", "weights", "lower_bound", "primal", "tighten", "visitor", "checkpoint"};
+constexpr std::size_t no_solver_phases = solver_phase_names.size();
+
+using solver_phase_times = std::array<double, no_solver_phases>; // seconds
+
+// Accumulates wall clock time per phase with a monotonic clock. Phases nest: while an inner phase is measured, the outer one is paused, hence times of different phases never overlap.
+class solver_phase_timer {
+public:
+   class scope {
+   public:
+      scope(solver_phase_timer& t, const solver_phase p)
+         : timer_(t), previous_(t.current_), was_running_(t.running_)
+      {
+         timer_.switch_to(p);
+      }
+      ~scope()
+      {
+         if(was_running_) {
+            timer_.switch_to(previous_);
+         } else {
+            timer_.stop();
+         }
+      }
+      scope(const scope&) = delete;
+      scope& operator=(const scope&) = delete;
+   private:
+      solver_phase_timer& timer_;
+      const solver_phase previous_;
+      const bool was_running_;
+   };
+
+   solver_phase_timer() { reset(); }
+
+   scope measure(const solver_phase p) { return scope(*this, p); }
+
+   // move time already attributed to one phase into another, e.g. for work that is only known afterwards to have happened inside a phase
+   void transfer(const solver_phase from, const solver_phase to, const double t)
+   {
+      const double x = std::min(t, times_[index(from)]);
+      times_[index(from)] -= x;
+      times_[index(to)] += x;
+   }
+
+   // times of phases measured since the last reset
+   const solver_phase_times& times() const { return times_; }
+   void reset()
+   {
+      times_.fill(0.0);
+      current_ = solver_phase::message_passing;
+      running_ = false;
+   }
+
+private:
+   static constexpr std::size_t index(const solver_phase p) { return static_cast<std::size_t>(p); }
+
+   void switch_to(const solver_phase p)
+   {
+      const auto now = std::chrono::steady_clock::now();
+      if(running_) {
+         times_[index(current_)] += std::chrono::duration<double>(now - begin_).count();
+      }
+      begin_ = now;
+      current_ = p;
+      running_ = true;
+   }
+
+   void stop()
+   {
+      switch_to(current_);
+      running_ = false;
+   }
+
+   solver_phase_times times_;
+   solver_phase current_;
+   bool running_;
+   std::chrono::steady_clock::time_point begin_;
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_SOLVER_PHASE_HXX
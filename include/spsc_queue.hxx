@@ -0,0 +1,74 @@
+#ifndef LP_MP_SPSC_QUEUE_HXX
+#define LP_MP_SPSC_QUEUE_HXX
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cassert>
+#include <type_traits>
+
+namespace LP_MP {
+
+// bounded lock-free queue for exactly one producer and one consumer thread, e.g. solver thread and a background writer.
+// capacity is rounded up to a power of two. Neither side ever blocks, a full queue is reported by try_push.
+template<typename T>
+class spsc_queue {
+   static_assert(std::is_trivially_copyable<T>::value, "queue entries are copied between threads");
+public:
+   spsc_queue(const std::size_t capacity)
+   {
+      std::size_t n = 1;
+      while(n < capacity) { n *= 2; }
+      buffer_.resize(n);
+      mask_ = n-1;
+   }
+
+   // producer side
+   bool try_push(const T& x)
+   {
+      const std::size_t tail = tail_.load(std::memory_order_relaxed);
+      if(tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+         return false;
+      }
+      buffer_[tail & mask_] = x;
+      tail_.store(tail+1, std::memory_order_release);
+      return true;
+   }
+
+   // consumer side
+   bool try_pop(T& x)
+   {
+      const std::size_t head = head_.load(std::memory_order_relaxed);
+      if(head == tail_.load(std::memory_order_acquire)) {
+         return false;
+      }
+      x = buffer_[head & mask_];
+      head_.store(head+1, std::memory_order_release);
+      return true;
+   }
+
+   // consumer side: move all entries present at the time of the call to out, returns their number
+   std::size_t pop_all(std::vector<T>& out)
+   {
+      const std::size_t head = head_.load(std::memory_order_relaxed);
+      const std::size_t tail = tail_.load(std::memory_order_acquire);
+      for(std::size_t i=head; i!=tail; ++i) {
+         out.push_back(buffer_[i & mask_]);
+      }
+      head_.store(tail, std::memory_order_release);
+      return tail - head;
+   }
+
+   std::size_t capacity() const { return buffer_.size(); }
+
+private:
+   std::vector<T> buffer_;
+   std::size_t mask_;
+   // head and tail on distinct cache lines, so that producer and consumer do not contend
+   alignas(64) std::atomic<std::size_t> head_{0};
+   alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_SPSC_QUEUE_HXX
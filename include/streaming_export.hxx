@@ -0,0 +1,485 @@
+#ifndef LP_MP_STREAMING_EXPORT_HXX
+#define LP_MP_STREAMING_EXPORT_HXX
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <memory>
+#include <string>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include "LP_MP.h"
+#include "vector.hxx"
+
+// Export of the integer program given by the factors and messages of an LP to a file in LP or MPS format, without building the model in memory.
+// Factors and messages construct their constraints through the same functions as for DD_ILP (add_simplex_constraint etc.), which are written out immediately.
+// Variables of a factor occupy a contiguous range, hence only the first variable of every factor must be remembered for the constraints of messages.
+// LP files are written in a single pass. MPS files are column oriented: coefficients are sorted in runs of bounded size on disk and merged at the end.
+
+namespace LP_MP {
+
+class streaming_problem_export {
+public:
+  enum class format { lp, mps };
+
+  struct variable { std::size_t id; };
+
+  class variable_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = variable;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const variable*;
+    using reference = variable;
+
+    variable_iterator(const std::size_t id) : id_(id) {}
+    variable operator*() const { return {id_}; }
+    variable_iterator& operator++() { ++id_; return *this; }
+    variable_iterator operator++(int) { auto it = *this; ++id_; return it; }
+    bool operator==(const variable_iterator& o) const { return id_ == o.id_; }
+    bool operator!=(const variable_iterator& o) const { return id_ != o.id_; }
+  private:
+    std::size_t id_;
+  };
+
+  // contiguous ranges of variables laid out like the exported cost structures
+  class vector {
+  public:
+    vector(const std::size_t offset, const std::size_t n) : offset_(offset), n_(n) {}
+    std::size_t size() const { return n_; }
+    variable operator[](const std::size_t i) const { assert(i < n_); return {offset_ + i}; }
+    variable_iterator begin() const { return {offset_}; }
+    variable_iterator end() const { return {offset_ + n_}; }
+  protected:
+    std::size_t offset_, n_;
+  };
+
+  class matrix : public vector {
+  public:
+    matrix(const std::size_t offset, const std::size_t dim1, const std::size_t dim2) : vector(offset, dim1*dim2), dim2_(dim2) {}
+    std::size_t dim1() const { return dim2_ == 0 ? 0 : this->n_/dim2_; }
+    std::size_t dim2() const { return dim2_; }
+    using vector::operator[];
+    variable operator()(const std::size_t i, const std::size_t j) const { assert(j < dim2_); return (*this)[i*dim2_ + j]; }
+  private:
+    std::size_t dim2_;
+  };
+
+  class tensor : public vector {
+  public:
+    tensor(const std::size_t offset, const std::size_t dim1, const std::size_t dim2, const std::size_t dim3) : vector(offset, dim1*dim2*dim3), dim2_(dim2), dim3_(dim3) {}
+    std::size_t dim1() const { return dim2_*dim3_ == 0 ? 0 : this->n_/(dim2_*dim3_); }
+    std::size_t dim2() const { return dim2_; }
+    std::size_t dim3() const { return dim3_; }
+    variable operator()(const std::size_t i, const std::size_t j, const std::size_t k) const { assert(j < dim2_ && k < dim3_); return (*this)[(i*dim2_ + j)*dim3_ + k]; }
+  private:
+    std::size_t dim2_, dim3_;
+  };
+
+  static constexpr std::size_t default_run_size = std::size_t(1) << 20;
+
+  // run_size is the number of coefficients sorted in memory at once when writing MPS files
+  streaming_problem_export(const std::string& filename, const format f, const std::size_t run_size = default_run_size)
+  : format_(f), run_size_(run_size)
+  {
+    if (run_size_ == 0) {
+      throw std::runtime_error("run size must be positive");
+    }
+    file_ = open(filename.c_str(), "w");
+    if (format_ == format::lp) {
+      std::fprintf(file_.get(), "\\ written by LP_MP\nMinimize\n obj:");
+    } else {
+      rows_ = temporary_file();
+      rhs_ = temporary_file();
+      run_.reserve(run_size_);
+    }
+    fixed_ = temporary_file();
+  }
+
+  // constant offset of the objective, to be given before any constraint
+  void set_constant(const REAL c) { assert(!in_constraints_); constant_ = c; }
+
+  // objective, to be given for all variables in order before any constraint
+  variable add_objective(const REAL cost)
+  {
+    assert(!in_constraints_);
+    const variable x{no_variables_++};
+    const bool fixed = cost == std::numeric_limits<REAL>::infinity();
+    const REAL c = fixed ? 0.0 : cost;
+    if (fixed) {
+      std::fwrite(&x.id, sizeof(x.id), 1, fixed_.get());
+    }
+    if (format_ == format::lp) {
+      std::fprintf(file_.get(), " %+.17g x%zu", c, x.id);
+      if (no_variables_ % 8 == 0) { std::fprintf(file_.get(), "\n"); }
+    } else {
+      // every column gets an objective entry, such that also unconstrained variables are listed
+      push_coefficient(x.id, objective_row, c);
+    }
+    return x;
+  }
+
+  // sum_i coeffs[i] x[i] <sense> rhs, where sense is one of '=', '<', '>'.
+  // Constraints without variables are not written, since LP files cannot express them. They must hold for 0.
+  template<typename ITERATOR, typename COEFF_FUNC>
+  void add_linear_constraint(ITERATOR begin, ITERATOR end, COEFF_FUNC coeff, const char sense, const REAL rhs)
+  {
+    start_constraints();
+    if (begin == end) {
+      if (!(sense == '=' ? rhs == 0.0 : (sense == '<' ? 0.0 <= rhs : 0.0 >= rhs))) {
+        throw std::runtime_error("constraint without variables is infeasible");
+      }
+      return;
+    }
+    const std::size_t row = no_constraints_++;
+    if (format_ == format::lp) {
+      std::fprintf(file_.get(), " c%zu:", row);
+      for (INDEX i = 0; begin != end; ++begin, ++i) {
+        std::fprintf(file_.get(), " %+.17g x%zu", coeff(i), (*begin).id);
+        if (i % 8 == 7) { std::fprintf(file_.get(), "\n"); }
+      }
+      std::fprintf(file_.get(), " %s %.17g\n", sense == '=' ? "=" : (sense == '<' ? "<=" : ">="), rhs);
+    } else {
+      std::fprintf(rows_.get(), " %c c%zu\n", sense == '=' ? 'E' : (sense == '<' ? 'L' : 'G'), row);
+      if (rhs != 0.0) {
+        std::fprintf(rhs_.get(), "    rhs c%zu %.17g\n", row, rhs);
+      }
+      for (INDEX i = 0; begin != end; ++begin, ++i) {
+        push_coefficient((*begin).id, row, coeff(i));
+      }
+    }
+  }
+
+  // constraints used by factors and messages, as in DD_ILP
+  template<typename ITERATOR>
+  void add_simplex_constraint(ITERATOR begin, ITERATOR end) { add_linear_constraint(begin, end, unit, '=', 1.0); }
+  // returns a variable that is one iff one of the given variables is one
+  template<typename ITERATOR>
+  variable add_at_most_one_constraint(ITERATOR begin, ITERATOR end)
+  {
+    start_constraints();
+    const variable one_active{no_variables_++};
+    std::vector<variable> v(begin, end);
+    const std::size_t n = v.size();
+    v.push_back(one_active);
+    add_linear_constraint(v.begin(), v.end(), [n](const INDEX i) { return i < n ? 1.0 : -1.0; }, '=', 0.0);
+    return one_active;
+  }
+  template<typename ITERATOR>
+  void add_at_least_one_constraint(ITERATOR begin, ITERATOR end) { add_linear_constraint(begin, end, unit, '>', 1.0); }
+
+  void make_equal(const variable x, const variable y)
+  {
+    const std::array<variable,2> v{x, y};
+    add_linear_constraint(v.begin(), v.end(), [](const INDEX i) { return i == 0 ? 1.0 : -1.0; }, '=', 0.0);
+  }
+
+  // x implies y
+  void add_implication(const variable x, const variable y)
+  {
+    const std::array<variable,2> v{x, y};
+    add_linear_constraint(v.begin(), v.end(), [](const INDEX i) { return i == 0 ? 1.0 : -1.0; }, '<', 0.0);
+  }
+
+  template<typename ITERATOR_1, typename ITERATOR_2>
+  void make_equal(ITERATOR_1 begin_1, ITERATOR_1 end_1, ITERATOR_2 begin_2, ITERATOR_2 end_2)
+  {
+    for (; begin_1 != end_1; ++begin_1, ++begin_2) {
+      assert(begin_2 != end_2);
+      make_equal(*begin_1, *begin_2);
+    }
+  }
+
+  std::size_t no_variables() const { return no_variables_; }
+  std::size_t no_constraints() const { return no_constraints_; }
+
+  // writes bounds and variable types and closes the file
+  void finish()
+  {
+    start_constraints();
+    std::rewind(fixed_.get());
+    if (format_ == format::lp) {
+      // as constraints, since declaring variables binary may override their bounds
+      for_each_fixed([&](const std::size_t i) { std::fprintf(file_.get(), " f%zu: x%zu = 0\n", i, i); });
+      std::fprintf(file_.get(), "Binaries\n");
+      for (std::size_t i = 0; i < no_variables_; ++i) {
+        std::fprintf(file_.get(), " x%zu%s", i, (i % 8 == 7 || i+1 == no_variables_) ? "\n" : "");
+      }
+      std::fprintf(file_.get(), "End\n");
+    } else {
+      std::fprintf(file_.get(), "NAME LP_MP\nROWS\n N obj\n");
+      append(rows_.get());
+      std::fprintf(file_.get(), "COLUMNS\n    MARKER 'MARKER' 'INTORG'\n");
+      write_columns();
+      std::fprintf(file_.get(), "    MARKER 'MARKER' 'INTEND'\nRHS\n");
+      // the objective constant is the negated right hand side of the objective row
+      if (constant_ != 0.0) {
+        std::fprintf(file_.get(), "    rhs obj %.17g\n", -constant_);
+      }
+      append(rhs_.get());
+      std::fprintf(file_.get(), "BOUNDS\n");
+      std::size_t i = 0;
+      for_each_fixed([&](const std::size_t f) {
+        for (; i < f; ++i) { std::fprintf(file_.get(), " BV bnd x%zu\n", i); }
+        std::fprintf(file_.get(), " FX bnd x%zu 0\n", i++);
+      });
+      for (; i < no_variables_; ++i) { std::fprintf(file_.get(), " BV bnd x%zu\n", i); }
+      std::fprintf(file_.get(), "ENDATA\n");
+    }
+    if (std::fflush(file_.get()) != 0) {
+      throw std::runtime_error("could not write problem file");
+    }
+    file_.reset();
+  }
+
+private:
+  using file_ptr = std::unique_ptr<std::FILE, int(*)(std::FILE*)>;
+  struct coefficient { std::size_t column, row; REAL value; };
+  static constexpr std::size_t objective_row = std::numeric_limits<std::size_t>::max();
+
+  static REAL unit(const INDEX) { return 1.0; }
+
+  static file_ptr open(const char* filename, const char* mode)
+  {
+    file_ptr f(std::fopen(filename, mode), &std::fclose);
+    if (!f) {
+      throw std::runtime_error(std::string("could not open ") + filename);
+    }
+    return f;
+  }
+
+  static file_ptr temporary_file()
+  {
+    file_ptr f(std::tmpfile(), &std::fclose);
+    if (!f) {
+      throw std::runtime_error("could not create temporary file");
+    }
+    return f;
+  }
+
+  void start_constraints()
+  {
+    if (!in_constraints_) {
+      in_constraints_ = true;
+      if (format_ == format::lp) {
+        if (constant_ != 0.0) {
+          std::fprintf(file_.get(), " %+.17g", constant_);
+        }
+        std::fprintf(file_.get(), "\nSubject To\n");
+      }
+    }
+  }
+
+  void append(std::FILE* f)
+  {
+    std::rewind(f);
+    std::array<char, 1 << 16> buf;
+    std::size_t n;
+    while ((n = std::fread(buf.data(), 1, buf.size(), f)) > 0) {
+      std::fwrite(buf.data(), 1, n, file_.get());
+    }
+  }
+
+  template<typename FUNC>
+  void for_each_fixed(FUNC&& func)
+  {
+    std::size_t i;
+    while (std::fread(&i, sizeof(i), 1, fixed_.get()) == 1) {
+      func(i);
+    }
+  }
+
+  // the objective row comes first in every column
+  static bool column_order(const coefficient& a, const coefficient& b)
+  {
+    return std::make_tuple(a.column, a.row != objective_row, a.row) < std::make_tuple(b.column, b.row != objective_row, b.row);
+  }
+
+  void push_coefficient(const std::size_t column, const std::size_t row, const REAL value)
+  {
+    run_.push_back({column, row, value});
+    if (run_.size() >= run_size_) {
+      flush_run();
+    }
+  }
+
+  void flush_run()
+  {
+    if (run_.empty()) { return; }
+    std::sort(run_.begin(), run_.end(), column_order);
+    runs_.push_back(temporary_file());
+    std::fwrite(run_.data(), sizeof(coefficient), run_.size(), runs_.back().get());
+    std::rewind(runs_.back().get());
+    run_.clear();
+  }
+
+  // k-way merge of the sorted runs
+  void write_columns()
+  {
+    flush_run();
+    std::vector<std::vector<coefficient>> buf(runs_.size());
+    std::vector<std::size_t> pos(runs_.size(), 0);
+    const std::size_t buf_size = std::max(std::size_t(1), run_size_/std::max(std::size_t(1), runs_.size()));
+    auto fill = [&](const std::size_t r) {
+      buf[r].resize(buf_size);
+      buf[r].resize(std::fread(buf[r].data(), sizeof(coefficient), buf_size, runs_[r].get()));
+      pos[r] = 0;
+      return !buf[r].empty();
+    };
+    auto greater = [&](const std::size_t a, const std::size_t b) { return column_order(buf[b][pos[b]], buf[a][pos[a]]); };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heads(greater);
+    for (std::size_t r = 0; r < runs_.size(); ++r) {
+      if (fill(r)) { heads.push(r); }
+    }
+    while (!heads.empty()) {
+      const std::size_t r = heads.top();
+      heads.pop();
+      const auto& c = buf[r][pos[r]];
+      if (c.row == objective_row) {
+        std::fprintf(file_.get(), "    x%zu obj %.17g\n", c.column, c.value);
+      } else {
+        std::fprintf(file_.get(), "    x%zu c%zu %.17g\n", c.column, c.row, c.value);
+      }
+      if (++pos[r] < buf[r].size() || fill(r)) { heads.push(r); }
+    }
+    runs_.clear();
+  }
+
+  const format format_;
+  const std::size_t run_size_;
+  file_ptr file_{nullptr, &std::fclose};
+  file_ptr rows_{nullptr, &std::fclose};
+  file_ptr rhs_{nullptr, &std::fclose};
+  file_ptr fixed_{nullptr, &std::fclose}; // ids of variables with infinite cost
+  std::vector<coefficient> run_;
+  std::vector<file_ptr> runs_;
+  std::size_t no_variables_ = 0;
+  std::size_t no_constraints_ = 0;
+  REAL constant_ = 0.0;
+  bool in_constraints_ = false;
+};
+
+// LP which can write its integer program to a file in bounded memory, optionally restricted to a region of factors.
+// Factors and messages must provide construct_constraints as for LP_external_solver.
+template<typename BASE_LP_SOLVER>
+class LP_streaming_export : public BASE_LP_SOLVER {
+public:
+  using BASE_LP_SOLVER::BASE_LP_SOLVER;
+
+  // format is determined by the extension of filename (.mps or .lp)
+  void write_to_file(const std::string& filename, const std::vector<bool>* factor_mask = nullptr, const std::size_t run_size = streaming_problem_export::default_run_size)
+  {
+    const bool mps = filename.size() >= 4 && filename.compare(filename.size()-4, 4, ".mps") == 0;
+    write_to_file(filename, mps ? streaming_problem_export::format::mps : streaming_problem_export::format::lp, factor_mask, run_size);
+  }
+
+  // factors with factor_mask[i] == false, where i is the factor's index, and their messages are not exported
+  void write_to_file(const std::string& filename, const streaming_problem_export::format f, const std::vector<bool>* factor_mask = nullptr, const std::size_t run_size = streaming_problem_export::default_run_size)
+  {
+    assert(factor_mask == nullptr || factor_mask->size() == this->GetNumberOfFactors());
+    streaming_problem_export s(filename, f, run_size);
+    s.set_constant(this->constant_);
+
+    constexpr std::size_t not_exported = std::numeric_limits<std::size_t>::max();
+    std::vector<std::size_t> offset(this->GetNumberOfFactors(), not_exported); // first variable of factor
+    auto factor_index = [this](auto* f) { return this->factor_address_to_index_.find(f)->second; };
+    auto exported = [&](auto* f) { return factor_mask == nullptr || (*factor_mask)[factor_index(f)]; };
+
+    // variables and objective
+    this->for_each_factor([&](auto* f) {
+      if (!exported(f)) { return; }
+      offset[factor_index(f)] = s.no_variables();
+      std::apply([&](auto&... x) { (add_objective(s, x), ...); }, f->GetFactor()->export_variables());
+    });
+
+    this->for_each_factor([&](auto* f) {
+      if (!exported(f)) { return; }
+      auto vars = load_variables(s, offset[factor_index(f)], f->GetFactor()->export_variables());
+      std::apply([&](auto... x) { f->GetFactor()->construct_constraints(s, x...); }, vars);
+    });
+
+    this->for_each_message([&](auto* m) {
+      auto* l = m->GetLeftFactor();
+      auto* r = m->GetRightFactor();
+      if (!exported(l) || !exported(r)) { return; }
+      auto left_vars = load_variables(s, offset[factor_index(l)], l->GetFactor()->export_variables());
+      auto right_vars = load_variables(s, offset[factor_index(r)], r->GetFactor()->export_variables());
+      auto t = std::tuple_cat(std::tie(*l->GetFactor()), left_vars, std::tie(*r->GetFactor()), right_vars);
+      std::apply([&](auto&... x) { m->GetMessageOp().construct_constraints(s, x...); }, t);
+    });
+
+    s.finish();
+  }
+
+private:
+  using export_type = streaming_problem_export;
+
+  static void add_objective(export_type& s, const REAL cost) { s.add_objective(cost); }
+
+  template<typename VECTOR>
+  static auto add_objective(export_type& s, const VECTOR& cost) -> decltype(cost.size(), cost[0], void())
+  {
+    for (std::size_t i = 0; i < cost.size(); ++i) { s.add_objective(cost[i]); }
+  }
+
+  static void add_objective(export_type& s, const LP_MP::matrix<REAL>& cost)
+  {
+    for (INDEX i = 0; i < cost.dim1(); ++i) {
+      for (INDEX j = 0; j < cost.dim2(); ++j) { s.add_objective(cost(i,j)); }
+    }
+  }
+
+  static void add_objective(export_type& s, const LP_MP::tensor3<REAL>& cost)
+  {
+    for (INDEX i = 0; i < cost.dim1(); ++i) {
+      for (INDEX j = 0; j < cost.dim2(); ++j) {
+        for (INDEX k = 0; k < cost.dim3(); ++k) { s.add_objective(cost(i,j,k)); }
+      }
+    }
+  }
+
+  static export_type::variable load_variable(std::size_t& offset, const REAL) { return {offset++}; }
+
+  template<typename VECTOR>
+  static auto load_variable(std::size_t& offset, const VECTOR& v) -> decltype(v.size(), v[0], export_type::vector(0,0))
+  {
+    export_type::vector x(offset, v.size());
+    offset += v.size();
+    return x;
+  }
+
+  static export_type::matrix load_variable(std::size_t& offset, const LP_MP::matrix<REAL>& m)
+  {
+    export_type::matrix x(offset, m.dim1(), m.dim2());
+    offset += x.size();
+    return x;
+  }
+
+  static export_type::tensor load_variable(std::size_t& offset, const LP_MP::tensor3<REAL>& t)
+  {
+    export_type::tensor x(offset, t.dim1(), t.dim2(), t.dim3());
+    offset += x.size();
+    return x;
+  }
+
+  // external variables of a factor in the order of export_variables. Braced initialization guarantees this evaluation order.
+  template<typename... T>
+  static auto load_variables(export_type& s, std::size_t offset, std::tuple<T...> vars)
+  {
+    return std::apply([&](auto&... x) {
+      return std::tuple<decltype(load_variable(offset, x))...>{load_variable(offset, x)...};
+    }, vars);
+  }
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_STREAMING_EXPORT_HXX
+
+// vim: set ts=2 sts=2 sw=2 et:
@@ -0,0 +1,317 @@
+#ifndef LP_MP_TELEMETRY_HXX
+#define LP_MP_TELEMETRY_HXX
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include "spsc_queue.hxx"
+#include "solver_phase.hxx"
+#include "mem_use.c"
+
+namespace LP_MP {
+
+// Per-iteration statistics of the solver, written by a background thread into a binary or JSON-lines file.
+// The solver only pays for pushing a record into a fixed-size lock-free ring buffer. When the writer falls behind, records are dropped and counted.
+// Files are self-describing: the binary format stores column names in its header, JSON lines name each value.
+namespace telemetry {
+
+   // wall clock time of the whole iteration, followed by the solver phases
+   constexpr std::size_t no_phases = 1 + no_solver_phases;
+
+   struct record {
+      std::uint64_t iteration;
+      double time; // seconds since begin of optimization
+      double lower_bound;
+      double upper_bound;
+      std::array<double, no_phases> phase_time; // seconds
+      std::uint64_t memory; // resident set size in bytes, as sampled last by the writer thread
+   };
+
+   constexpr std::size_t no_columns = 5 + no_phases;
+
+   inline std::vector<std::string> column_names()
+   {
+      std::vector<std::string> names = {"iteration", "time", "lower_bound", "upper_bound"};
+      names.push_back("iteration_time");
+      for(const char* p : solver_phase_names) {
+         names.push_back(std::string(p) + "_time");
+      }
+      names.push_back("memory");
+      return names;
+   }
+
+   inline std::array<double, no_columns> columns(const record& r)
+   {
+      std::array<double, no_columns> c;
+      c[0] = r.iteration;
+      c[1] = r.time;
+      c[2] = r.lower_bound;
+      c[3] = r.upper_bound;
+      std::copy(r.phase_time.begin(), r.phase_time.end(), c.begin() + 4);
+      c[no_columns-1] = r.memory;
+      return c;
+   }
+
+   enum class format { binary, json_lines };
+
+   // .jsonl and .json files are written as JSON lines, everything else in binary
+   inline format format_from_filename(const std::string& filename)
+   {
+      for(const std::string ext : {".jsonl", ".json"}) {
+         if(filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
+            return format::json_lines;
+         }
+      }
+      return format::binary;
+   }
+
+   // binary layout: magic, number of columns (uint32), zero terminated column names, then rows of doubles in native byte order
+   constexpr char binary_magic[8] = {'L','P','M','P','T','L','M','1'};
+
+   struct file_closer { void operator()(std::FILE* f) const { std::fclose(f); } };
+   using file_ptr = std::unique_ptr<std::FILE, file_closer>;
+
+   inline void write_json_value(std::FILE* f, const double x)
+   {
+      // JSON has no infinity, write those as strings
+      if(std::isfinite(x)) {
+         std::fprintf(f, "%.17g", x);
+      } else {
+         std::fprintf(f, "\"%s\"", std::isnan(x) ? "nan" : (x > 0 ? "inf" : "-inf"));
+      }
+   }
+
+   class file_writer {
+   public:
+      file_writer(const std::string& filename)
+         : file_writer(filename, format_from_filename(filename))
+      {}
+
+      file_writer(const std::string& filename, const format fmt)
+         : format_(fmt),
+         names_(column_names()),
+         file_(std::fopen(filename.c_str(), fmt == format::binary ? "wb" : "w"))
+      {
+         if(!file_) {
+            throw std::runtime_error("could not open telemetry file " + filename);
+         }
+         if(format_ == format::binary) {
+            std::fwrite(binary_magic, 1, sizeof(binary_magic), file_.get());
+            const std::uint32_t n = names_.size();
+            std::fwrite(&n, sizeof(n), 1, file_.get());
+            for(const auto& name : names_) {
+               std::fwrite(name.c_str(), 1, name.size()+1, file_.get());
+            }
+         }
+      }
+
+      void write(const record& r)
+      {
+         const auto c = columns(r);
+         if(format_ == format::binary) {
+            std::fwrite(c.data(), sizeof(double), c.size(), file_.get());
+         } else {
+            std::fputc('{', file_.get());
+            for(std::size_t i=0; i<c.size(); ++i) {
+               std::fprintf(file_.get(), "%s\"%s\": ", i == 0 ? "" : ", ", names_[i].c_str());
+               write_json_value(file_.get(), c[i]);
+            }
+            std::fputs("}\n", file_.get());
+         }
+      }
+
+      void flush()
+      {
+         if(std::fflush(file_.get()) != 0) {
+            throw std::runtime_error("could not write telemetry file");
+         }
+      }
+
+   private:
+      const format format_;
+      const std::vector<std::string> names_;
+      file_ptr file_;
+   };
+
+   // contents of a telemetry file, as read back by conversion tools
+   struct table {
+      std::vector<std::string> names;
+      std::vector<std::vector<double>> rows;
+
+      // index of column with given name
+      std::size_t column(const std::string& name) const
+      {
+         for(std::size_t i=0; i<names.size(); ++i) {
+            if(names[i] == name) { return i; }
+         }
+         throw std::runtime_error("telemetry file has no column " + name);
+      }
+   };
+
+   inline table read_file(const std::string& filename)
+   {
+      file_ptr f(std::fopen(filename.c_str(), "rb"));
+      if(!f) {
+         throw std::runtime_error("could not open telemetry file " + filename);
+      }
+      table t;
+
+      char magic[sizeof(binary_magic)];
+      if(std::fread(magic, 1, sizeof(magic), f.get()) == sizeof(magic) && std::memcmp(magic, binary_magic, sizeof(magic)) == 0) {
+         std::uint32_t n;
+         if(std::fread(&n, sizeof(n), 1, f.get()) != 1) {
+            throw std::runtime_error("corrupt telemetry file " + filename);
+         }
+         t.names.resize(n);
+         for(auto& name : t.names) {
+            for(int ch; (ch = std::fgetc(f.get())) != 0; ) {
+               if(ch == EOF) { throw std::runtime_error("corrupt telemetry file " + filename); }
+               name.push_back(ch);
+            }
+         }
+         std::vector<double> row(n);
+         while(std::fread(row.data(), sizeof(double), n, f.get()) == n) {
+            t.rows.push_back(row);
+         }
+         return t;
+      }
+
+      // JSON lines as written by file_writer: one flat object per line, numbers or quoted non-finite numbers
+      std::rewind(f.get());
+      std::string line;
+      for(int ch; (ch = std::fgetc(f.get())) != EOF; ) {
+         if(ch != '\n') {
+            line.push_back(ch);
+            continue;
+         }
+         if(line.empty()) {
+            continue;
+         }
+         std::vector<double> row;
+         const bool first_row = t.rows.empty();
+         for(std::size_t pos = line.find('"'); pos != std::string::npos; pos = line.find('"', pos)) {
+            const std::size_t name_end = line.find('"', pos+1);
+            const std::size_t colon = line.find(':', name_end);
+            if(name_end == std::string::npos || colon == std::string::npos) {
+               throw std::runtime_error("corrupt telemetry file " + filename);
+            }
+            if(first_row) {
+               t.names.push_back(line.substr(pos+1, name_end-pos-1));
+            }
+            std::size_t value_begin = line.find_first_not_of(" \"", colon+1);
+            char* value_end;
+            row.push_back(std::strtod(line.c_str() + value_begin, &value_end));
+            pos = line.find_first_of(",}", value_end - line.c_str());
+         }
+         if(row.size() != t.names.size()) {
+            throw std::runtime_error("corrupt telemetry file " + filename);
+         }
+         t.rows.push_back(std::move(row));
+         line.clear();
+      }
+      return t;
+   }
+
+   // drains the ring buffer into a file_writer in a background thread and samples memory usage on the way
+   class writer {
+   public:
+      writer(const std::string& filename, const std::size_t capacity, const std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+         : file_(filename),
+         queue_(capacity),
+         interval_(interval),
+         memory_(memory_used(true)),
+         thread_([this]() { this->run(); })
+      {}
+
+      // write errors are only reported here, call close() to have them thrown
+      ~writer()
+      {
+         try {
+            close();
+         } catch(const std::exception& e) {
+            std::cerr << "telemetry: " << e.what() << "\n";
+         }
+      }
+
+      // called by the solver thread only
+      bool push(record r)
+      {
+         r.memory = memory_.load(std::memory_order_relaxed);
+         if(!queue_.try_push(r)) {
+            ++dropped_;
+            return false;
+         }
+         return true;
+      }
+
+      std::uint64_t dropped() const { return dropped_; }
+
+      // write out all pushed records and stop the writer thread. Rethrows an error that occurred while writing
+      void close()
+      {
+         if(thread_.joinable()) {
+            stop_.store(true, std::memory_order_release);
+            thread_.join();
+            if(error_) {
+               std::rethrow_exception(error_);
+            }
+         }
+      }
+
+   private:
+      void run()
+      {
+         std::vector<record> batch;
+         while(true) {
+            // read the stop flag before draining, so that records pushed before stopping are always written
+            const bool stop = stop_.load(std::memory_order_acquire);
+            memory_.store(memory_used(true), std::memory_order_relaxed);
+            batch.clear();
+            queue_.pop_all(batch);
+            if(!error_) {
+               try {
+                  for(const auto& r : batch) {
+                     file_.write(r);
+                  }
+                  file_.flush();
+               } catch(...) {
+                  error_ = std::current_exception();
+               }
+            }
+            if(stop) {
+               return;
+            }
+            if(batch.empty()) {
+               std::this_thread::sleep_for(interval_);
+            }
+         }
+      }
+
+      file_writer file_;
+      spsc_queue<record> queue_;
+      const std::chrono::milliseconds interval_;
+      std::atomic<std::uint64_t> memory_;
+      std::atomic<bool> stop_{false};
+      std::uint64_t dropped_ = 0;
+      std::exception_ptr error_; // set by the writer thread, read after it has been joined
+      std::thread thread_; // must be initialized last
+   };
+
+} // namespace telemetry
+
+} // namespace LP_MP
+
+#endif // LP_MP_TELEMETRY_HXX
@@ -4,168 +4,242 @@
 #include "LP_MP.h"
 #include "serialization.hxx"
 #include "union_find.hxx"
+#include <variant>
+#include <unordered_map>
+#include <numeric>
+#include <deque>
+#include <array>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace LP_MP {
 
-// given factors connected as a tree, solve it.
+// edge of a tree in a forest cover, oriented from lower node towards the root
+struct forest_edge {
+   INDEX edge;
+   INDEX lower, upper;
+};
+
+// Cover all edges of a graph by trees: repeatedly take a spanning forest of the edges not covered yet (Kruskal with union find) until no edge remains.
+// Each round covers a maximal forest, hence trees are large and, e.g. for grids, two rounds suffice.
+// Returned trees consist of at least one edge; each edge is in exactly one tree, oriented towards the tree's root and sorted from leaves to root.
+inline std::vector<std::vector<forest_edge>> greedy_forest_cover(const INDEX no_nodes, const std::vector<std::array<INDEX,2>>& edges)
+{
+   std::vector<std::vector<forest_edge>> trees;
+   std::vector<INDEX> remaining(edges.size());
+   std::iota(remaining.begin(), remaining.end(), 0);
+   std::vector<INDEX> forest, rest;
+   std::vector<std::vector<std::array<INDEX,2>>> adjacency(no_nodes); // (neighbor, edge)
+   std::vector<char> visited(no_nodes, false);
+   std::deque<INDEX> queue;
+   UnionFind uf(no_nodes);
+
+   while(!remaining.empty()) {
+      uf.reset();
+      forest.clear();
+      rest.clear();
+      for(const INDEX e : remaining) {
+         const INDEX i = edges[e][0];
+         const INDEX j = edges[e][1];
+         assert(i < no_nodes && j < no_nodes && i != j);
+         if(!uf.connected(i,j)) {
+            uf.merge(i,j);
+            forest.push_back(e);
+         } else {
+            rest.push_back(e);
+         }
+      }
+
+      for(const INDEX e : forest) {
+         adjacency[edges[e][0]].push_back({edges[e][1], e});
+         adjacency[edges[e][1]].push_back({edges[e][0], e});
+      }
+      // orient each tree of the forest by breadth first search from its first node
+      for(const INDEX e : forest) {
+         const INDEX root = edges[e][0];
+         if(visited[root]) { continue; }
+         std::vector<forest_edge> tree;
+         visited[root] = true;
+         queue.push_back(root);
+         while(!queue.empty()) {
+            const INDEX i = queue.front();
+            queue.pop_front();
+            for(const auto& a : adjacency[i]) {
+               if(!visited[a[0]]) {
+                  visited[a[0]] = true;
+                  tree.push_back({a[1], a[0], i});
+                  queue.push_back(a[0]);
+               }
+            }
+         }
+         std::reverse(tree.begin(), tree.end());
+         trees.push_back(std::move(tree));
+      }
+      for(const INDEX e : forest) {
+         for(const INDEX i : edges[e]) {
+            adjacency[i].clear();
+            visited[i] = false;
+         }
+      }
+
+      std::swap(remaining, rest);
+   }
+   return trees;
+}
+
+// given factors connected as a tree, solve it by min-sum dynamic programming:
+// messages are sent from the leaves to the root, reparametrizing the tree such that all its factors except the root have zero lower bound. Then an optimal labeling is tracked down from the root.
+// init() arranges messages into a flat leaf-to-root schedule once, hence solve() only traverses contiguous storage and does not allocate.
 template<typename FMC>
 class factor_tree {
 public:
-   // add messages from leaves to root upward
+   // chirality denotes which factor is nearer the root. Messages can be added in any order
    template<typename MESSAGE_CONTAINER_TYPE>
-   void add_message( MESSAGE_CONTAINER_TYPE& msg, Chirality c) // chirality denotes which factor is nearer the root
+   void add_message( MESSAGE_CONTAINER_TYPE& msg, Chirality c)
    {
+      tree_messages_.push_back({msg.free_message(), c});
+   }
 
+   // a tree without messages consists of a single factor, e.g. one not connected to any other factor
+   void add_factor(FactorTypeAdapter* f)
+   {
+      assert(tree_messages_.empty() && factors_.empty());
+      factors_.push_back(f);
    }
 
    void init()
    {
-       assert(false);
-      /*
-      std::set<FactorTypeAdapter*> factor_set;
-      for(auto tree_msg : tree_messages_) {
-         auto* msg = std::get<0>(tree_msg);
-         factor_set.insert(msg->GetLeftFactor());
-         factor_set.insert(msg->GetRightFactor());
+      if(tree_messages_.empty()) {
+         if(factors_.size() != 1) {
+            throw std::runtime_error("tree without messages must consist of exactly one factor");
+         }
+         root_ = factors_[0];
+         return;
       }
-      factors_.assign( factor_set.begin(), factor_set.end() );
-      std::sort(factors_.begin(), factors_.end());
-      assert(factors_.size() == tree_messages_.size() + 1);
+      std::unordered_map<FactorTypeAdapter*, INDEX> factor_map;
+      factors_.clear();
+      auto factor_index = [&](FactorTypeAdapter* f) {
+         auto it = factor_map.find(f);
+         if(it == factor_map.end()) {
+            it = factor_map.insert({f, factors_.size()}).first;
+            factors_.push_back(f);
+         }
+         return it->second;
+      };
+
+      // each non-root factor is lower factor of exactly one message, namely the one to its parent
+      std::vector<INDEX> parent_msg(tree_messages_.size()+1, std::numeric_limits<INDEX>::max());
+      std::vector<INDEX> parent(tree_messages_.size()+1, std::numeric_limits<INDEX>::max());
+      for(INDEX i=0; i<tree_messages_.size(); ++i) {
+         const INDEX upper = factor_index(upper_factor(tree_messages_[i]));
+         const INDEX lower = factor_index(lower_factor(tree_messages_[i]));
+         if(std::max(upper, lower) >= parent.size() || parent_msg[lower] != std::numeric_limits<INDEX>::max()) {
+            throw std::runtime_error("messages do not form a tree directed towards the root");
+         }
+         parent_msg[lower] = i;
+         parent[lower] = upper;
+      }
+      if(factors_.size() != tree_messages_.size() + 1) {
+         throw std::runtime_error("messages do not form a tree");
+      }
+      const INDEX root = std::find(parent.begin(), parent.end(), std::numeric_limits<INDEX>::max()) - parent.begin();
+      root_ = factors_[root];
+
+      // depth of each factor, following parents. Cycles are detected by depth exceeding the number of factors.
+      std::vector<INDEX> depth(factors_.size(), std::numeric_limits<INDEX>::max());
+      depth[root] = 0;
+      std::vector<INDEX> path;
+      for(INDEX i=0; i<factors_.size(); ++i) {
+         INDEX j = i;
+         while(depth[j] == std::numeric_limits<INDEX>::max()) {
+            path.push_back(j);
+            j = parent[j];
+            if(path.size() > factors_.size()) {
+               throw std::runtime_error("messages do not form a tree");
+            }
+         }
+         for(auto it=path.rbegin(); it!=path.rend(); ++it) {
+            depth[*it] = depth[j] + 1;
+            j = *it;
+         }
+         path.clear();
+      }
+
+      // leaf-to-root schedule: a message may only be sent after all messages into its lower factor have been sent
+      std::vector<INDEX> order(tree_messages_.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::vector<INDEX> msg_depth(tree_messages_.size());
+      for(INDEX i=0; i<factors_.size(); ++i) {
+         if(i != root) { msg_depth[parent_msg[i]] = depth[i]; }
+      }
+      std::stable_sort(order.begin(), order.end(), [&](const INDEX a, const INDEX b) { return msg_depth[a] > msg_depth[b]; });
+      decltype(tree_messages_) sorted_messages;
+      sorted_messages.reserve(tree_messages_.size());
+      for(const INDEX i : order) { sorted_messages.push_back(std::move(tree_messages_[i])); }
+      std::swap(tree_messages_, sorted_messages);
 
       assert(tree_valid());
-      */
    }
 
-   // check whether messages are arranged correctly
+   // check whether messages are arranged correctly, i.e. form a tree and are sorted from leaves to root
    bool tree_valid() const
    {
-       assert(false);
-       /*
-     // build graph out of tree messages and check whether all edges point towards root
-     std::vector<std::vector<int>> tree(factors_.size());
-     std::unordered_map<FactorTypeAdapter*, int> factor_map;
-     for(INDEX i=0; i<factors_.size(); ++i) {
-       factor_map.insert({ factors_[i], i });
-     }
-     for(auto& tree_msg : tree_messages_) {
-         auto* msg = std::get<0>(tree_msg);
-         auto c = std::get<1>(tree_msg);
-         auto* left = msg->GetLeftFactor();
-         const int left_idx = factor_map[left];
-         auto* right = msg->GetRightFactor();
-         const int right_idx = factor_map[right];
-         // point messages here towards leaves
-         if(c == Chirality::left) {
-           tree[left_idx].push_back(right_idx); 
-         } else {
-           assert(c == Chirality::right);
-           tree[right_idx].push_back(left_idx); 
-         } 
-     }
-     // determine root: it is the single index without incoming edges
-     std::vector<int> no_incoming_edges(factors_.size(), 0);
-     for(INDEX i=0; i<tree.size(); ++i) {
-       for(int j : tree[i]) {
-         no_incoming_edges[j]++;
-       }
-     }
-     assert(1 == std::count(no_incoming_edges.begin(), no_incoming_edges.end(), 0));
-     // check if tree is connected
-     UnionFind uf(tree.size());
-     for(INDEX i=0; i<tree.size(); ++i) {
-       for(int j : tree[i]) {
-         uf.merge(i,j);
-       }
-     }
-     assert(uf.count() == 1);
-
-     const int root = std::find(no_incoming_edges.begin(), no_incoming_edges.end(), 0) - no_incoming_edges.begin();
-
-     // check whether messages are in correct order: from bottom to top
-     std::vector<int> visited(tree.size(), false);
-     for(auto& tree_msg : tree_messages_) {
-         auto* msg = std::get<0>(tree_msg);
-         auto c = std::get<1>(tree_msg);
-         auto* left = msg->GetLeftFactor();
-         const int left_idx = factor_map[left];
-         auto* right = msg->GetRightFactor();
-         const int right_idx = factor_map[right];
-         // point messages here towards leaves
-         if(c == Chirality::left) {
-           visited[right_idx] = true;
-           assert(visited[left_idx] == false);
-         } else {
-           visited[left_idx] = true;
-           assert(visited[right_idx] == false); 
-         }
-     }
-     assert(visited[root] == false);
-
-     return true; 
-       */
+      if(factors_.size() != tree_messages_.size() + 1 || root_ == nullptr) { return false; }
+      std::unordered_map<FactorTypeAdapter*, INDEX> factor_map;
+      for(INDEX i=0; i<factors_.size(); ++i) {
+         factor_map.insert({ factors_[i], i });
+      }
+      if(factor_map.size() != factors_.size()) { return false; }
+
+      // after a factor has sent its message upward, it must not receive messages anymore
+      std::vector<char> sent(factors_.size(), false);
+      UnionFind uf(factors_.size());
+      for(const auto& tree_msg : tree_messages_) {
+         auto upper_it = factor_map.find(upper_factor(tree_msg));
+         auto lower_it = factor_map.find(lower_factor(tree_msg));
+         if(upper_it == factor_map.end() || lower_it == factor_map.end()) { return false; }
+         const INDEX upper = upper_it->second;
+         const INDEX lower = lower_it->second;
+         if(sent[lower] || sent[upper]) { return false; }
+         sent[lower] = true;
+         uf.merge(upper, lower);
+      }
+      return uf.count() == 1 && !sent[factor_map.find(root_)->second];
    }
 
    REAL solve()
    {
-       assert(false);
-       /*
       assert(factors_.size() == tree_messages_.size() + 1); // otherwise call init
-      // send messages up the tree
-      for(auto it = tree_messages_.begin(); it!= tree_messages_.end(); ++it) {
-         auto* m = std::get<0>(*it);
-         Chirality c = std::get<1>(*it);
-         m->send_message_up(c);
-      }
-      // compute primal for topmost factor
-      // also init primal for top factor, all other primals were initialized already by send_message_up
-      REAL value = 0.0;
-      {
-         auto* msg = std::get<0>(tree_messages_.back());
-         Chirality c = std::get<1>(tree_messages_.back());
-         if(c == Chirality::right) {
-            // init primal for right factor!
-            msg->GetRightFactorTypeAdapter()->init_primal();
-            msg->GetRightFactorTypeAdapter()->MaximizePotentialAndComputePrimal();
-            value = msg->GetRightFactorTypeAdapter()->EvaluatePrimal();
-         } else {
-            assert(c == Chirality::left);
-            msg->GetLeftFactorTypeAdapter()->init_primal(); 
-            msg->GetLeftFactorTypeAdapter()->MaximizePotentialAndComputePrimal(); 
-            value = msg->GetLeftFactorTypeAdapter()->EvaluatePrimal();
-         }
+      // send messages up the tree. This also initializes primals of all lower factors
+      for(auto& tree_msg : tree_messages_) {
+         const Chirality c = std::get<1>(tree_msg);
+         std::visit([c](auto& m) { m.send_message_up(c); }, std::get<0>(tree_msg));
       }
+      // compute primal for root
+      root_->init_primal();
+      root_->MaximizePotentialAndComputePrimal();
       // track down optimal primal solution
       for(auto it = tree_messages_.rbegin(); it!= tree_messages_.rend(); ++it) {
-         auto* msg = std::get<0>(*it);
-         Chirality c = std::get<1>(*it);
-         msg->track_solution_down(c);
-         if(c == Chirality::right) {
-            value += msg->GetLeftFactorTypeAdapter()->EvaluatePrimal();
-         } else {
-            assert(c == Chirality::left);
-            value += msg->GetRightFactorTypeAdapter()->EvaluatePrimal();
-         }
-      } 
+         const Chirality c = std::get<1>(*it);
+         std::visit([c](auto& m) { m.track_solution_down(c); }, std::get<0>(*it));
+      }
 
-      // check if primal cost is equal to lower bound
+      const REAL value = primal_cost();
       assert(primal_consistent());
-      assert(std::abs(lower_bound() - primal_cost()) <= eps);
-      assert(std::abs(value - primal_cost()) <= eps);
+      assert(std::abs(lower_bound() - value) <= eps);
       return value;
-       */
    }
 
    bool primal_consistent() const 
    {
-       /*
-      for(auto it = tree_messages_.begin(); it!= tree_messages_.end(); ++it) {
-         auto* m = std::get<0>(*it);
-         if(!m->CheckPrimalConsistency()) {
+      for(const auto& tree_msg : tree_messages_) {
+         const bool consistent = std::visit([](const auto& m) { return m.CheckPrimalConsistency(); }, std::get<0>(tree_msg));
+         if(!consistent) {
             return false;
          }
       }
       return true; 
-      */
    }
 
    REAL primal_cost() const
@@ -193,26 +267,36 @@ public:
    std::vector<FACTOR_TYPE*> get_factors() const
    {
       std::vector<FACTOR_TYPE*> factors;
-      std::set<FACTOR_TYPE*> factor_present;
-      for(auto& t : tree_messages_) {
-
-         auto* left = std::get<0>(t)->GetLeftFactorTypeAdapter();
-         auto* left_cast = dynamic_cast<FACTOR_TYPE*>(left);
-         if(left_cast && factor_present.find(left_cast) == factor_present.end()) {
-            factors.push_back(left_cast);
-            factor_present.insert(left_cast);
+      for(auto* f : factors_) {
+         auto* f_cast = dynamic_cast<FACTOR_TYPE*>(f);
+         if(f_cast) {
+            factors.push_back(f_cast);
          }
-
-         auto* right = std::get<0>(t)->GetRightFactorTypeAdapter();
-         auto* right_cast = dynamic_cast<FACTOR_TYPE*>(right);
-         if(right_cast && factor_present.find(right_cast) == factor_present.end()) {
-            factors.push_back(right_cast);
-            factor_present.insert(right_cast);
-         } 
       }
       return factors;
    }
 
+   // let messages and factors point to other factors, e.g. to copies used in a Lagrangean decomposition
+   void redirect_factors(const std::unordered_map<FactorTypeAdapter*, FactorTypeAdapter*>& factor_mapping)
+   {
+      auto redirect = [&](FactorTypeAdapter* f) {
+         auto it = factor_mapping.find(f);
+         return it != factor_mapping.end() ? it->second : f;
+      };
+      for(auto& tree_msg : tree_messages_) {
+         std::visit([&](auto& m) {
+            m.SetLeftFactor(redirect(m.GetLeftFactorTypeAdapter()));
+            m.SetRightFactor(redirect(m.GetRightFactorTypeAdapter()));
+         }, std::get<0>(tree_msg));
+      }
+      for(auto& f : factors_) {
+         f = redirect(f);
+      }
+      if(root_ != nullptr) {
+         root_ = redirect(root_);
+      }
+   }
+
    struct free_message_container {
       template<class MESSAGE_CONTAINER_TYPE>
          using invoke = typename MESSAGE_CONTAINER_TYPE::free_message_container_type;
@@ -224,6 +308,20 @@ public:
    std::vector<FactorTypeAdapter*> factors_;
 
 protected:
+   template<typename TREE_MSG>
+   static FactorTypeAdapter* upper_factor(const TREE_MSG& tree_msg)
+   {
+      const Chirality c = std::get<1>(tree_msg);
+      return std::visit([c](const auto& m) { return c == Chirality::left ? m.GetLeftFactorTypeAdapter() : m.GetRightFactorTypeAdapter(); }, std::get<0>(tree_msg));
+   }
+   template<typename TREE_MSG>
+   static FactorTypeAdapter* lower_factor(const TREE_MSG& tree_msg)
+   {
+      const Chirality c = std::get<1>(tree_msg);
+      return std::visit([c](const auto& m) { return c == Chirality::left ? m.GetRightFactorTypeAdapter() : m.GetLeftFactorTypeAdapter(); }, std::get<0>(tree_msg));
+   }
+
+   FactorTypeAdapter* root_ = nullptr;
 };
 
 // factors can be shared among multiple trees. Equality between shared factors is enforced via Lagrangean multipliers
@@ -464,9 +562,17 @@ public:
     } 
   }
 
+  // Lagrangean variables to the trees before pos enter with positive, those to the trees after pos with negative sign
   void add_to_mapping(std::vector<int>& mapping)
   {
-    assert(false);
+    local_Lagrangean_vars_offset_ = mapping.size();
+    for(INDEX i=0; i<no_trees; ++i) {
+      if(i == pos) { continue; }
+      const INDEX o = i < pos ? global_offset(i, pos) : global_offset(pos, i);
+      for(INDEX k=0; k<no_Lagrangean_vars_; ++k) {
+        mapping.push_back(o + k);
+      }
+    }
   }
 
   void serialize_Lagrangean(const double* wi, const double scaling)
@@ -520,13 +626,10 @@ protected:
   INDEX no_trees; // number of trees in which factor is
   INDEX pos; // factor is in pos-th tree that contains it
 
-  INDEX global_offset(const INDEX offset, const INDEX i, const INDEX j) // offset for Lagrangean variables (i,j)
+  INDEX global_offset(const INDEX i, const INDEX j) const // offset for Lagrangean variables (i,j)
   {
-    //assert(no_trees <= 2);
     assert(i < j && j < no_trees);
-    assert(offset == global_Lagrangean_vars_offset_);
-    assert(false); // remove offset parameter
-    return offset + (i*no_trees - i*(i+1)/2 + (j-i-1))*no_Lagrangean_vars_; 
+    return global_Lagrangean_vars_offset_ + (i*no_trees - i*(i+1)/2 + (j-i-1))*no_Lagrangean_vars_; 
   }
 
   INDEX offset(const INDEX i) // offset for Lagrangean variables (i,j)
@@ -548,20 +651,90 @@ public:
    template<typename VECTOR1>
    void compute_mapped_subgradient(VECTOR1& subgradient)
    {
-      //const REAL subgradient_value = compute_subgradient();
-      //assert(false); // assert that subgradient has been computed!
-      std::vector<double> local_subgradient(mapping_.size(),0.0);
+      assert(local_weights_.size() == mapping_.size());
       // write primal solution into subgradient
-      for(auto L : Lagrangean_factors_) {
-         L.copy_fn(&local_subgradient[0]);
-      }
+      compute_local_subgradient(local_weights_.data());
       assert(mapping_.size() >= dual_size());
-      for(INDEX i=0; i<mapping_.size(); ++i) {
-         assert(mapping_[i] < subgradient.size());
-         subgradient[ mapping_[i] ] += local_subgradient[i];
+      assert(std::all_of(mapping_.begin(), mapping_.end(), [&](const int i) { return i < subgradient.size(); }));
+      // indices in mapping_ are unique, hence the scatter has no conflicts
+      auto* g = &subgradient[0];
+      const double* l = local_weights_.data();
+      const int* m = mapping_.data();
+      const INDEX n = mapping_.size();
+#pragma omp simd
+      for(INDEX i=0; i<n; ++i) {
+         g[m[i]] += l[i];
       } 
    }
 
+   // subgradient of the last solve, laid out as given by mapping_
+   void compute_local_subgradient(double* l)
+   {
+      if(views_) {
+         std::copy(view_subgradient_.begin(), view_subgradient_.end(), l);
+         return;
+      }
+      std::fill(l, l + mapping_.size(), 0.0);
+      for(auto& L : Lagrangean_factors_) {
+         L.copy_fn(l);
+      }
+   }
+
+   // gather Lagrangean variables of this tree from the global ones w and add them
+   void add_mapped_weights(const double* w, const double scaling)
+   {
+      assert(local_weights_.size() == mapping_.size());
+      double* l = local_weights_.data();
+      const int* m = mapping_.data();
+      const INDEX n = mapping_.size();
+#pragma omp simd
+      for(INDEX i=0; i<n; ++i) {
+         l[i] = w[m[i]];
+      }
+      add_weights(l, scaling);
+   }
+
+   // mapping from Lagrangean variables of this tree to global ones. Buffers for scatter/gather are allocated here once, hence oracle calls do not allocate.
+   void set_mapping(std::vector<int>&& m)
+   {
+      mapping_ = std::move(m);
+      assert(mapping_unique());
+      local_weights_.assign(mapping_.size(), 0.0);
+      applied_weights_.assign(mapping_.size(), 0.0);
+      if(views_) {
+         view_weights_.assign(mapping_.size(), 0.0);
+         view_subgradient_.assign(mapping_.size(), 0.0);
+      }
+   }
+
+   // keep the Lagrangean variables wi (laid out as given by mapping_) applied to the tree-local factor copies.
+   // Only the difference to the previously applied ones is added, hence weights need not be removed after solving.
+   void set_weights(const double* wi)
+   {
+      if(views_) {
+         std::copy(wi, wi + mapping_.size(), view_weights_.begin());
+         view_value_valid_ = false;
+         return;
+      }
+      assert(applied_weights_.size() == mapping_.size());
+      double* l = local_weights_.data();
+      double* a = applied_weights_.data();
+      const INDEX n = mapping_.size();
+#pragma omp simd
+      for(INDEX i=0; i<n; ++i) {
+         l[i] = wi[i] - a[i];
+         a[i] = wi[i];
+      }
+      add_weights(l, +1.0);
+   }
+
+   bool mapping_unique() const
+   {
+      std::vector<int> m(mapping_);
+      std::sort(m.begin(), m.end());
+      return std::adjacent_find(m.begin(), m.end()) == m.end();
+   }
+
    template<typename VECTOR>
    void compute_subgradient(VECTOR& subgradient, const REAL step_size)
    {
@@ -570,7 +743,7 @@ public:
 
       std::fill(subgradient.begin(), subgradient.end(), 0.0);
       // write primal solution into subgradient
-      for(auto L : Lagrangean_factors_) {
+      for(auto& L : Lagrangean_factors_) {
          L.copy_fn(&subgradient[0]);
       }
    }
@@ -596,11 +769,75 @@ public:
 
    void add_weights(const double* wi, const double scaling)
    {
+      if(views_) {
+         assert(view_weights_.size() == mapping_.size());
+         for(INDEX i=0; i<view_weights_.size(); ++i) {
+            view_weights_[i] += scaling*wi[i];
+         }
+         view_value_valid_ = false;
+         return;
+      }
       for(auto& L : Lagrangean_factors_) {
          L.serialize_Lagrangean(wi, scaling);
       }
    }
 
+   // Lagrangean factors are views: they refer to the shared original factors, which are not modified.
+   // A copy carrying the Lagrangean variables of this tree only exists during solve. Factors not shared with other trees are restored after solve, hence the tree is not reparametrized persistently.
+   // Value, subgradient and primal solution are kept for later queries.
+   // Must be called before Lagrangean factors are added.
+   void use_factor_views()
+   {
+      assert(Lagrangean_factors_.empty());
+      views_ = true;
+   }
+
+   bool factor_views() const { return views_; }
+
+   REAL solve()
+   {
+      if(!views_) {
+         return factor_tree<FMC>::solve();
+      }
+      materialize_factors();
+      view_value_ = factor_tree<FMC>::solve();
+      std::fill(view_subgradient_.begin(), view_subgradient_.end(), 0.0);
+      for(auto& L : Lagrangean_factors_) {
+         L.copy_fn(view_subgradient_.data());
+      }
+      write_primal(view_primal_.data());
+      release_factors();
+      view_value_valid_ = true;
+      // cost of the primal solution without Lagrangean variables, these enter linearly via the subgradient
+      view_primal_cost_ = view_value_ - std::inner_product(view_weights_.begin(), view_weights_.end(), view_subgradient_.begin(), 0.0);
+      return view_value_;
+   }
+
+   // cost of the primal solution of the last solve w.r.t. the current Lagrangean variables
+   REAL primal_cost() const
+   {
+      if(!views_) {
+         return factor_tree<FMC>::primal_cost();
+      }
+      return view_primal_cost_ + std::inner_product(view_weights_.begin(), view_weights_.end(), view_subgradient_.begin(), 0.0);
+   }
+
+   // With views, factors are not kept reparametrized, hence the optimal value of the last solve is returned.
+   // If Lagrangean variables changed since, the tree must be solved again. Subgradient and primal solution are left unchanged by this.
+   REAL lower_bound()
+   {
+      if(!views_) {
+         return factor_tree<FMC>::lower_bound();
+      }
+      if(!view_value_valid_) {
+         materialize_factors();
+         view_value_ = factor_tree<FMC>::solve();
+         release_factors();
+         view_value_valid_ = true;
+      }
+      return view_value_;
+   }
+
   // dual size of Lagrangeans connected to current tree
   INDEX compute_dual_size_in_bytes()
   {
@@ -622,9 +859,13 @@ public:
    
   void read_in_primal(void* p)
   {
+    if(views_) {
+      std::memcpy(view_primal_.data(), p, view_primal_.size());
+      return;
+    }
     serialization_archive ar(p, this->primal_size_in_bytes());
     load_archive l_ar(ar);
-    for(auto L : Lagrangean_factors_) {
+    for(auto& L : Lagrangean_factors_) {
       L.f->serialize_primal(l_ar);
     } 
     ar.release_memory();
@@ -632,12 +873,11 @@ public:
 
   void save_primal(void* p)
   {
-    serialization_archive ar(p, this->primal_size_in_bytes());
-    save_archive s_ar(ar);
-    for(auto L : Lagrangean_factors_) {
-      L.f->serialize_primal(s_ar);
-    } 
-    ar.release_memory();
+    if(views_) {
+      std::memcpy(p, view_primal_.data(), view_primal_.size());
+      return;
+    }
+    write_primal(p);
   }
 
   void init()
@@ -645,6 +885,10 @@ public:
     factor_tree<FMC>::init();
     dual_size_in_bytes_ = compute_dual_size_in_bytes();
     primal_size_in_bytes_ = compute_primal_size_in_bytes();
+    if(views_) {
+      view_primal_.assign(primal_size_in_bytes_, 0);
+      init_view_slots();
+    }
   }
 
 //protected:
@@ -664,8 +908,134 @@ public:
 
    INDEX subgradient_size;
    std::vector<int> mapping_;
+   std::vector<double> local_weights_; // Lagrangean variables and subgradient of this tree, laid out as given by mapping_
+   std::vector<double> applied_weights_; // Lagrangean variables currently applied by set_weights
 
    std::vector<FactorTypeAdapter*> original_factors_;
+
+private:
+  void write_primal(void* p)
+  {
+    serialization_archive ar(p, this->primal_size_in_bytes());
+    save_archive s_ar(ar);
+    for(auto& L : Lagrangean_factors_) {
+      L.f->serialize_primal(s_ar);
+    } 
+    ar.release_memory();
+  }
+
+  // Positions of the shared factors in the tree are computed once, hence exchanging them for copies needs no lookups.
+  // Duals of the remaining factors are saved before each solve and restored afterwards.
+  void init_view_slots()
+  {
+    assert(original_factors_.size() == Lagrangean_factors_.size());
+    std::unordered_map<FactorTypeAdapter*, INDEX> shared;
+    for(INDEX i=0; i<original_factors_.size(); ++i) {
+      shared.insert({original_factors_[i], i});
+    }
+    auto slot = [&](FactorTypeAdapter* f) {
+      auto it = shared.find(f);
+      return it != shared.end() ? it->second : no_slot;
+    };
+
+    view_factor_slots_.clear();
+    view_persistent_factors_.clear();
+    std::size_t dual_size = 0;
+    for(auto* f : this->factors_) {
+      view_factor_slots_.push_back(slot(f));
+      if(view_factor_slots_.back() == no_slot) {
+        view_persistent_factors_.push_back(f);
+        dual_size += f->dual_size_in_bytes();
+      }
+    }
+    view_message_slots_.clear();
+    for(auto& tree_msg : this->tree_messages_) {
+      std::visit([&](auto& m) {
+        view_message_slots_.push_back({slot(m.GetLeftFactorTypeAdapter()), slot(m.GetRightFactorTypeAdapter())});
+      }, std::get<0>(tree_msg));
+    }
+    view_root_slot_ = slot(this->root_);
+    view_duals_.assign(dual_size, 0);
+    view_copies_.resize(original_factors_.size());
+  }
+
+  // let the tree refer to f[i] in place of the i-th shared factor
+  void exchange_shared_factors(const std::vector<FactorTypeAdapter*>& f)
+  {
+    for(INDEX i=0; i<this->factors_.size(); ++i) {
+      if(view_factor_slots_[i] != no_slot) {
+        this->factors_[i] = f[view_factor_slots_[i]];
+      }
+    }
+    for(INDEX i=0; i<this->tree_messages_.size(); ++i) {
+      const auto slots = view_message_slots_[i];
+      std::visit([&](auto& m) {
+        if(slots[0] != no_slot) { m.SetLeftFactor(f[slots[0]]); }
+        if(slots[1] != no_slot) { m.SetRightFactor(f[slots[1]]); }
+      }, std::get<0>(this->tree_messages_[i]));
+    }
+    if(view_root_slot_ != no_slot) {
+      this->root_ = f[view_root_slot_];
+    }
+  }
+
+  template<typename ARCHIVE>
+  void serialize_persistent_duals()
+  {
+    if(view_duals_.empty()) { return; }
+    serialization_archive ar(view_duals_.data(), view_duals_.size());
+    ARCHIVE a(ar);
+    for(auto* f : view_persistent_factors_) {
+      f->serialize_dual(a);
+    }
+    ar.release_memory();
+  }
+
+  // factor allocation goes through per type memory pools, which are not thread safe. Only allocation and deallocation are guarded.
+  void materialize_factors()
+  {
+#pragma omp critical(LP_MP_factor_allocation)
+    for(INDEX i=0; i<original_factors_.size(); ++i) {
+      view_copies_[i] = original_factors_[i]->clone();
+    }
+    for(INDEX i=0; i<Lagrangean_factors_.size(); ++i) {
+      Lagrangean_factors_[i].f = view_copies_[i];
+    }
+    exchange_shared_factors(view_copies_);
+    serialize_persistent_duals<save_archive>();
+    for(auto& L : Lagrangean_factors_) {
+      L.serialize_Lagrangean(view_weights_.data(), +1.0);
+    }
+  }
+
+  void release_factors()
+  {
+    serialize_persistent_duals<load_archive>();
+    exchange_shared_factors(original_factors_);
+    for(INDEX i=0; i<Lagrangean_factors_.size(); ++i) {
+      Lagrangean_factors_[i].f = original_factors_[i];
+    }
+#pragma omp critical(LP_MP_factor_allocation)
+    for(auto* c : view_copies_) {
+      delete c;
+    }
+  }
+
+  static constexpr INDEX no_slot = std::numeric_limits<INDEX>::max();
+
+  bool views_ = false;
+  std::vector<double> view_weights_; // Lagrangean variables, applied when factors are materialized
+  std::vector<double> view_subgradient_;
+  std::vector<char> view_primal_;
+  REAL view_value_ = 0.0; // optimal value of the tree w.r.t. view_weights_, if view_value_valid_
+  bool view_value_valid_ = false;
+  REAL view_primal_cost_ = 0.0;
+  std::vector<INDEX> view_factor_slots_; // for each entry of factors_ the index of the shared factor or no_slot
+  std::vector<std::array<INDEX,2>> view_message_slots_;
+  INDEX view_root_slot_ = no_slot;
+  std::vector<FactorTypeAdapter*> view_persistent_factors_; // factors not shared with other trees
+  std::vector<char> view_duals_;
+  std::vector<FactorTypeAdapter*> view_copies_;
 };
 
 // do zrobienia: templatize base class
@@ -675,11 +1045,15 @@ class LP_with_trees : public LP<FMC>
 public:
    LP_with_trees(TCLAP::CmdLine& cmd)
      : LP<FMC>(cmd),
-     tree_decomposition_begin_arg_("","treeDecompositionBegin","after how many iterations to start tree decomposition based optimization", false, 0, "", cmd)
+     tree_decomposition_begin_arg_("","treeDecompositionBegin","after how many iterations to start tree decomposition based optimization", false, 0, "", cmd),
+     factor_views_arg_("","factorViews","do not keep a copy of each shared factor in every tree, but materialize copies only while a tree is solved", cmd)
   {}
 
    ~LP_with_trees()
    {
+     if(factor_views()) {
+       return; // trees refer to original factors
+     }
      // redirect messages back to original factors
      for(auto& t : trees_) {
        assert(t.original_factors_.size() == t.Lagrangean_factors_.size());
@@ -688,19 +1062,7 @@ public:
          copy_to_original_factor.insert({t.Lagrangean_factors_[i].f, t.original_factors_[i]});
        } 
 
-       for(auto tree_msg : t.tree_messages_) {
-         auto* m = std::get<0>(tree_msg);
-         auto* left = m->GetLeftFactor();
-         auto* right = m->GetRightFactor();
-         if(copy_to_original_factor.find(left) != copy_to_original_factor.end()) {
-           auto* left_original = copy_to_original_factor.find(left)->second;
-           m->SetLeftFactor(left_original);
-         }
-         if(copy_to_original_factor.find(right) != copy_to_original_factor.end()) {
-           auto* right_original = copy_to_original_factor.find(right)->second;
-           m->SetRightFactor(right_original);
-         }
-       } 
+       t.redirect_factors(copy_to_original_factor);
      }
 
      // delete copies of factors
@@ -717,10 +1079,65 @@ public:
      trees_.push_back(lt);
    }
 
+   // decompose the factor graph automatically into trees via a forest cover, with factors as nodes and messages as edges.
+   // Every message is in exactly one tree. Factors in several trees are copied by construct_decomposition and coupled by Lagrangean variables.
+   // Factors without messages form a tree of their own.
+   void add_forest_cover()
+   {
+      std::vector<std::array<INDEX,2>> edges;
+      edges.reserve(this->m_.size());
+      std::vector<char> connected(this->f_.size(), false);
+      for_each_tuple(this->messages_, [&](auto& msg_vec) {
+         for(auto* m : msg_vec) {
+            assert(this->factor_address_to_index_.count(m->GetLeftFactor()) > 0 && this->factor_address_to_index_.count(m->GetRightFactor()) > 0);
+            edges.push_back({this->factor_address_to_index_.find(m->GetLeftFactor())->second, this->factor_address_to_index_.find(m->GetRightFactor())->second});
+            connected[edges.back()[0]] = true;
+            connected[edges.back()[1]] = true;
+         }
+      });
+
+      const auto forests = greedy_forest_cover(this->f_.size(), edges);
+      std::vector<INDEX> edge_tree(edges.size());
+      std::vector<Chirality> edge_chirality(edges.size());
+      for(INDEX t=0; t<forests.size(); ++t) {
+         for(const auto& e : forests[t]) {
+            edge_tree[e.edge] = t;
+            edge_chirality[e.edge] = e.upper == edges[e.edge][0] ? Chirality::left : Chirality::right;
+         }
+      }
+
+      std::vector<factor_tree<FMC>> trees(forests.size());
+      INDEX k = 0;
+      for_each_tuple(this->messages_, [&](auto& msg_vec) {
+         for(auto* m : msg_vec) {
+            trees[edge_tree[k]].add_message(*m, edge_chirality[k]);
+            ++k;
+         }
+      });
+      for(INDEX i=0; i<this->f_.size(); ++i) {
+         if(!connected[i]) {
+            trees.emplace_back();
+            trees.back().add_factor(this->f_[i]);
+         }
+      }
+      for(auto& t : trees) {
+         t.init();
+         add_tree(t);
+      }
+      if(diagnostics()) {
+         std::cout << "decomposed factor graph into " << trees.size() << " trees\n";
+      }
+   }
+
    // find out, which factors are shared between trees and add Lagrangean multipliers for them.
    void construct_decomposition()
    {
      constructed_decomposition = true;
+     if(factor_views()) {
+       for(auto& t : trees_) {
+         t.use_factor_views();
+       }
+     }
       // first, go over all Lagrangean factors in each tree and count how often factor is shared
       struct Lagrangean_counting {
          //INDEX position = 0; // counter for enumerating in which position (i.e. in how many trees was factor already observed)
@@ -753,9 +1170,13 @@ public:
           //L.factors.push_back(LAGRANGEAN_FACTOR(f));
 
           for(INDEX i : tree_indices) {
-            auto* f_copy = f->clone(); // do zrobienia: possibly not all pointers to messages have to be cloned as well
-            L.factors.push_back(LAGRANGEAN_FACTOR(f_copy));
-            factor_mapping[i].insert(std::make_pair(f, f_copy)); 
+            if(factor_views()) {
+              L.factors.push_back(LAGRANGEAN_FACTOR(f));
+            } else {
+              auto* f_copy = f->clone(); // do zrobienia: possibly not all pointers to messages have to be cloned as well
+              L.factors.push_back(LAGRANGEAN_FACTOR(f_copy));
+              factor_mapping[i].insert(std::make_pair(f, f_copy)); 
+            }
           }
 
           const INDEX no_Lagrangean_vars = LAGRANGEAN_FACTOR::joint_no_Lagrangean_vars( L.factors );
@@ -777,27 +1198,8 @@ public:
       for(INDEX i=0; i<trees_.size(); ++i) {
          auto& t = trees_[i];
          
-         // redirect links from messages in trees that are directed to current factor
-         for(auto tree_msg : trees_[i].tree_messages_) {
-            auto* m = std::get<0>(tree_msg);
-            auto* left = m->GetLeftFactor();
-            auto* right = m->GetRightFactor();
-            if(factor_mapping[i].find(left) != factor_mapping[i].end()) {
-               auto* left_copy = factor_mapping[i].find(left)->second;
-               m->SetLeftFactor(left_copy);
-            }
-            if(factor_mapping[i].find(right) != factor_mapping[i].end()) {
-               auto* right_copy = factor_mapping[i].find(right)->second;
-               m->SetRightFactor(right_copy);
-            }
-         }
-         // search for factor in tree and change it as well
-         for(auto& f : t.factors_) {
-            if(factor_mapping[i].find(f) != factor_mapping[i].end()) {
-               auto* f_copy = factor_mapping[i].find(f)->second;
-               f = f_copy;
-            } 
-         }
+         // redirect links from messages and factors in tree to the copies
+         t.redirect_factors(factor_mapping[i]);
       }
 
       // set primal and dual size for tree
@@ -816,12 +1218,14 @@ public:
          }
          assert(m.size() <= Lagrangean_vars_size_);
          //assert(m.size() == t.dual_size());
-         t.mapping_ = m;
+         t.set_mapping(std::move(m));
       }
 
       // check map validity: each entry in m (except last one) must occur exactly twice
       assert(mapping_valid()); 
 
+      compute_tree_schedule();
+
       static_cast<DECOMPOSITION_SOLVER*>(this)->construct_decomposition();
    }
 
@@ -843,6 +1247,8 @@ public:
    }
 
    INDEX no_Lagrangean_vars() const { return Lagrangean_vars_size_; } 
+
+   bool factor_views() const { return factor_views_arg_.getValue(); }
    
    void ComputeForwardPassAndPrimal(const INDEX iteration) 
    {
@@ -860,6 +1266,9 @@ public:
      if(iteration < tree_decomposition_iter) {
        LP<FMC>::ComputePass(iteration);
      } else if(iteration == tree_decomposition_iter) {
+       if(trees_.empty()) {
+         add_forest_cover();
+       }
        construct_decomposition();
        static_cast<DECOMPOSITION_SOLVER*>(this)->optimize_decomposition(iteration); 
      } else {
@@ -877,7 +1286,7 @@ public:
      }
    }
 
-   REAL decomposition_lower_bound() const
+   REAL decomposition_lower_bound()
    {
      REAL lb = 0.0;
      for(auto& t : trees_) {
@@ -888,23 +1297,62 @@ public:
 
    void add_weights(const double* w, const REAL scaling) 
    {
-      for(INDEX i=0; i<trees_.size(); ++i) {
-         auto& tree = trees_[i];
-         const auto& m = tree.mapping();
-         std::vector<double> local_weights;
-         local_weights.reserve(m.size());
-         for(INDEX idx=0; idx<m.size(); ++idx) {
-            local_weights.push_back(w[m[idx]]);
-         }
-         tree.add_weights(&local_weights[0], scaling);
+      for_each_tree_parallel([&](auto& tree, const INDEX) {
+         tree.add_mapped_weights(w, scaling);
+      });
+   }
+
+   // Trees are independent given the Lagrangean variables, since shared factors are copied into each tree. Hence they can be processed in parallel.
+   // f(tree, thread) is called for every tree, with thread < no_threads().
+   template<typename FUNC>
+   void for_each_tree_parallel(FUNC f)
+   {
+      assert(tree_schedule_.size() == trees_.size());
+#pragma omp parallel for schedule(dynamic,1)
+      for(INDEX k=0; k<tree_schedule_.size(); ++k) {
+         f(trees_[tree_schedule_[k]], thread_number());
       }
    }
 
+   static INDEX no_threads()
+   {
+#ifdef _OPENMP
+      return omp_get_max_threads();
+#else
+      return 1;
+#endif
+   }
+
+   static INDEX thread_number()
+   {
+#ifdef _OPENMP
+      return omp_get_thread_num();
+#else
+      return 0;
+#endif
+   }
 
 protected:
+   // Trees sorted by decreasing size, measured as the dual size of their factors, on which the running time of dynamic programming mostly depends.
+   // Handing out large trees first under dynamic scheduling keeps threads from idling at the end while a single large tree is still being solved.
+   void compute_tree_schedule()
+   {
+      std::vector<std::size_t> tree_size(trees_.size(), 0);
+      for(INDEX i=0; i<trees_.size(); ++i) {
+         for(auto* f : trees_[i].factors_) {
+            tree_size[i] += f->dual_size();
+         }
+      }
+      tree_schedule_.resize(trees_.size());
+      std::iota(tree_schedule_.begin(), tree_schedule_.end(), 0);
+      std::stable_sort(tree_schedule_.begin(), tree_schedule_.end(), [&](const INDEX i, const INDEX j) { return tree_size[i] > tree_size[j]; });
+   }
+
    std::vector<LP_tree_Lagrangean<FMC,LAGRANGEAN_FACTOR>> trees_; // store for each tree the associated Lagrangean factors.
+   std::vector<INDEX> tree_schedule_; // order in which trees are processed in parallel
    INDEX Lagrangean_vars_size_;
    TCLAP::ValueArg<INDEX> tree_decomposition_begin_arg_; 
+   TCLAP::SwitchArg factor_views_arg_;
    bool constructed_decomposition = false;
 };
 
@@ -915,30 +1363,46 @@ class LP_subgradient_ascent : public LP_with_trees<FMC, Lagrangean_factor_quadra
 public:
    using LP_with_trees<FMC, Lagrangean_factor_quadratic, LP_subgradient_ascent<FMC>>::LP_with_trees;
 
-   void construct_decomposition() {}
+   // buffers for subgradients are allocated once here, hence iterations do not allocate
+   void construct_decomposition()
+   {
+      thread_subgradient_.assign(this->no_threads(), std::vector<REAL>(this->no_Lagrangean_vars(), 0.0));
+      subgradient_.assign(this->no_Lagrangean_vars(), 0.0);
+      tree_lower_bound_.assign(this->trees_.size(), 0.0);
+      best_lower_bound = -std::numeric_limits<REAL>::infinity();
+   }
 
    void optimize_decomposition(const INDEX iteration)
    {
-      REAL current_lower_bound = 0.0;
-      std::vector<REAL> subgradient(this->no_Lagrangean_vars(), 0.0);
-      for(INDEX i=0; i<this->trees_.size(); ++i) {
-         current_lower_bound += this->trees_[i].solve();
-         this->trees_[i].compute_mapped_subgradient(subgradient); // note that mapping has one extra component!
-         //trees_[i].primal_cost();
+      for(auto& g : thread_subgradient_) {
+         std::fill(g.begin(), g.end(), 0.0);
+      }
+      this->for_each_tree_parallel([&](auto& t, const INDEX thread) {
+         tree_lower_bound_[&t - &this->trees_[0]] = t.solve();
+         t.compute_mapped_subgradient(thread_subgradient_[thread]); // note that mapping has one extra component!
+      });
+      // summing up in tree order keeps the lower bound independent of the thread assignment
+      const REAL current_lower_bound = std::accumulate(tree_lower_bound_.begin(), tree_lower_bound_.end(), REAL(0.0));
+      std::fill(subgradient_.begin(), subgradient_.end(), 0.0);
+      for(const auto& g : thread_subgradient_) {
+         std::transform(g.begin(), g.end(), subgradient_.begin(), subgradient_.begin(), std::plus<REAL>());
       }
       best_lower_bound = std::max(current_lower_bound, best_lower_bound);
-      assert(std::find_if(subgradient.begin(), subgradient.end(), [](auto x) { return x != 0.0 && x != 1.0 && x != -1.0; }) == subgradient.end());
-      const REAL subgradient_one_norm = std::accumulate(subgradient.begin(), subgradient.end(), 0.0, [=](REAL s, REAL x) { return s + std::abs(x); });
+      assert(std::find_if(subgradient_.begin(), subgradient_.end(), [](auto x) { return x != 0.0 && x != 1.0 && x != -1.0; }) == subgradient_.end());
+      const REAL subgradient_one_norm = std::accumulate(subgradient_.begin(), subgradient_.end(), 0.0, [=](REAL s, REAL x) { return s + std::abs(x); });
+      if(subgradient_one_norm == 0.0) { return; } // all trees agree on shared factors, hence the decomposition is optimal
 
-      const REAL step_size = (best_lower_bound - current_lower_bound + subgradient.size())/(10.0 + iteration) / subgradient_one_norm;
+      const REAL step_size = (best_lower_bound - current_lower_bound + subgradient_.size())/(10.0 + iteration) / subgradient_one_norm;
 
       std::cout << "stepsize = " << step_size << ", absolute value of subgradient = " << subgradient_one_norm << "\n";
-      this->add_weights(&subgradient[0], step_size);
+      this->add_weights(&subgradient_[0], step_size);
    }
 
 private:
+   std::vector<std::vector<REAL>> thread_subgradient_;
+   std::vector<REAL> subgradient_;
+   std::vector<REAL> tree_lower_bound_;
    REAL best_lower_bound;
-   REAL step_size;
 };
 
 } // end namespace LP_MP
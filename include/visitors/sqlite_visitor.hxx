@@ -5,9 +5,13 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 #include "standard_visitor.hxx"
 #include "help_functions.hxx"
+#include "spsc_queue.hxx"
 
 namespace LP_MP {
 
@@ -19,7 +23,7 @@ struct IterationStatistics {
 };
 
 // this visitor connects to given sqlite database and writes or updates the runtime and iteration data of the algorithm.
-// do zrobienia: transaction support to avoid concurrent writing to database?
+// Iterations are handed to a background thread through a lock-free queue and inserted in batched transactions, so that database latency does not slow down the solver.
 // do zrobienia: error handling
 template<class BASE_VISITOR = StandardVisitor>
 
@@ -120,6 +124,8 @@ public:
          algorithmNameArg_("","algorithmName","name of algorithm",true,"","string",cmd),
          algorithmFMCArg_("","algorithmFMC","FMC of algorithm", true, "", "string", cmd),
          overwriteDbRecordArg_("","overwriteDbRecord","if true: overwrite previous record. if false: if record is present, abort optimization",cmd,false),
+         databaseWriteIntervalArg_("","databaseWriteInterval","milliseconds between batched writes of iterations into the database",false,1000,&positiveIntegerConstraint,cmd),
+         iterationQueue_(1 << 16),
          database_(nullptr)
    {
       // get inputFile argument from cmd
@@ -137,6 +143,7 @@ public:
 
    ~SqliteVisitor()
    {
+      StopWriter();
       if(database_) {
          sqlite3_close(database_);
       }
@@ -219,7 +226,8 @@ public:
       return i>0;
    }
 
-   LpControl begin(LP& lp) // called, after problem is constructed. 
+   template<typename LP_TYPE>
+   LpControl begin(LP_TYPE& lp) // called, after problem is constructed. 
    {
       auto ret = BaseVisitor::begin(lp);
       try {
@@ -252,8 +260,15 @@ public:
       if(!overwriteDbRecord_ && CheckIterationsPresent(solver_id_, instance_id_)) { 
          std::cout << "Not performing optimization, as instance was already optimized with same algorithm\n";
          ret.error = true;
+         return ret;
       }
 
+      // iterations of a previous run are removed in the writer's first transaction, so that they are replaced atomically
+      clearIterations_ = true;
+      writeInterval_ = std::chrono::milliseconds(databaseWriteIntervalArg_.getValue());
+      stopWriter_ = false;
+      writer_ = std::thread([this]() { this->RunWriter(); });
+
       return ret;
    }
 
@@ -263,7 +278,7 @@ public:
       
       const INDEX timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - BaseVisitor::GetBeginTime()).count();
       const INDEX curIter = BaseVisitor::GetIter();
-      iterationStatistics_.push_back({curIter,timeElapsed,lowerBound,upperBound});
+      PushIteration({curIter,timeElapsed,lowerBound,upperBound});
 
       return ret_state;
    }
@@ -272,10 +287,13 @@ public:
    {
       const INDEX timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - BaseVisitor::GetBeginTime()).count();
       const INDEX curIter = BaseVisitor::GetIter();
-      iterationStatistics_.push_back({curIter+1,timeElapsed,lowerBound,upperBound}); // additional fake iteration, e.g. for post-processing, collecting primal rounding by external rounding routines etc.
+      PushIteration({curIter+1,timeElapsed,lowerBound,upperBound}); // additional fake iteration, e.g. for post-processing, collecting primal rounding by external rounding routines etc.
 
       std::cout << "write bounds to database\n";
-      WriteBounds(iterationStatistics_);
+      StopWriter();
+      if(writerError_) {
+         std::rethrow_exception(writerError_);
+      }
    }
 
    void solution(const std::string& sol)
@@ -300,38 +318,103 @@ public:
       assert(rc == SQLITE_OK); 
    }
 
-   void WriteBounds(const std::vector<IterationStatistics>& iterStats)
+   // remove iterations of a previous run. Must be called within a transaction
+   void ClearIterations()
    {
-      // connection to database is open and we have a corresponding id in ProblemSolverTable
-      // Write into Iterations all iterations
-      // first remove all iterations previously in this table
-      int rc;
-      rc = sqlite3_exec(database_,"BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
-      assert(rc == SQLITE_OK);
-      const std::string rmIterStmt = "DELETE FROM Iterations WHERE solver_id = " + std::to_string(solver_id_) + " AND instance_id = " + std::to_string(instance_id_) + "\n";
-      rc = sqlite3_exec(database_, rmIterStmt.c_str(), nullptr, nullptr, nullptr);
-      assert(rc == 0);
+      const std::string rmIterStmt = "DELETE FROM Iterations WHERE solver_id = " + std::to_string(solver_id_) + " AND instance_id = " + std::to_string(instance_id_) + ";";
+      if(sqlite3_exec(database_, rmIterStmt.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+         const std::string error = sqlite3_errmsg(database_);
+         sqlite3_exec(database_,"ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+         throw std::runtime_error("Could not remove previous iterations: " + error);
+      }
+   }
+
+   // insert all iterations in one transaction with a prepared statement. The first transaction also removes iterations of a previous run
+   void WriteBounds(sqlite3_stmt* insert, const std::vector<IterationStatistics>& iterStats)
+   {
+      if(sqlite3_exec(database_,"BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+         throw std::runtime_error(std::string("Could not begin transaction: ") + sqlite3_errmsg(database_));
+      }
+      if(clearIterations_) {
+         ClearIterations();
+      }
       for(const auto& it : iterStats) {
-         const std::string stmt = "INSERT INTO Iterations (solver_id, instance_id, iteration, runtime, lowerBound, upperBound) VALUES ('" + std::to_string(solver_id_) + "', '" + std::to_string(instance_id_) + "', '" + std::to_string(it.iteration_) + "', '" + std::to_string(it.timeElapsed_) + "', '" + std::to_string(it.lowerBound_) + "', '" + std::to_string(it.upperBound_) + "');";
-         rc = sqlite3_exec(database_, stmt.c_str(), nullptr, nullptr, nullptr);
-         if(rc != SQLITE_OK) {
+         sqlite3_bind_int(insert, 1, solver_id_);
+         sqlite3_bind_int(insert, 2, instance_id_);
+         sqlite3_bind_int64(insert, 3, it.iteration_);
+         sqlite3_bind_int64(insert, 4, it.timeElapsed_);
+         sqlite3_bind_double(insert, 5, it.lowerBound_);
+         sqlite3_bind_double(insert, 6, it.upperBound_);
+         const int rc = sqlite3_step(insert);
+         sqlite3_reset(insert);
+         if(rc != SQLITE_DONE) {
+            const std::string error = sqlite3_errmsg(database_);
             sqlite3_exec(database_,"ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-            throw std::runtime_error("Could not insert iteration information: " + stmt);
+            throw std::runtime_error("Could not insert iteration " + std::to_string(it.iteration_) + ": " + error);
          }
-         assert(rc == 0);
       }
       if(sqlite3_exec(database_,"END TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
          throw std::runtime_error(std::string("Could not commit transaction: ") + sqlite3_errmsg(database_) );
       }
-      assert(rc == SQLITE_OK);
+      clearIterations_ = false;
    }
 
 private:
+   // called by the solver thread only. If the writer falls behind by a whole queue, the solver waits instead of dropping iterations.
+   void PushIteration(const IterationStatistics& it)
+   {
+      while(!iterationQueue_.try_push(it)) {
+         std::this_thread::yield();
+      }
+   }
+
+   // the database connection is used exclusively by the writer thread while it runs.
+   // After an error the queue is still drained, so that the solver never waits on it.
+   void RunWriter()
+   {
+      sqlite3_stmt* insert = nullptr;
+      const char* insertSQL = "INSERT INTO Iterations (solver_id, instance_id, iteration, runtime, lowerBound, upperBound) VALUES (?, ?, ?, ?, ?, ?);";
+      if(sqlite3_prepare_v2(database_, insertSQL, -1, &insert, nullptr) != SQLITE_OK) {
+         writerError_ = std::make_exception_ptr(std::runtime_error(std::string("Could not prepare statement: ") + sqlite3_errmsg(database_)));
+      }
+      std::vector<IterationStatistics> batch;
+      while(true) {
+         // read the stop flag before draining, so that iterations pushed before stopping are always written
+         const bool stop = stopWriter_.load(std::memory_order_acquire);
+         batch.clear();
+         iterationQueue_.pop_all(batch);
+         if(!batch.empty()) {
+            if(!writerError_) {
+               try {
+                  WriteBounds(insert, batch);
+               } catch(...) {
+                  writerError_ = std::current_exception();
+               }
+            }
+         } else if(stop) {
+            break;
+         } else {
+            std::this_thread::sleep_for(writeInterval_);
+         }
+      }
+      sqlite3_finalize(insert);
+   }
+
+   // write all queued iterations and wait for the writer thread
+   void StopWriter()
+   {
+      if(writer_.joinable()) {
+         stopWriter_.store(true, std::memory_order_release);
+         writer_.join();
+      }
+   }
+
    TCLAP::ValueArg<std::string> databaseFileArg_;
    TCLAP::ValueArg<std::string> datasetNameArg_;
    TCLAP::ValueArg<std::string> algorithmNameArg_; // custom name given for algorithm, to differentiate between same algorithm with differing options
    TCLAP::ValueArg<std::string> algorithmFMCArg_; 
    TCLAP::SwitchArg overwriteDbRecordArg_;
+   TCLAP::ValueArg<INDEX> databaseWriteIntervalArg_;
 
    std::string databaseFile_;
    std::string datasetName_;
@@ -340,7 +423,12 @@ private:
    bool overwriteDbRecord_;
    TCLAP::Arg* inputFileArg_;
 
-   std::vector<IterationStatistics> iterationStatistics_;
+   spsc_queue<IterationStatistics> iterationQueue_;
+   std::chrono::milliseconds writeInterval_;
+   std::atomic<bool> stopWriter_{false};
+   bool clearIterations_ = false; // set before the writer thread starts, then used by it only
+   std::exception_ptr writerError_; // set by the writer thread, read after it has been joined
+   std::thread writer_;
 
    sqlite3* database_;
    int solver_id_;
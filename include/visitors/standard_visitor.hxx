@@ -29,8 +29,10 @@ namespace LP_MP {
          :
             posRealConstraint_(),
             posIntegerConstraint_(),
+            openUnitIntervalConstraint_(),
             maxIterArg_("","maxIter","maximum number of iterations of LP_MP, default = 1000",false,1000,&posIntegerConstraint_,cmd),
-            maxMemoryArg_("","maxMemory","maximum amount of memory (MB) LP_MP is allowed to use",false,std::numeric_limits<INDEX>::max(),"positive integer",cmd),
+            maxMemoryArg_("","maxMemory","maximum amount of resident memory (MB) LP_MP is allowed to use. Tightening is restricted when the budget is approached, optimization stops with the best primal when it is exceeded",false,std::numeric_limits<INDEX>::max(),"positive integer",cmd),
+            memoryPressureFractionArg_("","memoryPressureFraction","fraction of maxMemory from which on no constraints are added in tightening and inactive tightening factors are retired, default = 0.9",false,0.9,&openUnitIntervalConstraint_,cmd),
             timeoutArg_("","timeout","time after which algorithm is stopped, in seconds, default = never, should this be type double?",false,std::numeric_limits<INDEX>::max(),&posIntegerConstraint_,cmd),
             // xor those //
             //boundComputationIntervalArg_("","boundComputationInterval","lower bound computation performed every x-th iteration, default = 5",false,5,"positive integer",cmd),
@@ -42,7 +44,8 @@ namespace LP_MP {
             minDualImprovementIntervalArg_("","minDualImprovementInterval","the interval between which at least minimum dual improvement must occur",false,10,&posIntegerConstraint_,cmd),
             standardReparametrizationArg_("","standardReparametrization","mode of reparametrization",false,"anisotropic","{anisotropic|damped_uniform|uniform}",cmd),
             roundingReparametrizationArg_("","roundingReparametrization","mode of reparametrization for rounding primal solution:",false,"damped_uniform","{anisotropic|damped_uniform|uniform}",cmd),
-            primalTime_(0)
+            adaptiveComputationIntervalsArg_("","adaptiveComputationIntervals","choose lower bound and primal computation intervals from their measured cost relative to a message passing iteration. Overrides lowerBoundComputationInterval and primalComputationInterval",cmd,false),
+            computationTimeFractionArg_("","computationTimeFraction","with adaptiveComputationIntervals: maximal fraction of runtime spent in lower bound and in primal computation each, default = 0.1",false,0.1,&openUnitIntervalConstraint_,cmd)
       {}
 
       template<typename LP_TYPE>
@@ -51,6 +54,7 @@ namespace LP_MP {
          try {
             maxIter_ = maxIterArg_.getValue();
             maxMemory_ = maxMemoryArg_.getValue();
+            memoryPressureFraction_ = memoryPressureFractionArg_.getValue();
             remainingIter_ = maxIter_;
             minDualImprovement_ = minDualImprovementArg_.getValue();
             minDualImprovementInterval_ = minDualImprovementIntervalArg_.getValue();
@@ -59,6 +63,8 @@ namespace LP_MP {
             primalComputationInterval_ = primalComputationIntervalArg_.getValue();
             primalComputationStart_ = primalComputationStartArg_.getValue();
             lowerBoundComputationInterval_ = lowerBoundComputationIntervalArg_.getValue();
+            adaptiveComputationIntervals_ = adaptiveComputationIntervalsArg_.getValue();
+            computationTimeFraction_ = computationTimeFractionArg_.getValue();
 
             standardReparametrization_ = LPReparametrizationModeConvert( standardReparametrizationArg_.getValue() );
             roundingReparametrization_ = LPReparametrizationModeConvert( roundingReparametrizationArg_.getValue() );
@@ -131,6 +137,10 @@ namespace LP_MP {
          curIter_++;
          remainingIter_--;
 
+         if(adaptiveComputationIntervals_) {
+            UpdateAdaptiveIntervals(c, lowerBound, primalBound);
+         }
+
          LpControl ret;
 
          if(c.computePrimal) {
@@ -153,12 +163,8 @@ namespace LP_MP {
             if(verbosity >= 1) { std::cout << "Timeout reached after " << timeElapsed << " seconds\n"; }
             remainingIter_ = std::min(INDEX(1),remainingIter_);
          }
-         if(maxMemory_ > 0) {
-            const INDEX memoryUsed = memory_used()/(1024*1024);
-            if(maxMemory_ < memoryUsed) {
-               remainingIter_ = std::min(INDEX(1),remainingIter_);
-               if(verbosity >= 1) { std::cout << "Solver uses " << memoryUsed << " MB memory, aborting optimization\n"; }
-            }
+         if(maxMemoryArg_.isSet()) {
+            ret.memoryHeadroom = CheckMemory();
          }
          if(c.computeLowerBound && curIter_ >= minDualImprovementInterval_ && minDualImprovementArg_.isSet()) {
             assert(lowerBound_.size() >= minDualImprovementInterval_);
@@ -179,16 +185,91 @@ namespace LP_MP {
 
          // determine next steps of solver
          ret.repam = standardReparametrization_;
-         if(curIter_ >= primalComputationStart_ && (curIter_ - primalComputationStart_) % primalComputationInterval_ == 0) {
-            ret.computePrimal = true; 
-            ret.repam = roundingReparametrization_;
+         if(adaptiveComputationIntervals_) {
+            ret.computePrimal = curIter_ >= primalComputationStart_ && curIter_ >= nextPrimalIteration_;
+            ret.computeLowerBound = curIter_ >= nextLowerBoundIteration_;
+         } else {
+            ret.computePrimal = curIter_ >= primalComputationStart_ && (curIter_ - primalComputationStart_) % primalComputationInterval_ == 0;
+            ret.computeLowerBound = curIter_ % lowerBoundComputationInterval_ == 0;
          }
-         if(curIter_ % lowerBoundComputationInterval_ == 0) {
-           ret.computeLowerBound = true;
+         if(ret.computePrimal) {
+            ret.repam = roundingReparametrization_;
          }
          return ret;
       }
 
+      // Measure cost of lower bound and primal computation relative to one message passing iteration from the phase times reported by the solver.
+      // An interval of k iterations keeps a computation of cost t under fraction f of the runtime if t <= f*(k*pass + t), i.e. k >= t*(1-f)/(f*pass).
+      // On top of this minimum the interval is halved whenever the computation closed the gap and doubled when it did not.
+      void UpdateAdaptiveIntervals(const LpControl c, const REAL lowerBound, const REAL primalBound)
+      {
+         const auto& t = c.phaseTime;
+         const REAL pass = t[std::size_t(solver_phase::message_passing)] + t[std::size_t(solver_phase::weights)];
+         if(!c.computePrimal) {
+            passTime_ = RunningAverage(passTime_, pass);
+         }
+         const REAL gap = primalBound - lowerBound;
+
+         if(c.computeLowerBound) {
+            lowerBoundTime_ = RunningAverage(lowerBoundTime_, t[std::size_t(solver_phase::lower_bound)]);
+            UpdateStretch(lowerBoundStretch_, GapClosing(lowerBound - lastLowerBound_, gap));
+            lastLowerBound_ = lowerBound;
+            nextLowerBoundIteration_ = curIter_ - 1 + AdaptiveInterval(lowerBoundTime_, lowerBoundStretch_);
+         }
+         if(c.computePrimal) {
+            // rounding interleaved with message passing makes the pass itself more expensive
+            primalTime_ = RunningAverage(primalTime_, t[std::size_t(solver_phase::primal)] + std::max(pass - passTime_, REAL(0.0)));
+            UpdateStretch(primalStretch_, GapClosing(lastPrimalBound_ - primalBound, gap));
+            lastPrimalBound_ = primalBound;
+            nextPrimalIteration_ = curIter_ - 1 + AdaptiveInterval(primalTime_, primalStretch_);
+         }
+      }
+
+      static REAL RunningAverage(const REAL average, const REAL x) { return average > 0.0 ? 0.7*average + 0.3*x : x; }
+
+      // improvement of a bound is progress if it closes at least one percent of the gap
+      static bool GapClosing(const REAL improvement, const REAL gap)
+      {
+         if(!std::isfinite(improvement)) { return improvement > 0.0; }
+         if(!std::isfinite(gap)) { return improvement > eps; }
+         return improvement > 0.01*gap;
+      }
+
+      static void UpdateStretch(INDEX& stretch, const bool closing)
+      {
+         stretch = closing ? std::max(stretch/2, INDEX(1)) : std::min(2*stretch, maxAdaptiveStretch);
+      }
+
+      INDEX AdaptiveInterval(const REAL cost, const INDEX stretch) const
+      {
+         if(passTime_ <= 0.0) { return 1; }
+         const REAL f = computationTimeFraction_;
+         const REAL minInterval = std::ceil(cost*(1.0-f)/(f*passTime_));
+         return std::max(INDEX(std::min(minInterval, REAL(maxIter_))), INDEX(1)) * stretch;
+      }
+
+      // Resident memory is measured, as this is what gets processes killed. Memory held by the arenas is reported alongside.
+      // Returns bytes left until memory pressure. When the budget is exceeded, the next iteration is the last one.
+      std::size_t CheckMemory()
+      {
+         const std::size_t memoryUsed = memory_used(true);
+         const std::size_t maxMemory = std::size_t(maxMemory_)*1024*1024;
+         const std::size_t pressureMemory = std::size_t(memoryPressureFraction_*maxMemory);
+         auto report = [&]() {
+            std::cout << memoryUsed/(1024*1024) << " MB resident memory, thereof " << arena_memory_reserved()/(1024*1024) << " MB in arenas, budget " << maxMemory_ << " MB";
+         };
+         if(memoryUsed > maxMemory) {
+            remainingIter_ = std::min(INDEX(1),remainingIter_);
+            if(verbosity >= 1) { std::cout << "Solver uses "; report(); std::cout << ", aborting optimization\n"; }
+         }
+         const bool pressure = memoryUsed >= pressureMemory;
+         if(pressure && !memoryPressure_ && verbosity >= 1) {
+            std::cout << "Memory budget approached: "; report(); std::cout << ", tightening restricted\n";
+         }
+         memoryPressure_ = pressure;
+         return pressure ? 0 : pressureMemory - memoryUsed;
+      }
+
       void end(const REAL lower_bound, const REAL upper_bound)
       {
          auto endTime = std::chrono::steady_clock::now();
@@ -198,6 +279,14 @@ namespace LP_MP {
          }
       }
       
+      // continue iteration counting and time measurement of an optimization resumed from a checkpoint, called after begin
+      void resume(const INDEX iteration, const double time)
+      {
+         curIter_ = iteration;
+         remainingIter_ = maxIter_ > iteration ? maxIter_ - iteration : 1;
+         beginTime_ -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time));
+      }
+
       using TimeType = decltype(std::chrono::steady_clock::now());
       TimeType GetBeginTime() const { return beginTime_; }
       //`REAL GetLowerBound() const { return curLowerBound_; }
@@ -206,9 +295,11 @@ namespace LP_MP {
       protected:
       PositiveRealConstraint posRealConstraint_;
       PositiveIntegerConstraint posIntegerConstraint_;
+      OpenUnitIntervalConstraint openUnitIntervalConstraint_;
       // command line arguments TCLAP
       TCLAP::ValueArg<INDEX> maxIterArg_;
       TCLAP::ValueArg<INDEX> maxMemoryArg_;
+      TCLAP::ValueArg<REAL> memoryPressureFractionArg_;
       TCLAP::ValueArg<INDEX> timeoutArg_;
       //TCLAP::ValueArg<INDEX> boundComputationIntervalArg_;
       TCLAP::ValueArg<INDEX> primalComputationIntervalArg_;
@@ -218,10 +309,14 @@ namespace LP_MP {
       TCLAP::ValueArg<INDEX> minDualImprovementIntervalArg_;
       TCLAP::ValueArg<std::string> standardReparametrizationArg_;
       TCLAP::ValueArg<std::string> roundingReparametrizationArg_;
+      TCLAP::SwitchArg adaptiveComputationIntervalsArg_;
+      TCLAP::ValueArg<REAL> computationTimeFractionArg_;
 
       // command line arguments read out
       INDEX maxIter_;
       INDEX maxMemory_;
+      REAL memoryPressureFraction_;
+      bool memoryPressure_ = false;
       INDEX timeout_;
       //INDEX boundComputationInterval_;
       INDEX primalComputationInterval_;
@@ -229,6 +324,8 @@ namespace LP_MP {
       INDEX lowerBoundComputationInterval_;
       REAL minDualImprovement_;
       INDEX minDualImprovementInterval_;
+      bool adaptiveComputationIntervals_;
+      REAL computationTimeFraction_;
       std::vector<REAL> lowerBound_; // do zrobienia: possibly make circular list out of this
       // do zrobienia: make enum for reparametrization mode
       LPReparametrizationMode standardReparametrization_;
@@ -249,7 +346,18 @@ namespace LP_MP {
       //REAL currentLowerBound_ = -std::numeric_limits<REAL>::infinity();
 
       //PrimalSolutionStorage currentPrimal_, bestPrimal_;
-      INDEX primalTime_;
+
+      // adaptive computation intervals: running averages of seconds per pass, lower bound and primal computation
+      REAL passTime_ = 0.0;
+      REAL lowerBoundTime_ = 0.0;
+      REAL primalTime_ = 0.0;
+      constexpr static INDEX maxAdaptiveStretch = 16;
+      INDEX lowerBoundStretch_ = 1;
+      INDEX primalStretch_ = 1;
+      INDEX nextLowerBoundIteration_ = 0;
+      INDEX nextPrimalIteration_ = 0;
+      REAL lastLowerBound_ = -std::numeric_limits<REAL>::infinity();
+      REAL lastPrimalBound_ = std::numeric_limits<REAL>::infinity();
    };
 
    //template<class SOLVER>
@@ -270,7 +378,9 @@ namespace LP_MP {
             tightenMinDualImprovementArg_("","tightenMinDualImprovement","minimum dual improvement after which to start tightening",false,std::numeric_limits<REAL>::infinity(),"positive real", cmd),
             tightenMinDualImprovementIntervalArg_("","tightenMinDualImprovementInterval","the interval between which at least minimum dual improvement may not occur for tightening",false,std::numeric_limits<INDEX>::max(), "positive integer", cmd),
             unitIntervalConstraint_(),
-            tightenSlopeArg_("","tightenSlope","when slope of dual improvement becomes ${percentage} smaller than initial dual improvement slope, tighten", false, 1.0, &unitIntervalConstraint_, cmd)
+            tightenSlopeArg_("","tightenSlope","when slope of dual improvement becomes ${percentage} smaller than initial dual improvement slope, tighten", false, 1.0, &unitIntervalConstraint_, cmd),
+            tightenAdaptiveArg_("","tightenAdaptive","adapt interval between tightenings to measured dual improvement per second before and after tightening. The interval starts at tightenInterval, default = 10",cmd,false),
+            tightenTimeFractionArg_("","tightenTimeFraction","with tightenAdaptive: maximal fraction of runtime spent in separation, bounds the time of each tightening, default = 0.2",false,0.2,&unitIntervalConstraint_,cmd)
             // do zrobienia: remove minDualIncrease and minDualDecreaseFactor
             //tightenMinDualIncreaseArg_("","tightenMinDualIncrease","obsolete: minimum increase which additional constraint must guarantee",false,0.0,&posRealConstraint_, cmd),
             //tightenMinDualDecreaseFactorArg_("","tightenMinDualDecreaseFactor","obsolete: factor by which to decrease minimum dual increase during tightening",false,0.5,&unitIntervalConstraint_, cmd)
@@ -299,12 +409,25 @@ namespace LP_MP {
             }
             tightenMinDualImprovement_ = tightenMinDualImprovementArg_.getValue();
             tightenMinDualImprovementInterval_ = tightenMinDualImprovementIntervalArg_.getValue();
+            tightenAdaptive_ = tightenAdaptiveArg_.getValue();
+            tightenTimeFraction_ = tightenTimeFractionArg_.getValue();
+            adaptiveTightenInterval_ = std::max(tightenIntervalArg_.isSet() ? tightenInterval_ : INDEX(10), adaptive_evaluation_iterations);
          } catch (TCLAP::ArgException &e) {
             std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl; 
             exit(1);
          }
 
-         return BaseVisitorType::begin(lp);
+         auto ret = BaseVisitorType::begin(lp);
+         lastVisitTime_ = this->GetBeginTime();
+         lastLowerBoundTime_ = this->GetBeginTime();
+         return ret;
+      }
+
+      // the tightening interval counts from the resumed iteration
+      void resume(const INDEX iteration, const double time)
+      {
+         BaseVisitorType::resume(iteration, time);
+         lastTightenIteration_ = iteration;
       }
 
       LpControl SetTighten(LpControl c)
@@ -312,9 +435,58 @@ namespace LP_MP {
          c.tighten = true;
          c.tightenConstraints = tightenConstraintsMax_;
          c.repam = tightenReparametrization_;
+         if(tightenAdaptive_) {
+            // separation may take at most tightenTimeFraction of the time spent since the last tightening
+            c.tightenTimeBudget = tightenTimeFraction_ / (1.0 - tightenTimeFraction_) * messagePassingTimeSinceTightening_;
+            if(verbosity >= 1) { std::cout << "time budget for separation = " << c.tightenTimeBudget << "s\n"; }
+         }
          lastTightenIteration_ = this->GetIter();
          return c;
       }
+
+      // Compare dual improvement per second before tightening with dual improvement per second after it, the latter including separation time.
+      // If tightening paid off, tighten more often, otherwise less often.
+      void UpdateAdaptiveTightening(const LpControl c, const REAL lowerBound)
+      {
+         const auto now = std::chrono::steady_clock::now();
+         const REAL iterationTime = std::chrono::duration<REAL>(now - lastVisitTime_).count();
+         lastVisitTime_ = now;
+
+         if(c.tighten) {
+            messagePassingTimeSinceTightening_ = 0.0;
+            tighteningLowerBound_ = lastLowerBound_;
+            tighteningTime_ = lastLowerBoundTime_;
+            dualRateBeforeTightening_ = dualRate_;
+            evaluateTightening_ = true;
+         } else {
+            messagePassingTimeSinceTightening_ += iterationTime;
+         }
+
+         if(!c.computeLowerBound) { return; }
+
+         const REAL timeSinceLastLowerBound = std::chrono::duration<REAL>(now - lastLowerBoundTime_).count();
+         if(!c.tighten && timeSinceLastLowerBound > 0.0 && std::isfinite(lastLowerBound_)) {
+            const REAL rate = (lowerBound - lastLowerBound_) / timeSinceLastLowerBound;
+            dualRate_ = dualRate_ > 0.0 ? 0.5*dualRate_ + 0.5*rate : rate;
+         }
+         lastLowerBound_ = lowerBound;
+         lastLowerBoundTime_ = now;
+
+         if(evaluateTightening_ && this->GetIter() >= lastTightenIteration_ + adaptive_evaluation_iterations && std::isfinite(tighteningLowerBound_)) {
+            const REAL timeSinceTightening = std::chrono::duration<REAL>(now - tighteningTime_).count();
+            const REAL dualRateAfterTightening = (lowerBound - tighteningLowerBound_) / timeSinceTightening;
+            if(dualRateAfterTightening > dualRateBeforeTightening_) {
+               adaptiveTightenInterval_ = std::max(adaptiveTightenInterval_/2, adaptive_evaluation_iterations);
+            } else {
+               adaptiveTightenInterval_ = std::min(2*adaptiveTightenInterval_, std::max(this->maxIter_, adaptive_evaluation_iterations));
+            }
+            if(verbosity >= 1) {
+               std::cout << "dual improvement per second before tightening = " << dualRateBeforeTightening_ << ", after tightening = " << dualRateAfterTightening << ", tightening interval = " << adaptiveTightenInterval_ << "\n";
+            }
+            evaluateTightening_ = false;
+         }
+      }
+
       // the default
       //template<LPVisitorReturnType LP_STATE>
       LpControl visit(const LpControl c, const REAL lowerBound, const REAL primalBound)
@@ -322,13 +494,17 @@ namespace LP_MP {
          auto ret = BaseVisitorType::visit(c, lowerBound, primalBound);
 
          if(tighten_) {
+            if(tightenAdaptive_) {
+               UpdateAdaptiveTightening(c, lowerBound);
+            }
+            const INDEX tightenInterval = tightenAdaptive_ ? adaptiveTightenInterval_ : tightenInterval_;
             iteration_after_tightening_++;
             const REAL cur_slope = std::max(lowerBound - prev_lower_bound_,REAL(0.0));
             if(iteration_after_tightening_ == 2) {
                tighten_slope_ = cur_slope;
             }
             if((this->GetIter() >= tightenIteration_ && 
-                     (this->GetIter() >= lastTightenIteration_ + tightenInterval_ || 
+                     (this->GetIter() >= lastTightenIteration_ + tightenInterval || 
                       (tightenSlopeArg_.isSet() && cur_slope < tightenSlopeArg_.getValue()*tighten_slope_)))) {
                if(verbosity >= 1) { std::cout << "Time to tighten\n"; }
                ret = SetTighten(ret);
@@ -383,6 +559,22 @@ namespace LP_MP {
       REAL tighten_slope_ = -std::numeric_limits<REAL>::infinity(); 
       INDEX iteration_after_tightening_ = 2; // this way tighten_slope will not be recomputed
 
+      TCLAP::SwitchArg tightenAdaptiveArg_;
+      TCLAP::ValueArg<REAL> tightenTimeFractionArg_;
+      bool tightenAdaptive_;
+      REAL tightenTimeFraction_;
+      constexpr static INDEX adaptive_evaluation_iterations = 5; // iterations after tightening after which its effect on the dual improvement is measured
+      INDEX adaptiveTightenInterval_;
+      TimeType lastVisitTime_;
+      TimeType lastLowerBoundTime_;
+      TimeType tighteningTime_;
+      REAL messagePassingTimeSinceTightening_ = 0.0;
+      REAL lastLowerBound_ = -std::numeric_limits<REAL>::infinity();
+      REAL tighteningLowerBound_ = -std::numeric_limits<REAL>::infinity();
+      REAL dualRate_ = 0.0; // running average of dual improvement per second
+      REAL dualRateBeforeTightening_ = 0.0;
+      bool evaluateTightening_ = false;
+
       bool tighten_;
       LPReparametrizationMode tightenReparametrization_;
       bool tightenInNextIteration_ = false;
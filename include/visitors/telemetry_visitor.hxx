@@ -0,0 +1,73 @@
+#ifndef LP_MP_TELEMETRY_VISITOR_HXX
+#define LP_MP_TELEMETRY_VISITOR_HXX
+
+#include "standard_visitor.hxx"
+#include "telemetry.hxx"
+#include <memory>
+#include <iostream>
+
+namespace LP_MP {
+
+// records per-iteration statistics into a telemetry file, see telemetry.hxx. Without --telemetryFile nothing is recorded.
+// Convert the output with telemetry_convert to csv or pgfplots coordinates.
+template<class BASE_VISITOR = StandardVisitor>
+class TelemetryVisitor : public BASE_VISITOR {
+   using BaseVisitor = BASE_VISITOR;
+public:
+   TelemetryVisitor(TCLAP::CmdLine& cmd)
+      : BaseVisitor(cmd),
+      telemetryFileArg_("","telemetryFile","file into which to record per-iteration statistics. Written as JSON lines for .jsonl files, in binary otherwise",false,"","file name",cmd),
+      telemetryBufferSizeArg_("","telemetryBufferSize","number of records buffered before records are dropped, default = 65536",false,1 << 16,&positiveIntegerConstraint,cmd)
+   {}
+
+   template<typename LP_TYPE>
+   LpControl begin(LP_TYPE& lp)
+   {
+      auto ret = BaseVisitor::begin(lp);
+      if(telemetryFileArg_.isSet()) {
+         writer_ = std::make_unique<telemetry::writer>(telemetryFileArg_.getValue(), telemetryBufferSizeArg_.getValue());
+      }
+      lastVisit_ = this->GetBeginTime();
+      return ret;
+   }
+
+   LpControl visit(const LpControl c, const REAL lowerBound, const REAL upperBound)
+   {
+      if(writer_) {
+         const auto now = std::chrono::steady_clock::now();
+         telemetry::record r;
+         r.iteration = this->GetIter();
+         r.time = std::chrono::duration<double>(now - this->GetBeginTime()).count();
+         r.lower_bound = lowerBound;
+         r.upper_bound = upperBound;
+         r.phase_time[0] = std::chrono::duration<double>(now - lastVisit_).count();
+         std::copy(c.phaseTime.begin(), c.phaseTime.end(), r.phase_time.begin() + 1);
+         writer_->push(r);
+         lastVisit_ = now;
+      }
+      return BaseVisitor::visit(c, lowerBound, upperBound);
+   }
+
+   void end(const REAL lowerBound, const REAL upperBound)
+   {
+      BaseVisitor::end(lowerBound, upperBound);
+      if(writer_) {
+         writer_->close();
+         if(writer_->dropped() > 0) {
+            std::cout << "telemetry: " << writer_->dropped() << " records dropped, increase telemetryBufferSize\n";
+         }
+         writer_.reset();
+      }
+   }
+
+private:
+   TCLAP::ValueArg<std::string> telemetryFileArg_;
+   TCLAP::ValueArg<INDEX> telemetryBufferSizeArg_;
+
+   std::unique_ptr<telemetry::writer> writer_;
+   typename BaseVisitor::TimeType lastVisit_;
+};
+
+} // namespace LP_MP
+
+#endif // LP_MP_TELEMETRY_VISITOR_HXX
@@ -0,0 +1,54 @@
+#include "test.h"
+#include "test_model.hxx"
+#include "LP_proximal_bundle.hxx"
+#include <random>
+
+using namespace LP_MP;
+
+// proximal bundle and subgradient ascent on the same decomposition must reach the same dual bound
+int main()
+{
+  TCLAP::CmdLine cmd_bundle("proximal bundle");
+  LP_proximal_bundle<test_FMC> bundle(cmd_bundle);
+  std::vector<std::string> args = {"proximal bundle"};
+  cmd_bundle.parse(args);
+  build_test_model(bundle);
+
+  TCLAP::CmdLine cmd_sg("subgradient ascent");
+  LP_subgradient_ascent<test_FMC> sg(cmd_sg);
+  build_test_model(sg);
+
+  // the decomposition is constructed in the first iteration
+  bundle.ComputePass(0);
+  const INDEX n = bundle.no_Lagrangean_vars();
+  test(n > 0);
+
+  // the oracle yields a supergradient of the concave dual: f(y) <= f(x) + <g, y-x>.
+  // Lagrangean variables are removed again after each call, hence repeated calls agree.
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(-1.0, 1.0);
+  std::vector<REAL> x(n), y(n), g(n), g_y(n);
+  for(INDEX k=0; k<20; ++k) {
+    for(INDEX i=0; i<n; ++i) {
+      x[i] = dist(gen);
+      y[i] = dist(gen);
+    }
+    const REAL f_x = bundle(x, g);
+    const REAL f_y = bundle(y, g_y);
+    REAL bound = f_x;
+    for(INDEX i=0; i<n; ++i) {
+      bound += g[i]*(y[i] - x[i]);
+    }
+    test(f_y <= bound + eps);
+    test(std::abs(bundle(x, g_y) - f_x) <= eps);
+  }
+
+  for(INDEX iter=0; iter<200; ++iter) {
+    sg.ComputePass(iter);
+  }
+  for(INDEX iter=1; iter<50; ++iter) {
+    bundle.ComputePass(iter);
+  }
+  test(bundle.decomposition_lower_bound() <= 1.0 + eps);
+  test(std::abs(bundle.decomposition_lower_bound() - sg.LowerBound()) <= 1e-4);
+}
@@ -0,0 +1,200 @@
+#include "test.h"
+#include "config.hxx"
+#include "factors_messages.hxx"
+#include "branch_and_bound.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include <array>
+
+using namespace LP_MP;
+
+// binary variable
+struct bb_unary {
+  bb_unary(const REAL c0, const REAL c1) : cost(2)
+  {
+    cost[0] = c0;
+    cost[1] = c1;
+  }
+
+  REAL LowerBound() const { return std::min(cost[0], cost[1]); }
+  REAL EvaluatePrimal() const { return primal < 2 ? cost[primal] : std::numeric_limits<REAL>::infinity(); }
+  void init_primal() { primal = std::numeric_limits<INDEX>::max(); }
+  void MaximizePotentialAndComputePrimal()
+  {
+    if(primal >= 2) {
+      primal = cost[0] <= cost[1] ? 0 : 1;
+    }
+  }
+
+  bool can_branch() const { return primal < 2; }
+  void branch_left(const REAL penalty) { cost[1-primal] += penalty; }
+  void branch_right(const REAL penalty) { cost[primal] += penalty; }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar(primal); }
+
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER> void construct_constraints(SOLVER& s, typename SOLVER::vector v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER> void convert_primal(SOLVER& s, typename SOLVER::vector v) { primal = s.solution(v[0]) ? 0 : 1; }
+
+  vector<REAL> cost;
+  INDEX primal;
+};
+
+// pair of binary variables, labeling (x0,x1) is indexed by 2*x0+x1. Branching is done on variables only.
+struct bb_pairwise {
+  bb_pairwise(const REAL c00, const REAL c01, const REAL c10, const REAL c11) : cost(4)
+  {
+    cost[0] = c00;
+    cost[1] = c01;
+    cost[2] = c10;
+    cost[3] = c11;
+  }
+
+  REAL LowerBound() const { return *std::min_element(cost.begin(), cost.end()); }
+  REAL EvaluatePrimal() const { return primal[0] < 2 && primal[1] < 2 ? cost[2*primal[0] + primal[1]] : std::numeric_limits<REAL>::infinity(); }
+  void init_primal() { primal.fill(std::numeric_limits<INDEX>::max()); }
+  void MaximizePotentialAndComputePrimal()
+  {
+    INDEX best = 4;
+    for(INDEX i=0; i<4; ++i) {
+      if((primal[0] >= 2 || primal[0] == i/2) && (primal[1] >= 2 || primal[1] == i%2) && (best == 4 || cost[i] < cost[best])) {
+        best = i;
+      }
+    }
+    primal = {best/2, best%2};
+  }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar( binary_data<INDEX>(primal.data(), primal.size()) ); }
+
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER> void construct_constraints(SOLVER& s, typename SOLVER::vector v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER> void convert_primal(SOLVER& s, typename SOLVER::vector v)
+  {
+    for(INDEX i=0; i<4; ++i) {
+      if(s.solution(v[i])) {
+        primal = {i/2, i%2};
+      }
+    }
+  }
+
+  vector<REAL> cost;
+  std::array<INDEX,2> primal;
+};
+
+// marginalization of pairwise factor onto its VAR-th variable
+template<INDEX VAR>
+struct bb_message {
+  static INDEX index(const INDEX x, const INDEX y) { return VAR == 0 ? 2*x + y : 2*y + x; }
+
+  template<typename LEFT_FACTOR> void RepamLeft(LEFT_FACTOR& l, const REAL msg, const INDEX dim) { l.cost[dim] += msg; }
+  template<typename RIGHT_FACTOR> void RepamRight(RIGHT_FACTOR& r, const REAL msg, const INDEX dim)
+  {
+    r.cost[index(dim,0)] += msg;
+    r.cost[index(dim,1)] += msg;
+  }
+
+  template<typename RIGHT_FACTOR, typename MSG>
+  void send_message_to_left(const RIGHT_FACTOR& r, MSG& msg, const REAL omega)
+  {
+    for(INDEX x=0; x<2; ++x) {
+      msg[x] -= omega*std::min(r.cost[index(x,0)], r.cost[index(x,1)]);
+    }
+  }
+
+  // normalized, such that the lower bound of the sending factor does not change
+  template<typename LEFT_FACTOR, typename MSG>
+  void send_message_to_right(const LEFT_FACTOR& l, MSG& msg, const REAL omega)
+  {
+    const REAL m = l.LowerBound();
+    for(INDEX x=0; x<2; ++x) {
+      msg[x] -= omega*(l.cost[x] - m);
+    }
+  }
+
+  // for rounding: condition on the other variable if it is already labeled
+  template<typename RIGHT_FACTOR, typename MSG>
+  void ReceiveRestrictedMessageFromRight(const RIGHT_FACTOR& r, MSG& msg)
+  {
+    const INDEX other = r.primal[1-VAR];
+    for(INDEX x=0; x<2; ++x) {
+      msg[x] -= other < 2 ? r.cost[index(x,other)] : std::min(r.cost[index(x,0)], r.cost[index(x,1)]);
+    }
+  }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void ComputeRightFromLeftPrimal(const LEFT_FACTOR& l, RIGHT_FACTOR& r) { r.primal[VAR] = l.primal; }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  bool CheckPrimalConsistency(const LEFT_FACTOR& l, const RIGHT_FACTOR& r) const { return l.primal == r.primal[VAR]; }
+
+  template<typename SOLVER, typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void construct_constraints(SOLVER& s, LEFT_FACTOR& l, typename SOLVER::vector v_left, RIGHT_FACTOR& r, typename SOLVER::vector v_right)
+  {
+    for(INDEX x=0; x<2; ++x) {
+      std::array<typename SOLVER::variable, 2> v = {v_right[index(x,0)], v_right[index(x,1)]};
+      s.make_equal(v_left[x], s.add_at_most_one_constraint(v.begin(), v.end()));
+    }
+  }
+};
+
+struct bb_FMC {
+  constexpr static const char* name = "branch and bound test model";
+  using unary = FactorContainer<bb_unary, bb_FMC, 0, true>;
+  using pairwise = FactorContainer<bb_pairwise, bb_FMC, 1, true>;
+  using message_0 = MessageContainer<bb_message<0>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, bb_FMC, 0>;
+  using message_1 = MessageContainer<bb_message<1>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, bb_FMC, 1>;
+  using FactorList = meta::list<unary, pairwise>;
+  using MessageList = meta::list<message_0, message_1>;
+  using ProblemDecompositionList = meta::list<>;
+};
+
+// frustrated triangle: neighboring variables prefer different labels, which is possible for two of the three pairs only.
+// The relaxation has value 0.3 (all variables 1/2), the optimum 1.1 is attained by labeling (1,0,0).
+template<typename LP_TYPE>
+void build_triangle(LP_TYPE& lp)
+{
+  std::array<typename bb_FMC::unary*, 3> u;
+  for(INDEX i=0; i<3; ++i) {
+    u[i] = lp.template add_factor<typename bb_FMC::unary>(0.0, 0.1*(i+1));
+  }
+  for(INDEX i=0; i<3; ++i) {
+    for(INDEX j=i+1; j<3; ++j) {
+      auto* p = lp.template add_factor<typename bb_FMC::pairwise>(1.0, 0.0, 0.0, 1.0);
+      lp.template add_message<typename bb_FMC::message_0>(u[i], p);
+      lp.template add_message<typename bb_FMC::message_1>(u[j], p);
+    }
+  }
+}
+
+int main()
+{
+  for(const std::string node_selection : {"best-first", "depth-first"}) {
+    std::vector<std::string> options = {"", "--maxIter", "20", "-v", "0", "--bbNodeSelection", node_selection};
+    Solver<branch_and_bound<LP<bb_FMC>>, StandardVisitor> s(options);
+    build_triangle(s.GetLP());
+    s.Solve();
+
+    const auto& lp = s.GetLP();
+    test(lp.branch_and_bound_nodes() > 1);
+    test(std::isfinite(lp.branch_and_bound_lower_bound()));
+    test(std::abs(lp.branch_and_bound_upper_bound() - 1.1) <= eps);
+    test(lp.branch_and_bound_lower_bound() >= lp.branch_and_bound_upper_bound() - eps);
+  }
+
+  // the upper bound is the cost of the reported primal w.r.t. the original costs, also when the search stops early within penalized nodes
+  for(INDEX max_nodes=1; max_nodes<=8; ++max_nodes) {
+    std::vector<std::string> options = {"", "--maxIter", "20", "-v", "0", "--bbNodeSelection", "depth-first", "--bbMaxNodes", std::to_string(max_nodes)};
+    Solver<branch_and_bound<LP<bb_FMC>>, StandardVisitor> s(options);
+    build_triangle(s.GetLP());
+    s.Solve();
+
+    auto& lp = s.GetLP();
+    const REAL upper_bound = lp.branch_and_bound_upper_bound();
+    test(upper_bound >= 1.1 - eps);
+    if(std::isfinite(upper_bound)) {
+      test(std::abs(lp.EvaluatePrimal() - upper_bound) <= eps);
+    }
+  }
+}
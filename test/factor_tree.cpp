@@ -0,0 +1,108 @@
+#include "test.h"
+#include "test_model.hxx"
+#include "tree_decomposition.hxx"
+
+using namespace LP_MP;
+
+// solve a small tree with dynamic programming, messages added in arbitrary order
+int main()
+{
+  TCLAP::CmdLine cmd("factor tree test");
+  LP<test_FMC> lp(cmd);
+
+  // tree f1 - f2 - f3 with additional leaf f4 attached to f2. All factors must take equal labels.
+  auto* f1 = lp.add_factor<typename test_FMC::factor>(0.0, 1.0);
+  auto* f2 = lp.add_factor<typename test_FMC::factor>(1.0, 0.0);
+  auto* f3 = lp.add_factor<typename test_FMC::factor>(0.0, 0.0);
+  auto* f4 = lp.add_factor<typename test_FMC::factor>(0.0, 2.0);
+
+  auto* m12 = lp.add_message<typename test_FMC::message>(f1,f2);
+  auto* m23 = lp.add_message<typename test_FMC::message>(f2,f3);
+  auto* m24 = lp.add_message<typename test_FMC::message>(f2,f4);
+
+  // root is f3
+  factor_tree<test_FMC> t;
+  t.add_message(*m23, Chirality::right);
+  t.add_message(*m12, Chirality::right);
+  t.add_message(*m24, Chirality::left);
+  t.init();
+
+  test(t.tree_valid());
+  test(t.factors_.size() == 4);
+
+  // label 0: 0+1+0+0 = 1, label 1: 1+0+0+2 = 3
+  const REAL value = t.solve();
+  test(std::abs(value - 1.0) <= eps);
+  test(std::abs(t.lower_bound() - 1.0) <= eps);
+  test(t.primal_consistent());
+
+  // reparametrization leaves the tree optimum unchanged, hence solving again gives the same result
+  test(std::abs(t.solve() - 1.0) <= eps);
+
+  // a message not connected to the tree yields no valid tree
+  auto* f5 = lp.add_factor<typename test_FMC::factor>(0.0, 0.0);
+  auto* f6 = lp.add_factor<typename test_FMC::factor>(0.0, 0.0);
+  auto* m56 = lp.add_message<typename test_FMC::message>(f5,f6);
+  factor_tree<test_FMC> t_invalid(t);
+  t_invalid.add_message(*m56, Chirality::left);
+  bool thrown = false;
+  try {
+    t_invalid.init();
+  } catch(const std::runtime_error&) {
+    thrown = true;
+  }
+  test(thrown);
+
+  // forest cover of a 4x4 grid: every edge is covered exactly once and trees are acyclic with edges sorted from leaves to root
+  {
+    const INDEX n = 4;
+    std::vector<std::array<INDEX,2>> edges;
+    for(INDEX x=0; x<n; ++x) {
+      for(INDEX y=0; y<n; ++y) {
+        if(x+1 < n) { edges.push_back({x*n+y, (x+1)*n+y}); }
+        if(y+1 < n) { edges.push_back({x*n+y, x*n+y+1}); }
+      }
+    }
+    const auto trees = greedy_forest_cover(n*n, edges);
+    std::vector<INDEX> covered(edges.size(), 0);
+    for(const auto& tree : trees) {
+      test(tree.size() > 0);
+      UnionFind uf(n*n);
+      std::vector<char> sent(n*n, false);
+      for(const auto& e : tree) {
+        covered[e.edge]++;
+        test((e.lower == edges[e.edge][0] && e.upper == edges[e.edge][1]) || (e.lower == edges[e.edge][1] && e.upper == edges[e.edge][0]));
+        test(!uf.connected(e.lower, e.upper));
+        uf.merge(e.lower, e.upper);
+        test(!sent[e.lower] && !sent[e.upper]);
+        sent[e.lower] = true;
+      }
+    }
+    test(std::all_of(covered.begin(), covered.end(), [](const INDEX c) { return c == 1; }));
+    // the first spanning tree covers 15 of the 24 edges, the remaining ones form paths
+    test(trees[0].size() == n*n-1);
+  }
+
+  // forest cover with isolated factors: each forms a single-factor tree
+  {
+    TCLAP::CmdLine cmd_sg("subgradient test");
+    LP_subgradient_ascent<test_FMC> lp_sg(cmd_sg);
+    auto* g1 = lp_sg.add_factor<typename test_FMC::factor>(0.0, 1.0);
+    auto* g2 = lp_sg.add_factor<typename test_FMC::factor>(1.0, 0.0);
+    auto* g3 = lp_sg.add_factor<typename test_FMC::factor>(0.0, 0.0);
+    lp_sg.add_factor<typename test_FMC::factor>(3.0, 2.0);
+    lp_sg.add_factor<typename test_FMC::factor>(1.0, 4.0);
+    lp_sg.add_message<typename test_FMC::message>(g1,g2);
+    lp_sg.add_message<typename test_FMC::message>(g2,g3);
+    lp_sg.add_message<typename test_FMC::message>(g3,g1);
+
+    // the forest cover is computed and the decomposition constructed in the first iteration.
+    // Isolated factors contribute 2+1, the decomposed cycle g1 - g2 - g3 initially 0.5 and 1 at the optimum.
+    lp_sg.ComputePass(0);
+    test(std::abs(lp_sg.decomposition_lower_bound() - 3.5) <= eps);
+    for(INDEX iter=1; iter<100; ++iter) {
+      lp_sg.ComputePass(iter);
+    }
+    test(lp_sg.decomposition_lower_bound() > 3.9 && lp_sg.decomposition_lower_bound() <= 4.0 + eps);
+  }
+}
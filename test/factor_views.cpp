@@ -0,0 +1,78 @@
+#include "test.h"
+#include "test_model.hxx"
+#include "tree_decomposition.hxx"
+#include <algorithm>
+
+using namespace LP_MP;
+
+// exposes the trees of the decomposition
+class subgradient_ascent_trees : public LP_subgradient_ascent<test_FMC> {
+public:
+  using LP_subgradient_ascent<test_FMC>::LP_subgradient_ascent;
+  using LP_subgradient_ascent<test_FMC>::trees_;
+};
+
+struct tree_result {
+  REAL value, primal_cost, lower_bound;
+  std::vector<double> subgradient; // sorted, since the order of Lagrangean variables within a tree depends on factor addresses
+};
+
+tree_result solve_tree(LP_tree_Lagrangean<test_FMC, Lagrangean_factor_quadratic>& t)
+{
+  tree_result r;
+  r.value = t.solve();
+  r.primal_cost = t.primal_cost();
+  r.lower_bound = t.lower_bound();
+  r.subgradient.resize(t.mapping().size());
+  t.compute_local_subgradient(r.subgradient.data());
+  std::sort(r.subgradient.begin(), r.subgradient.end());
+  return r;
+}
+
+bool equal(const tree_result& a, const tree_result& b)
+{
+  return std::abs(a.value - b.value) <= eps && std::abs(a.primal_cost - b.primal_cost) <= eps && std::abs(a.lower_bound - b.lower_bound) <= eps
+    && a.subgradient == b.subgradient;
+}
+
+// solving trees with factor views must give the same values and subgradients as solving trees holding factor copies
+int main()
+{
+  TCLAP::CmdLine cmd_copies("factor copies");
+  subgradient_ascent_trees copies(cmd_copies);
+  std::vector<std::string> args_copies = {"factor copies"};
+  cmd_copies.parse(args_copies);
+
+  TCLAP::CmdLine cmd_views("factor views");
+  subgradient_ascent_trees views(cmd_views);
+  std::vector<std::string> args_views = {"factor views", "--factorViews"};
+  cmd_views.parse(args_views);
+
+  build_test_model(copies);
+  build_test_model(views);
+
+  // the decomposition is constructed in the first iteration, subsequent ones change Lagrangean variables
+  for(INDEX iter=0; iter<5; ++iter) {
+    copies.ComputePass(iter);
+    views.ComputePass(iter);
+    test(std::abs(copies.decomposition_lower_bound() - views.decomposition_lower_bound()) <= eps);
+  }
+
+  test(copies.trees_.size() == views.trees_.size());
+  for(INDEX i=0; i<views.trees_.size(); ++i) {
+    test(views.trees_[i].factor_views() && !copies.trees_[i].factor_views());
+    const auto r_copies = solve_tree(copies.trees_[i]);
+    const auto r_views = solve_tree(views.trees_[i]);
+    test(equal(r_copies, r_views));
+    // factors not shared with other trees must not keep the reparametrization of a previous solve
+    test(equal(r_views, solve_tree(views.trees_[i])));
+    test(equal(r_copies, solve_tree(copies.trees_[i])));
+  }
+
+  for(INDEX iter=5; iter<50; ++iter) {
+    copies.ComputePass(iter);
+    views.ComputePass(iter);
+    test(std::abs(copies.decomposition_lower_bound() - views.decomposition_lower_bound()) <= eps);
+  }
+  test(std::abs(views.decomposition_lower_bound() - 1.0) <= 1e-6);
+}
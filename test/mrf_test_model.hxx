@@ -0,0 +1,334 @@
+#ifndef LP_MP_MRF_TEST_MODEL_HXX
+#define LP_MP_MRF_TEST_MODEL_HXX
+
+#include <array>
+#include "config.hxx"
+#include "vector.hxx"
+#include "factors_messages.hxx"
+#include "problem_constructors/mrf_problem_construction.hxx"
+
+namespace LP_MP {
+
+// minimal factors and messages for pairwise graphical models with tightening triplets
+
+struct mrf_unary {
+  mrf_unary(const INDEX n) : cost(n) { std::fill(cost.begin(), cost.end(), 0.0); }
+
+  REAL& operator[](const INDEX x) { return cost[x]; }
+  REAL operator[](const INDEX x) const { return cost[x]; }
+  INDEX size() const { return cost.size(); }
+
+  REAL LowerBound() const { return *std::min_element(cost.begin(), cost.end()); }
+  REAL EvaluatePrimal() const { return primal_ < size() ? cost[primal_] : std::numeric_limits<REAL>::infinity(); }
+  void init_primal() { primal_ = std::numeric_limits<INDEX>::max(); }
+  void MaximizePotentialAndComputePrimal()
+  {
+    if(primal_ >= size()) {
+      primal_ = std::min_element(cost.begin(), cost.end()) - cost.begin();
+    }
+  }
+  INDEX primal() const { return primal_; }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar(primal_); }
+
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER> void construct_constraints(SOLVER& s, typename SOLVER::vector v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER> void convert_primal(SOLVER& s, typename SOLVER::vector v)
+  {
+    for(INDEX x=0; x<size(); ++x) {
+      if(s.solution(v[x])) { primal_ = x; }
+    }
+  }
+
+  vector<REAL> cost;
+  INDEX primal_;
+};
+
+struct mrf_pairwise {
+  template<typename COST>
+  mrf_pairwise(const INDEX dim1, const INDEX dim2, const COST& c) : cost(dim1, dim2)
+  {
+    for(INDEX x1=0; x1<dim1; ++x1) {
+      for(INDEX x2=0; x2<dim2; ++x2) {
+        cost(x1,x2) = c(x1,x2);
+      }
+    }
+  }
+
+  REAL operator()(const INDEX x1, const INDEX x2) const { return cost(x1,x2); }
+  INDEX dim1() const { return cost.dim1(); }
+  INDEX dim2() const { return cost.dim2(); }
+  INDEX size() const { return dim1()*dim2(); }
+
+  REAL LowerBound() const
+  {
+    REAL lb = std::numeric_limits<REAL>::infinity();
+    for(INDEX x1=0; x1<dim1(); ++x1) {
+      for(INDEX x2=0; x2<dim2(); ++x2) {
+        lb = std::min(lb, cost(x1,x2));
+      }
+    }
+    return lb;
+  }
+  REAL EvaluatePrimal() const { return primal_[0] < dim1() && primal_[1] < dim2() ? cost(primal_[0], primal_[1]) : std::numeric_limits<REAL>::infinity(); }
+  void init_primal() { primal_.fill(std::numeric_limits<INDEX>::max()); }
+  // labels already set by adjacent unaries are kept
+  void MaximizePotentialAndComputePrimal()
+  {
+    std::array<INDEX,2> best = primal_;
+    REAL best_cost = std::numeric_limits<REAL>::infinity();
+    for(INDEX x1=0; x1<dim1(); ++x1) {
+      for(INDEX x2=0; x2<dim2(); ++x2) {
+        if((primal_[0] >= dim1() || primal_[0] == x1) && (primal_[1] >= dim2() || primal_[1] == x2) && cost(x1,x2) < best_cost) {
+          best = {x1,x2};
+          best_cost = cost(x1,x2);
+        }
+      }
+    }
+    primal_ = best;
+  }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar( binary_data<INDEX>(primal_.data(), primal_.size()) ); }
+
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER> void construct_constraints(SOLVER& s, typename SOLVER::matrix v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER> void convert_primal(SOLVER& s, typename SOLVER::matrix v)
+  {
+    for(INDEX x1=0; x1<dim1(); ++x1) {
+      for(INDEX x2=0; x2<dim2(); ++x2) {
+        if(s.solution(v(x1,x2))) { primal_ = {x1,x2}; }
+      }
+    }
+  }
+
+  matrix<REAL> cost;
+  std::array<INDEX,2> primal_;
+};
+
+struct mrf_triplet {
+  mrf_triplet(const INDEX dim1, const INDEX dim2, const INDEX dim3) : cost(dim1, dim2, dim3, 0.0) {}
+
+  REAL operator()(const INDEX x1, const INDEX x2, const INDEX x3) const { return cost(x1,x2,x3); }
+  INDEX dim1() const { return cost.dim1(); }
+  INDEX dim2() const { return cost.dim2(); }
+  INDEX dim3() const { return cost.dim3(); }
+
+  REAL LowerBound() const { return *std::min_element(cost.begin(), cost.end()); }
+  REAL EvaluatePrimal() const
+  {
+    if(primal_[0] >= dim1() || primal_[1] >= dim2() || primal_[2] >= dim3()) { return std::numeric_limits<REAL>::infinity(); }
+    return cost(primal_[0], primal_[1], primal_[2]);
+  }
+  void init_primal() { primal_.fill(std::numeric_limits<INDEX>::max()); }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar( binary_data<INDEX>(primal_.data(), primal_.size()) ); }
+
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER> void construct_constraints(SOLVER& s, typename SOLVER::tensor v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER> void convert_primal(SOLVER& s, typename SOLVER::tensor v)
+  {
+    for(INDEX x1=0; x1<dim1(); ++x1) {
+      for(INDEX x2=0; x2<dim2(); ++x2) {
+        for(INDEX x3=0; x3<dim3(); ++x3) {
+          if(s.solution(v(x1,x2,x3))) { primal_ = {x1,x2,x3}; }
+        }
+      }
+    }
+  }
+
+  tensor3<REAL> cost;
+  std::array<INDEX,3> primal_;
+};
+
+// marginalization of a pairwise factor onto its VAR-th variable
+template<INDEX VAR>
+struct mrf_unary_pairwise_message {
+  mrf_unary_pairwise_message(const INDEX, const INDEX) {}
+
+  template<typename LEFT_FACTOR> void RepamLeft(LEFT_FACTOR& l, const REAL msg, const INDEX dim) { l[dim] += msg; }
+  template<typename RIGHT_FACTOR> void RepamRight(RIGHT_FACTOR& r, const REAL msg, const INDEX dim)
+  {
+    const INDEX other_dim = VAR == 0 ? r.dim2() : r.dim1();
+    for(INDEX x=0; x<other_dim; ++x) {
+      (VAR == 0 ? r.cost(dim,x) : r.cost(x,dim)) += msg;
+    }
+  }
+
+  template<typename RIGHT_FACTOR, typename MSG>
+  void send_message_to_left(const RIGHT_FACTOR& r, MSG& msg, const REAL omega)
+  {
+    const INDEX dim = VAR == 0 ? r.dim1() : r.dim2();
+    const INDEX other_dim = VAR == 0 ? r.dim2() : r.dim1();
+    for(INDEX x=0; x<dim; ++x) {
+      REAL m = std::numeric_limits<REAL>::infinity();
+      for(INDEX y=0; y<other_dim; ++y) {
+        m = std::min(m, VAR == 0 ? r(x,y) : r(y,x));
+      }
+      msg[x] -= omega*m;
+    }
+  }
+
+  // normalized, such that the lower bound of the sending factor does not change
+  template<typename LEFT_FACTOR, typename MSG>
+  void send_message_to_right(const LEFT_FACTOR& l, MSG& msg, const REAL omega)
+  {
+    const REAL lb = l.LowerBound();
+    for(INDEX x=0; x<l.size(); ++x) {
+      msg[x] -= omega*(l[x] - lb);
+    }
+  }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void ComputeRightFromLeftPrimal(const LEFT_FACTOR& l, RIGHT_FACTOR& r) { r.primal_[VAR] = l.primal_; }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void ComputeLeftFromRightPrimal(LEFT_FACTOR& l, const RIGHT_FACTOR& r) { l.primal_ = r.primal_[VAR]; }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  bool CheckPrimalConsistency(const LEFT_FACTOR& l, const RIGHT_FACTOR& r) const { return l.primal_ == r.primal_[VAR]; }
+
+  template<typename SOLVER, typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void construct_constraints(SOLVER& s, LEFT_FACTOR& l, typename SOLVER::vector v_left, RIGHT_FACTOR& r, typename SOLVER::matrix v_right)
+  {
+    const INDEX other_dim = VAR == 0 ? r.dim2() : r.dim1();
+    for(INDEX x=0; x<l.size(); ++x) {
+      std::vector<typename SOLVER::variable> v;
+      for(INDEX y=0; y<other_dim; ++y) {
+        v.push_back(VAR == 0 ? v_right(x,y) : v_right(y,x));
+      }
+      s.make_equal(v_left[x], s.add_at_most_one_constraint(v.begin(), v.end()));
+    }
+  }
+};
+
+// marginalization of a triplet factor onto its variables I and J
+template<INDEX I, INDEX J>
+struct mrf_pairwise_triplet_message {
+  static_assert(I < J && J < 3);
+  static constexpr INDEX K = 3 - I - J;
+
+  mrf_pairwise_triplet_message(const INDEX dim1, const INDEX dim2, const INDEX dim3) : dim_({dim1, dim2, dim3}) {}
+
+  template<typename TRIPLET>
+  static REAL& entry(TRIPLET& t, const INDEX xi, const INDEX xj, const INDEX xk)
+  {
+    std::array<INDEX,3> x;
+    x[I] = xi;
+    x[J] = xj;
+    x[K] = xk;
+    return t.cost(x[0], x[1], x[2]);
+  }
+  template<typename TRIPLET>
+  static REAL entry(const TRIPLET& t, const INDEX xi, const INDEX xj, const INDEX xk)
+  {
+    std::array<INDEX,3> x;
+    x[I] = xi;
+    x[J] = xj;
+    x[K] = xk;
+    return t(x[0], x[1], x[2]);
+  }
+
+  template<typename LEFT_FACTOR> void RepamLeft(LEFT_FACTOR& l, const REAL msg, const INDEX dim) { l.cost(dim / dim_[J], dim % dim_[J]) += msg; }
+  template<typename RIGHT_FACTOR> void RepamRight(RIGHT_FACTOR& r, const REAL msg, const INDEX dim)
+  {
+    for(INDEX xk=0; xk<dim_[K]; ++xk) {
+      entry(r, dim / dim_[J], dim % dim_[J], xk) += msg;
+    }
+  }
+
+  template<typename RIGHT_FACTOR, typename MSG>
+  void send_message_to_left(const RIGHT_FACTOR& r, MSG& msg, const REAL omega)
+  {
+    for(INDEX xi=0; xi<dim_[I]; ++xi) {
+      for(INDEX xj=0; xj<dim_[J]; ++xj) {
+        REAL m = std::numeric_limits<REAL>::infinity();
+        for(INDEX xk=0; xk<dim_[K]; ++xk) {
+          m = std::min(m, entry(r, xi, xj, xk));
+        }
+        msg[xi*dim_[J] + xj] -= omega*m;
+      }
+    }
+  }
+
+  template<typename LEFT_FACTOR, typename MSG>
+  void send_message_to_right(const LEFT_FACTOR& l, MSG& msg, const REAL omega)
+  {
+    const REAL lb = l.LowerBound();
+    for(INDEX xi=0; xi<dim_[I]; ++xi) {
+      for(INDEX xj=0; xj<dim_[J]; ++xj) {
+        msg[xi*dim_[J] + xj] -= omega*(l(xi,xj) - lb);
+      }
+    }
+  }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void ComputeRightFromLeftPrimal(const LEFT_FACTOR& l, RIGHT_FACTOR& r)
+  {
+    r.primal_[I] = l.primal_[0];
+    r.primal_[J] = l.primal_[1];
+  }
+
+  template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  bool CheckPrimalConsistency(const LEFT_FACTOR& l, const RIGHT_FACTOR& r) const { return l.primal_[0] == r.primal_[I] && l.primal_[1] == r.primal_[J]; }
+
+  template<typename SOLVER, typename LEFT_FACTOR, typename RIGHT_FACTOR>
+  void construct_constraints(SOLVER& s, LEFT_FACTOR& l, typename SOLVER::matrix v_left, RIGHT_FACTOR& r, typename SOLVER::tensor v_right)
+  {
+    for(INDEX xi=0; xi<dim_[I]; ++xi) {
+      for(INDEX xj=0; xj<dim_[J]; ++xj) {
+        std::vector<typename SOLVER::variable> v;
+        for(INDEX xk=0; xk<dim_[K]; ++xk) {
+          std::array<INDEX,3> x;
+          x[I] = xi;
+          x[J] = xj;
+          x[K] = xk;
+          v.push_back(v_right(x[0], x[1], x[2]));
+        }
+        s.make_equal(v_left(xi,xj), s.add_at_most_one_constraint(v.begin(), v.end()));
+      }
+    }
+  }
+
+  std::array<INDEX,3> dim_;
+};
+
+struct mrf_test_FMC {
+  constexpr static const char* name = "MRF test model";
+  using unary = FactorContainer<mrf_unary, mrf_test_FMC, 0, true>;
+  using pairwise = FactorContainer<mrf_pairwise, mrf_test_FMC, 1, true>;
+  using triplet = FactorContainer<mrf_triplet, mrf_test_FMC, 2>;
+  using unary_pairwise_message_0 = MessageContainer<mrf_unary_pairwise_message<0>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, mrf_test_FMC, 0>;
+  using unary_pairwise_message_1 = MessageContainer<mrf_unary_pairwise_message<1>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, mrf_test_FMC, 1>;
+  using pairwise_triplet_message_12 = MessageContainer<mrf_pairwise_triplet_message<0,1>, 1, 2, message_passing_schedule::left, variableMessageNumber, 1, mrf_test_FMC, 2>;
+  using pairwise_triplet_message_13 = MessageContainer<mrf_pairwise_triplet_message<0,2>, 1, 2, message_passing_schedule::left, variableMessageNumber, 1, mrf_test_FMC, 3>;
+  using pairwise_triplet_message_23 = MessageContainer<mrf_pairwise_triplet_message<1,2>, 1, 2, message_passing_schedule::left, variableMessageNumber, 1, mrf_test_FMC, 4>;
+  using FactorList = meta::list<unary, pairwise, triplet>;
+  using MessageList = meta::list<unary_pairwise_message_0, unary_pairwise_message_1, pairwise_triplet_message_12, pairwise_triplet_message_13, pairwise_triplet_message_23>;
+
+  using mrf = StandardMrfConstructor<mrf_test_FMC, 0, 1, 0, 1>;
+  using tightening_mrf = TighteningMRFProblemConstructor<mrf, 2, 2, 3, 4>;
+  using ProblemDecompositionList = meta::list<tightening_mrf>;
+};
+
+// n binary variables on a cycle whose neighbors prefer different labels. For odd n the local polytope relaxation has value 0 and the optimum is 1.
+template<typename MRF>
+void build_frustrated_cycle(MRF& mrf, const INDEX n, const REAL unary_cost = 0.0)
+{
+  for(INDEX i=0; i<n; ++i) {
+    mrf.AddUnaryFactor(std::vector<REAL>({0.0, unary_cost}));
+  }
+  matrix<REAL> repulsive(2, 2, 0.0);
+  repulsive(0,0) = 1.0;
+  repulsive(1,1) = 1.0;
+  for(INDEX i=0; i+1<n; ++i) {
+    mrf.AddPairwiseFactor(i, i+1, repulsive);
+  }
+  mrf.AddPairwiseFactor(0, n-1, repulsive);
+}
+
+} // namespace LP_MP
+
+#endif // LP_MP_MRF_TEST_MODEL_HXX
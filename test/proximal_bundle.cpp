@@ -0,0 +1,45 @@
+#include "test.h"
+#include "proximal_bundle.hxx"
+#include <vector>
+#include <cmath>
+
+using namespace LP_MP;
+
+// maximize the polyhedral concave function f(x) = - sum_i w_i |x_i - c_i| with optimum 0 at x = c
+int main()
+{
+  const std::vector<REAL> c = {1.0, -2.0, 0.5, 3.0, -0.25};
+  const std::vector<REAL> w = {1.0, 2.0, 0.5, 1.0, 3.0};
+
+  INDEX no_oracle_calls = 0;
+  auto oracle = [&](const std::vector<REAL>& x, std::vector<REAL>& g) {
+    ++no_oracle_calls;
+    REAL f = 0.0;
+    for(INDEX i=0; i<x.size(); ++i) {
+      f -= w[i]*std::abs(x[i] - c[i]);
+      g[i] = x[i] < c[i] ? w[i] : -w[i];
+    }
+    return f;
+  };
+
+  // small bundle, so that both dropping of inactive cuts and aggregation are exercised
+  proximal_bundle::options o;
+  o.max_bundle_size = 3;
+  proximal_bundle b(c.size(), o);
+  b.init(oracle);
+  const REAL f_init = b.value();
+
+  REAL prev_value = f_init;
+  for(INDEX iter=0; iter<500 && !b.converged(); ++iter) {
+    b.step(oracle);
+    test(b.value() >= prev_value); // center value is monotone
+    test(b.no_cuts() <= o.max_bundle_size);
+    prev_value = b.value();
+  }
+
+  test(b.value() > f_init);
+  test(b.value() >= -1e-4);
+  for(INDEX i=0; i<c.size(); ++i) {
+    test(std::abs(b.center()[i] - c[i]) <= 1e-3);
+  }
+}
@@ -4,7 +4,7 @@
 using namespace LP_MP;
 
 template<typename T>
-const INDEX archive_size(T&& e)
+std::size_t archive_size(T&& e)
 {
    allocate_archive ar;
    ar(e);
@@ -121,6 +121,29 @@ int main()
       test(p_test[3] == p[3]);
       test(r_test == r_r);
       test(m_test == m_r);
+   }
+
+   { // sizes beyond 32 bit
+      const std::size_t no_elements = (std::size_t(1) << 32) + 3;
+      test(archive_size(binary_data<REAL>(&i_r, no_elements)) == no_elements*sizeof(REAL));
+
+      allocate_archive large_ar;
+      large_ar(binary_data<REAL>(&i_r, no_elements), binary_data<INDEX>(p, no_elements));
+      test(large_ar.size() == no_elements*(sizeof(REAL) + sizeof(INDEX)));
+   }
+
+   { // view onto foreign memory, which must not be freed by the archive
+      std::vector<REAL> mem(4, 0.0);
+      {
+         serialization_archive ar(mem.data(), mem.size()*sizeof(REAL));
+         save_archive s_ar(ar);
+         s_ar(binary_data<REAL>(p_r, 4));
+         test(ar.cur_address() == (char*) (mem.data() + 4));
+      }
+      test(mem[0] == p_r[0] && mem[3] == p_r[3]);
+
+      serialization_archive ar(mem.data(), 2*sizeof(REAL));
+      ar.release_memory();
+      test(mem[1] == p_r[1]);
    } 
 }
-
@@ -0,0 +1,172 @@
+#include "test.h"
+#include "snapshot_chain.hxx"
+#include <sstream>
+#include <random>
+#include <cstring>
+
+using namespace LP_MP;
+
+int main()
+{
+   std::mt19937 gen(0);
+   std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+   // sequence of snapshots where only few entries change, with a size change in the middle
+   std::vector<std::vector<double>> snapshots;
+   std::vector<double> x(1000);
+   for(auto& v : x) { v = dist(gen); }
+   for(std::size_t k=0; k<40; ++k) {
+      if(k == 25) { x.push_back(0.5); }
+      for(std::size_t i=0; i<10; ++i) {
+         x[gen() % x.size()] += 1e-3*dist(gen);
+      }
+      snapshots.push_back(x);
+   }
+
+   snapshot_chain chain(8);
+   for(const auto& s : snapshots) {
+      chain.push(reinterpret_cast<const char*>(s.data()), s.size()*sizeof(double));
+   }
+   test(chain.no_snapshots() == snapshots.size());
+   test(chain.encoded_size() < snapshots.size()*snapshots[0].size()*sizeof(double) / 4);
+
+   auto check = [&](const snapshot_chain& c) {
+      for(std::size_t k=0; k<snapshots.size(); ++k) {
+         test(c.snapshot_size(k) == snapshots[k].size()*sizeof(double));
+         std::vector<double> r(snapshots[k].size());
+         c.reconstruct(k, reinterpret_cast<char*>(r.data()));
+         test(std::memcmp(r.data(), snapshots[k].data(), r.size()*sizeof(double)) == 0);
+      }
+   };
+   check(chain);
+
+   { // round trip through stream, then continue the chain
+      std::stringstream ss;
+      chain.write(ss);
+      auto chain2 = snapshot_chain::read(ss);
+      check(chain2);
+
+      x[3] = 42.0;
+      snapshots.push_back(x);
+      chain.push(reinterpret_cast<const char*>(x.data()), x.size()*sizeof(double));
+      chain2.push(reinterpret_cast<const char*>(x.data()), x.size()*sizeof(double));
+      check(chain);
+      check(chain2);
+   }
+
+   { // incremental writing with frames released after writing, reading stops at a truncated frame
+      std::stringstream ss;
+      snapshot_chain c(8);
+      c.write_header(ss);
+      std::size_t complete_size = 0;
+      for(const auto& s : snapshots) {
+         const auto k = c.push(reinterpret_cast<const char*>(s.data()), s.size()*sizeof(double));
+         complete_size = ss.str().size();
+         c.write_frame(ss, k);
+         c.release_frames();
+      }
+      test(c.no_snapshots() == snapshots.size());
+
+      auto read_frames = [&](const std::string& str) {
+         std::stringstream in(str);
+         auto r = snapshot_chain::read_header(in);
+         while(r.read_frame(in)) {}
+         return r;
+      };
+      check(read_frames(ss.str()));
+
+      const auto truncated = read_frames(ss.str().substr(0, complete_size + 5));
+      test(truncated.no_snapshots() == snapshots.size()-1);
+      std::vector<double> r(snapshots.end()[-2].size());
+      truncated.reconstruct(truncated.no_snapshots()-1, reinterpret_cast<char*>(r.data()));
+      test(std::memcmp(r.data(), snapshots.end()[-2].data(), r.size()*sizeof(double)) == 0);
+   }
+
+   { // corrupted frames are rejected without reading or writing out of bounds
+      const char a[] = "abcdefghijk";
+      snapshot_chain c;
+      c.push(a, sizeof(a));
+      std::stringstream valid;
+      c.write(valid);
+
+      auto frame_stream = [&](const std::uint8_t keyframe, const std::uint64_t size, const std::vector<std::uint8_t>& data, const std::uint64_t data_size) {
+         std::string str = valid.str();
+         str.append(reinterpret_cast<const char*>(&keyframe), sizeof(keyframe));
+         str.append(reinterpret_cast<const char*>(&size), sizeof(size));
+         str.append(reinterpret_cast<const char*>(&data_size), sizeof(data_size));
+         str.append(data.begin(), data.end());
+         return str;
+      };
+      auto rejected = [&](const std::string& str) {
+         std::stringstream in(str);
+         auto chain = snapshot_chain::read_header(in);
+         std::uint64_t no_frames;
+         in.read(reinterpret_cast<char*>(&no_frames), sizeof(no_frames));
+         test(chain.read_frame(in));
+         if(chain.read_frame(in)) { return false; }
+         test(chain.no_snapshots() == 1);
+         char r0[sizeof(a)];
+         chain.reconstruct(0, r0);
+         test(std::memcmp(r0, a, sizeof(a)) == 0);
+         return true;
+      };
+      const std::uint64_t size = sizeof(a); // two words, the second one partial
+      test(!rejected(frame_stream(1, size, {0x01, 0x01, 0x02, 0xaa, 0xbb}, 5)));
+      test(rejected(frame_stream(2, size, {0x01, 0x01, 0x02, 0xaa, 0xbb}, 5))); // invalid keyframe flag
+      test(rejected(frame_stream(1, size, {0x00, 0x01, 0x09, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0x01, 0x00}, 14))); // more than 8 bytes in a word
+      test(rejected(frame_stream(1, size, {0x01, 0x01, 0x05, 1, 2, 3, 4, 5}, 8))); // more bytes than the partial word holds
+      test(rejected(frame_stream(1, size, {0x01, 0x01, 0x02, 0xaa}, 4))); // literal runs past the end of data
+      test(rejected(frame_stream(1, size, {0x01, 0x80}, 2))); // unterminated varint
+      test(rejected(frame_stream(1, size, {0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01}, 12))); // varint exceeding 64 bits
+      test(rejected(frame_stream(1, size, {0x03, 0x00}, 2))); // zero run beyond the last word
+      test(rejected(frame_stream(1, size, {0x00, 0x03, 1, 1, 1, 2, 1, 3}, 8))); // literals beyond the last word
+      test(rejected(frame_stream(1, size, {0x01, 0x00}, 2))); // not all words covered
+      test(rejected(frame_stream(1, size, {0x00, 0x00, 0x02, 0x00}, 4))); // empty block
+      test(rejected(frame_stream(0, size+1, {0x02, 0x00}, 2))); // delta frame of different size
+      test(rejected(frame_stream(1, size, {0x02, 0x00}, std::uint64_t(1) << 40))); // data size exceeding any encoding of size bytes
+      test(rejected(frame_stream(1, std::uint64_t(1) << 50, {0x02, 0x00}, std::uint64_t(1) << 50))); // data size exceeding the stream
+      test(rejected(frame_stream(1, std::numeric_limits<std::uint64_t>::max(), {}, 0)));
+
+      // reading a whole chain throws at the first invalid frame
+      std::string corrupted = valid.str();
+      // the encoded frame consists of zero run, literal count, and two words of 8 and 3 bytes, each preceded by its byte count
+      test(corrupted[corrupted.size()-13] == 8);
+      corrupted[corrupted.size()-13] = 9;
+      std::stringstream in(corrupted);
+      bool thrown = false;
+      try {
+         snapshot_chain::read(in);
+      } catch(const std::runtime_error&) {
+         thrown = true;
+      }
+      test(thrown);
+
+      // corrupting any single byte of the frame either throws or yields a chain which can be reconstructed
+      for(std::size_t i=2*sizeof(std::uint64_t); i<valid.str().size(); ++i) {
+         for(const int x : {0x01, 0x80, 0xff}) {
+            std::string str = valid.str();
+            str[i] ^= x;
+            std::stringstream in(str);
+            try {
+               auto r = snapshot_chain::read(in);
+               test(r.no_snapshots() == 1);
+               std::vector<char> out(r.snapshot_size(0));
+               r.reconstruct(0, out.data());
+            } catch(const std::runtime_error&) {}
+         }
+      }
+   }
+
+   { // sizes not divisible by word size
+      const char a[] = "abcdefghijk";
+      const char b[] = "abcdefgXijk";
+      snapshot_chain c;
+      c.push(a, sizeof(a));
+      c.push(b, sizeof(b));
+      char r[sizeof(a)];
+      c.reconstruct(0, r);
+      test(std::memcmp(r, a, sizeof(a)) == 0);
+      c.reconstruct(1, r);
+      test(std::memcmp(r, b, sizeof(b)) == 0);
+   }
+}
@@ -0,0 +1,42 @@
+#include "test.h"
+#include "spsc_queue.hxx"
+#include <thread>
+#include <cstdint>
+
+using namespace LP_MP;
+
+int main()
+{
+   spsc_queue<std::uint64_t> q(100);
+   test(q.capacity() == 128);
+
+   std::uint64_t x;
+   test(!q.try_pop(x));
+   for(std::uint64_t i=0; i<q.capacity(); ++i) {
+      test(q.try_push(i));
+   }
+   test(!q.try_push(0));
+   test(q.try_pop(x) && x == 0);
+   std::vector<std::uint64_t> out;
+   test(q.pop_all(out) == q.capacity()-1);
+   test(out.size() == q.capacity()-1 && out.front() == 1 && out.back() == q.capacity()-1);
+   test(!q.try_pop(x));
+
+   // entries arrive in order and none is lost when producer and consumer run concurrently
+   const std::uint64_t n = 1000000;
+   std::thread producer([&]() {
+      for(std::uint64_t i=0; i<n; ++i) {
+         while(!q.try_push(i)) { std::this_thread::yield(); }
+      }
+   });
+   std::uint64_t expected = 0;
+   while(expected < n) {
+      out.clear();
+      q.pop_all(out);
+      for(const auto i : out) {
+         test(i == expected++);
+      }
+   }
+   producer.join();
+   test(!q.try_pop(x));
+}
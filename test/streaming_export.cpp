@@ -0,0 +1,249 @@
+#include "test.h"
+#include "test_model.hxx"
+#include "LP_external_interface.hxx"
+#include "streaming_export.hxx"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cctype>
+#include <cstdio>
+
+using namespace LP_MP;
+
+// binary program read back from an exported file, variables are numbered in order of appearance
+struct binary_program {
+  struct constraint { std::map<std::size_t, REAL> coeffs; std::string sense; REAL rhs = 0.0; };
+
+  std::size_t variable(const std::string& name)
+  {
+    auto it = names.find(name);
+    if(it == names.end()) {
+      it = names.insert({name, names.size()}).first;
+      objective.push_back(0.0);
+    }
+    return it->second;
+  }
+
+  // number of feasible assignments and their minimal cost
+  std::pair<std::size_t, REAL> enumerate() const
+  {
+    const std::size_t n = names.size();
+    test(n <= 24);
+    std::size_t feasible = 0;
+    REAL best = std::numeric_limits<REAL>::infinity();
+    for(std::size_t a=0; a<(std::size_t(1) << n); ++a) {
+      auto x = [a](const std::size_t i) { return REAL((a >> i) & 1); };
+      bool ok = true;
+      for(const auto& c : constraints) {
+        REAL lhs = 0.0;
+        for(const auto& t : c.coeffs) { lhs += t.second*x(t.first); }
+        ok = ok && (c.sense == "=" ? std::abs(lhs - c.rhs) <= eps : (c.sense == "<=" ? lhs <= c.rhs + eps : lhs >= c.rhs - eps));
+      }
+      if(!ok) { continue; }
+      ++feasible;
+      REAL cost = constant;
+      for(std::size_t i=0; i<n; ++i) { cost += objective[i]*x(i); }
+      best = std::min(best, cost);
+    }
+    return {feasible, best};
+  }
+
+  std::map<std::string, std::size_t> names;
+  std::vector<REAL> objective;
+  REAL constant = 0.0;
+  std::vector<constraint> constraints;
+};
+
+std::vector<std::string> tokenize(const std::string& filename)
+{
+  std::ifstream f(filename);
+  test(bool(f));
+  std::vector<std::string> tokens;
+  std::string line;
+  while(std::getline(f, line)) {
+    line = line.substr(0, line.find('\\'));
+    // separate operators from names and numbers
+    std::string spaced;
+    for(std::size_t i=0; i<line.size(); ++i) {
+      const char c = line[i];
+      const bool exponent_sign = (c == '+' || c == '-') && i > 0 && (line[i-1] == 'e' || line[i-1] == 'E') && i > 1 && std::isdigit(line[i-2]);
+      if((c == '+' || c == '-') && !exponent_sign) { spaced += std::string(" ") + c + " "; }
+      else if(c == '<' || c == '>' || c == '=') { spaced += std::string(" ") + c + (i+1 < line.size() && line[i+1] == '=' ? "=" : "") + " "; i += i+1 < line.size() && line[i+1] == '='; }
+      else if(c == ':') { spaced += " : "; }
+      else { spaced += c; }
+    }
+    std::istringstream ss(spaced);
+    std::string t;
+    while(ss >> t) { tokens.push_back(t); }
+  }
+  return tokens;
+}
+
+bool is_number(const std::string& t) { return !t.empty() && (std::isdigit(t[0]) || t[0] == '.'); }
+
+// reads sums of terms up to a comparison operator or section keyword, constants go to rhs
+std::size_t read_terms(const std::vector<std::string>& t, std::size_t i, binary_program& p, std::map<std::size_t, REAL>& coeffs, REAL& constant)
+{
+  REAL sign = 1.0;
+  REAL coeff = 1.0;
+  bool has_coeff = false;
+  for(; i<t.size(); ++i) {
+    if(t[i] == "+") { sign = 1.0; }
+    else if(t[i] == "-") { sign = -1.0; }
+    else if(is_number(t[i])) {
+      if(has_coeff) { constant += sign*coeff; sign = 1.0; }
+      coeff = std::stod(t[i]);
+      has_coeff = true;
+    }
+    else if(i+1 < t.size() && t[i+1] == ":") { ++i; }
+    else if(t[i] == "<=" || t[i] == ">=" || t[i] == "=" || t[i] == "<" || t[i] == ">" || t[i] == "=<" || t[i] == "=>") { break; }
+    else {
+      std::string lower;
+      for(char c : t[i]) { lower += std::tolower(c); }
+      if(lower == "subject" || lower == "st" || lower == "s.t." || lower == "bounds" || lower == "binaries" || lower == "binary" || lower == "end") { break; }
+      coeffs[p.variable(t[i])] += sign*coeff;
+      sign = 1.0;
+      coeff = 1.0;
+      has_coeff = false;
+    }
+  }
+  if(has_coeff) { constant += sign*coeff; }
+  return i;
+}
+
+std::string section(const std::string& t)
+{
+  std::string lower;
+  for(char c : t) { lower += std::tolower(c); }
+  return lower;
+}
+
+binary_program read_lp(const std::string& filename)
+{
+  const auto t = tokenize(filename);
+  binary_program p;
+  std::size_t i = 0;
+  test(t.size() > 0 && section(t[0]).substr(0,3) == "min");
+  {
+    std::map<std::size_t, REAL> coeffs;
+    i = read_terms(t, 1, p, coeffs, p.constant);
+    for(const auto& c : coeffs) { p.objective[c.first] += c.second; }
+  }
+  test(i+1 < t.size() && section(t[i]) == "subject" && section(t[i+1]) == "to");
+  i += 2;
+  while(i < t.size() && section(t[i]) != "bounds" && section(t[i]) != "binaries" && section(t[i]) != "binary" && section(t[i]) != "end") {
+    binary_program::constraint c;
+    REAL lhs_constant = 0.0;
+    i = read_terms(t, i, p, c.coeffs, lhs_constant);
+    test(i+1 < t.size());
+    c.sense = t[i] == "<" || t[i] == "=<" ? "<=" : (t[i] == ">" || t[i] == "=>" ? ">=" : t[i]);
+    REAL sign = 1.0;
+    for(++i; t[i] == "+" || t[i] == "-"; ++i) { sign *= t[i] == "-" ? -1.0 : 1.0; }
+    test(is_number(t[i]));
+    c.rhs = sign*std::stod(t[i++]) - lhs_constant;
+    test(!c.coeffs.empty());
+    p.constraints.push_back(c);
+  }
+  // remaining names are declared binary or bounded
+  for(; i < t.size() && section(t[i]) != "end"; ++i) {
+    const std::string k = section(t[i]);
+    if(k != "binaries" && k != "binary" && k != "bounds" && !is_number(t[i]) && std::isalpha(t[i][0])) { p.variable(t[i]); }
+  }
+  return p;
+}
+
+binary_program read_mps(const std::string& filename)
+{
+  std::ifstream f(filename);
+  test(bool(f));
+  binary_program p;
+  std::map<std::string, std::size_t> rows; // constraint index, objective is not listed
+  std::string objective_row, line, s, token;
+  while(std::getline(f, line)) {
+    std::istringstream ss(line);
+    std::vector<std::string> t;
+    while(ss >> token) { t.push_back(token); }
+    if(t.empty() || line[0] == '*') { continue; }
+    if(line[0] != ' ') { s = t[0]; continue; }
+    if(s == "ROWS") {
+      if(t[0] == "N") { objective_row = t[1]; continue; }
+      rows[t[1]] = p.constraints.size();
+      p.constraints.push_back({});
+      p.constraints.back().sense = t[0] == "E" ? "=" : (t[0] == "L" ? "<=" : ">=");
+    } else if(s == "COLUMNS") {
+      if(t.size() > 1 && t[1] == "'MARKER'") { continue; }
+      const std::size_t x = p.variable(t[0]);
+      for(std::size_t k=1; k+1<t.size(); k+=2) {
+        if(t[k] == objective_row) { p.objective[x] += std::stod(t[k+1]); }
+        else { p.constraints[rows.at(t[k])].coeffs[x] += std::stod(t[k+1]); }
+      }
+    } else if(s == "RHS") {
+      for(std::size_t k=1; k+1<t.size(); k+=2) {
+        if(t[k] == objective_row) { p.constant -= std::stod(t[k+1]); }
+        else { p.constraints[rows.at(t[k])].rhs = std::stod(t[k+1]); }
+      }
+    } else if(s == "BOUNDS") {
+      test(t[0] == "BV");
+      p.variable(t[2]);
+    }
+  }
+  return p;
+}
+
+// the streaming export must describe the same binary program as the export through DD_ILP.
+// The test model is built for LPs with trees, which do not change the exported program.
+int main()
+{
+  const REAL constant = 0.5;
+
+  TCLAP::CmdLine cmd_external("external solver");
+  LP_external_solver<DD_ILP::problem_export, LP_subgradient_ascent<test_FMC>> external(cmd_external);
+  std::vector<std::string> args_external = {"external solver"};
+  cmd_external.parse(args_external);
+  build_test_model(external);
+  external.write_to_file("streaming_export_reference.lp");
+
+  TCLAP::CmdLine cmd_streaming("streaming export");
+  LP_streaming_export<LP_subgradient_ascent<test_FMC>> streaming(cmd_streaming);
+  std::vector<std::string> args_streaming = {"streaming export"};
+  cmd_streaming.parse(args_streaming);
+  build_test_model(streaming);
+  streaming.add_to_constant(constant);
+  // a small run size sorts coefficients of the MPS file in several runs
+  streaming.write_to_file("streaming_export.lp");
+  streaming.write_to_file("streaming_export.mps", nullptr, 4);
+
+  const auto reference = read_lp("streaming_export_reference.lp").enumerate();
+  test(reference.first > 0);
+  for(const auto& p : {read_lp("streaming_export.lp"), read_mps("streaming_export.mps")}) {
+    test(p.names.size() == 2*streaming.GetNumberOfFactors());
+    const auto result = p.enumerate();
+    test(result.first == reference.first);
+    test(std::abs(result.second - (reference.second + constant)) <= eps);
+  }
+
+  // constraints without variables are skipped if they hold and rejected otherwise
+  {
+    streaming_problem_export s("streaming_export_empty.lp", streaming_problem_export::format::lp);
+    s.add_objective(1.0);
+    std::vector<streaming_problem_export::variable> none;
+    s.add_linear_constraint(none.begin(), none.end(), [](const INDEX) { return 1.0; }, '<', 1.0);
+    s.add_at_most_one_constraint(none.begin(), none.end()); // yields a variable fixed to zero
+    bool infeasible = false;
+    try {
+      s.add_simplex_constraint(none.begin(), none.end());
+    } catch(const std::runtime_error&) {
+      infeasible = true;
+    }
+    test(infeasible);
+    s.finish();
+    const auto p = read_lp("streaming_export_empty.lp");
+    test(p.names.size() == 2 && p.constraints.size() == 1);
+    const auto result = p.enumerate();
+    test(result.first == 2 && std::abs(result.second) <= eps);
+  }
+
+  for(const char* f : {"streaming_export_reference.lp", "streaming_export.lp", "streaming_export.mps", "streaming_export_empty.lp"}) {
+    std::remove(f);
+  }
+}
@@ -0,0 +1,62 @@
+#include "test.h"
+#include "telemetry.hxx"
+#include <cstdio>
+#include <limits>
+
+using namespace LP_MP;
+
+int main()
+{
+   // records written through the ring buffer are read back unchanged, in both formats
+   for(const std::string filename : {"telemetry_test.bin", "telemetry_test.jsonl"}) {
+      const std::size_t n = 1000;
+      {
+         telemetry::writer w(filename, 2*n);
+         for(std::size_t i=0; i<n; ++i) {
+            telemetry::record r;
+            r.iteration = i;
+            r.time = 0.001*i;
+            r.lower_bound = -1.0/(i+1);
+            r.upper_bound = i == 0 ? std::numeric_limits<double>::infinity() : 1.0/3.0;
+            r.phase_time.fill(1e-4);
+            test(w.push(r));
+         }
+         w.close();
+         test(w.dropped() == 0);
+      }
+
+      const auto t = telemetry::read_file(filename);
+      test(t.names == telemetry::column_names());
+      test(t.rows.size() == n);
+      const std::size_t lb = t.column("lower_bound");
+      const std::size_t ub = t.column("upper_bound");
+      for(std::size_t i=0; i<n; ++i) {
+         test(t.rows[i][t.column("iteration")] == i);
+         test(t.rows[i][lb] == -1.0/(i+1));
+         test(t.rows[i][ub] == (i == 0 ? std::numeric_limits<double>::infinity() : 1.0/3.0));
+         test(t.rows[i][t.column("memory")] > 0);
+      }
+      std::remove(filename.c_str());
+   }
+
+   // write errors are thrown by close() and only reported by the destructor. /dev/full fails every write with ENOSPC
+   if(std::FILE* f = std::fopen("/dev/full", "w")) {
+      std::fclose(f);
+      telemetry::record r;
+      {
+         telemetry::writer w("/dev/full", 16);
+         test(w.push(r));
+         bool thrown = false;
+         try {
+            w.close();
+         } catch(const std::runtime_error&) {
+            thrown = true;
+         }
+         test(thrown);
+      }
+      {
+         telemetry::writer w("/dev/full", 16);
+         test(w.push(r));
+      }
+   }
+}
@@ -7,7 +7,7 @@ using namespace LP_MP;
 
 int main(int argc, char** argv)
 {
-  Solver<test_FMC, LP_tree_FWMAP, StandardVisitor> s;
+  Solver<LP_tree_FWMAP<test_FMC>, StandardVisitor> s;
   auto& lp = s.GetLP();
 
   build_test_model(lp);
@@ -0,0 +1,57 @@
+#include "test.h"
+#include "test_model.hxx"
+#include "LP_FWMAP.hxx"
+#include "LP_FWMAP_parallel.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+
+using namespace LP_MP;
+
+// two disjoint copies of the test model, hence trees of different copies share no Lagrangean variables and are colored alike
+template<typename SOLVER>
+void build_model(SOLVER& s)
+{
+  build_test_model(s.GetLP());
+  build_test_model(s.GetLP());
+}
+
+template<typename LP_TYPE>
+REAL lower_bound(std::vector<std::string> options)
+{
+  Solver<LP_TYPE, StandardVisitor> s(options);
+  build_model(s);
+  s.Solve();
+  return s.lower_bound();
+}
+
+// parallel Frank-Wolfe must reach the same bound as the serial FW-MAP implementation
+int main()
+{
+  const std::vector<std::string> options = {"", "--maxIter", "50", "-v", "0"};
+  const REAL serial_lb = lower_bound<LP_tree_FWMAP<test_FMC>>(options);
+  test(std::abs(serial_lb - 2.0) <= 1e-3);
+
+  std::vector<std::string> persistent = options;
+  persistent.push_back("--persistentWeights");
+  std::vector<std::string> views = options;
+  views.push_back("--factorViews");
+  for(const auto& o : {options, persistent, views}) {
+    const REAL lb = lower_bound<LP_tree_FWMAP_parallel<test_FMC>>(o);
+    test(std::abs(lb - serial_lb) <= 1e-3);
+  }
+
+  // the bound follows changes of the model instead of keeping the larger bound from before
+  {
+    Solver<LP_tree_FWMAP_parallel<test_FMC>, StandardVisitor> s(options);
+    build_model(s);
+    s.Solve();
+    test(std::abs(s.GetLP().LowerBound() - 2.0) <= 1e-3);
+
+    // factor not shared by several trees, hence not copied by the decomposition. Lowering all its costs by one lowers the optimum by one.
+    auto* f = s.GetLP().GetFactor(1);
+    const REAL delta[2] = {-1.0, -1.0};
+    s.GetLP().add_to_cost(f, delta);
+    s.GetLP().ComputePass(50);
+    test(std::abs(s.GetLP().LowerBound() - 1.0) <= 1e-3);
+  }
+}
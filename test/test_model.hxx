@@ -133,53 +133,39 @@ struct test_FMC { // factor message connection
 template<typename LP_TYPE>
 void build_test_model(LP_TYPE& lp)
 {
-  auto* f1 = new typename test_FMC::factor(0,1);
-  lp.AddFactor(f1);
-  {
-    factor_tree t1;
-    auto* f2 = new typename test_FMC::factor(1,0);
-    auto* f3 = new typename test_FMC::factor(0,0);
-    lp.AddFactor(f2);
-    lp.AddFactor(f3);
-    lp.add_message<typename test_FMC::message>(f1,f2);
-    lp.add_message<typename test_FMC::message>(f1,f3);
-    auto* m12 = new typename test_FMC::message(f1,f2);
-    auto* m13 = new typename test_FMC::message(f1,f3);
-    lp.AddMessage(m13);
-    t1.AddMessage(m12, Chirality::left);
-    t1.AddMessage(m13, Chirality::left);
+  auto* f1 = lp.template add_factor<typename test_FMC::factor>(0.0,1.0);
+  {
+    factor_tree<test_FMC> t1;
+    auto* f2 = lp.template add_factor<typename test_FMC::factor>(1.0,0.0);
+    auto* f3 = lp.template add_factor<typename test_FMC::factor>(0.0,0.0);
+    auto* m12 = lp.template add_message<typename test_FMC::message>(f1,f2);
+    auto* m13 = lp.template add_message<typename test_FMC::message>(f1,f3);
+    t1.add_message(*m12, Chirality::left);
+    t1.add_message(*m13, Chirality::left);
     t1.init();
     lp.add_tree(t1);
   }
 
   {
-    factor_tree t2;
-    auto* f2 = new typename test_FMC::factor(1,0);
-    auto* f3 = new typename test_FMC::factor(0,0);
-    lp.AddFactor(f2);
-    lp.AddFactor(f3);
-    auto* m12 = new typename test_FMC::message(f1,f2);
-    auto* m23 = new typename test_FMC::message(f2,f3);
-    lp.AddMessage(m12);
-    lp.AddMessage(m23);
-    t2.AddMessage(m12, Chirality::right);
-    t2.AddMessage(m23, Chirality::left);
+    factor_tree<test_FMC> t2;
+    auto* f2 = lp.template add_factor<typename test_FMC::factor>(1.0,0.0);
+    auto* f3 = lp.template add_factor<typename test_FMC::factor>(0.0,0.0);
+    auto* m12 = lp.template add_message<typename test_FMC::message>(f1,f2);
+    auto* m23 = lp.template add_message<typename test_FMC::message>(f2,f3);
+    t2.add_message(*m12, Chirality::right);
+    t2.add_message(*m23, Chirality::left);
     t2.init();
     lp.add_tree(t2);
   }
 
   {
-    factor_tree t3;
-    auto* f2 = new typename test_FMC::factor(1,0);
-    auto* f3 = new typename test_FMC::factor(0,0);
-    lp.AddFactor(f2);
-    lp.AddFactor(f3);
-    auto* m12 = new typename test_FMC::message(f1,f2);
-    auto* m23 = new typename test_FMC::message(f2,f3);
-    lp.AddMessage(m12);
-    lp.AddMessage(m23);
-    t3.AddMessage(m12, Chirality::right);
-    t3.AddMessage(m23, Chirality::left);
+    factor_tree<test_FMC> t3;
+    auto* f2 = lp.template add_factor<typename test_FMC::factor>(1.0,0.0);
+    auto* f3 = lp.template add_factor<typename test_FMC::factor>(0.0,0.0);
+    auto* m12 = lp.template add_message<typename test_FMC::message>(f1,f2);
+    auto* m23 = lp.template add_message<typename test_FMC::message>(f2,f3);
+    t3.add_message(*m12, Chirality::right);
+    t3.add_message(*m23, Chirality::left);
     t3.init();
     lp.add_tree(t3);
   }
@@ -0,0 +1,253 @@
+#include "test.h"
+#include "mrf_test_model.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+
+using namespace LP_MP;
+
+using triplet_container = typename mrf_test_FMC::triplet;
+
+template<typename LP_TYPE>
+REAL run_passes(LP_TYPE& lp, INDEX& iteration, const INDEX no_passes)
+{
+  REAL lb = lp.LowerBound();
+  for(INDEX i=0; i<no_passes; ++i, ++iteration) {
+    lp.ComputePass(iteration);
+    const REAL new_lb = lp.LowerBound();
+    test(new_lb >= lb - eps);
+    lb = new_lb;
+  }
+  return lb;
+}
+
+template<typename LP_TYPE>
+triplet_container* get_triplet(LP_TYPE& lp, const INDEX no_labels)
+{
+  for(INDEX i=0; i<lp.GetNumberOfFactors(); ++i) {
+    auto* t = dynamic_cast<triplet_container*>(lp.GetFactor(i));
+    if(t != nullptr && t->GetFactor()->dim1() == no_labels) { return t; }
+  }
+  return nullptr;
+}
+
+// tighten a frustrated triangle, add a triplet on variables without costs and retire it, once its reparametrization has stayed zero
+void test_retire_inactive_triplets()
+{
+  std::vector<std::string> options = {"", "-v", "0"};
+  Solver<LP<mrf_test_FMC>, StandardVisitor> s(options);
+  auto& mrf = s.GetProblemConstructor<0>();
+  auto& lp = s.GetLP();
+  build_frustrated_cycle(mrf, 3, 0.1);
+  for(INDEX i=0; i<3; ++i) {
+    mrf.AddUnaryFactor(std::vector<REAL>(3, 0.0));
+  }
+  lp.Begin();
+  lp.set_reparametrization(LPReparametrizationMode::DampedUniform);
+
+  INDEX iteration = 0;
+  run_passes(lp, iteration, 20);
+  test(mrf.Tighten(10) == 1);
+  test(mrf.GetNumberOfTripletFactors() == 1);
+  test(mrf.AddTighteningTriplet(3,4,5));
+  test(!mrf.AddTighteningTriplet(3,4,5));
+  test(mrf.GetNumberOfTripletFactors() == 2);
+  const REAL tight_lb = run_passes(lp, iteration, 100);
+  test(std::abs(tight_lb - 1.1) <= eps);
+
+  const INDEX retire_after = 5;
+  test(mrf.retire_inactive_triplets(iteration, retire_after) == 0);
+  run_passes(lp, iteration, retire_after);
+
+  // leave cost within the tolerance in the zero triplet. Its pairwise factors have large entries, so that dropping the cost would change the lower bound by more than eps.
+  matrix<REAL> attractive(3, 3, 1e3);
+  for(INDEX x=0; x<3; ++x) { attractive(x,x) = 0.0; }
+  mrf.AddToPairwiseCost(3, 4, attractive);
+  auto* zero_triplet = get_triplet(lp, 3);
+  test(zero_triplet != nullptr);
+  for(auto& c : zero_triplet->GetFactor()->cost) { c -= 5e-7; }
+
+  const INDEX no_factors = lp.GetNumberOfFactors();
+  const INDEX no_messages = lp.GetNumberOfMessages();
+  const REAL lb_before = lp.LowerBound();
+  test(mrf.retire_inactive_triplets(iteration, retire_after) == 1);
+  test(mrf.GetNumberOfTripletFactors() == 1);
+  test(lp.GetNumberOfFactors() == no_factors-1);
+  test(lp.GetNumberOfMessages() == no_messages-3);
+  test(get_triplet(lp, 3) == nullptr);
+  test(std::abs(lp.LowerBound() - lb_before) <= eps);
+
+  // message passing continues on the filtered orderings. The retired triplet is not added again until the cooldown has passed.
+  test(!mrf.AddTighteningTriplet(3,4,5));
+  const REAL lb_after = run_passes(lp, iteration, retire_after-1);
+  test(lb_after >= lb_before - eps);
+  test(mrf.retire_inactive_triplets(iteration, retire_after) == 0);
+  test(!mrf.AddTighteningTriplet(3,4,5));
+  run_passes(lp, iteration, 1);
+  test(mrf.retire_inactive_triplets(iteration, retire_after) == 0);
+  test(mrf.AddTighteningTriplet(3,4,5));
+  run_passes(lp, iteration, 10);
+}
+
+template<typename SEARCH, typename MRF>
+void test_same_candidates(SEARCH& persistent, const MRF& mrf)
+{
+  SEARCH fresh(mrf);
+  const auto c = persistent.search();
+  const auto c_fresh = fresh.search();
+  test(c.size() == c_fresh.size());
+  for(INDEX i=0; i<c.size(); ++i) {
+    test(c[i] == c_fresh[i] && c[i].cost == c_fresh[i].cost);
+  }
+}
+
+// projection edges are kept between searches and only recomputed for reparametrized pairwise factors. Results must equal those of a search from scratch.
+void test_incremental_projection_graph()
+{
+  std::vector<std::string> options = {"", "-v", "0"};
+  Solver<LP<mrf_test_FMC>, StandardVisitor> s(options);
+  auto& mrf = s.GetProblemConstructor<0>();
+  auto& lp = s.GetLP();
+  build_frustrated_cycle(mrf, 5, 0.1);
+  for(INDEX i=5; i<9; ++i) {
+    mrf.AddUnaryFactor(std::vector<REAL>({0.0, 0.2*(i%3), 0.1}));
+  }
+  for(INDEX i=5; i<8; ++i) {
+    matrix<REAL> cost(3, 3);
+    for(INDEX x1=0; x1<3; ++x1) {
+      for(INDEX x2=0; x2<3; ++x2) {
+        cost(x1,x2) = x1 == x2 ? 0.0 : 0.3 + 0.1*((i + 2*x1 + x2) % 4);
+      }
+    }
+    mrf.AddPairwiseFactor(i, i+1, cost);
+  }
+  lp.Begin();
+  lp.set_reparametrization(LPReparametrizationMode::DampedUniform);
+
+  using mrf_type = std::remove_reference_t<decltype(mrf)>;
+  k_ary_cycle_inequalities_search<mrf_type, false> k_projection(mrf);
+  k_ary_cycle_inequalities_search<mrf_type, true> expanded_projection(mrf);
+  test(!k_projection.search().empty());
+
+  INDEX iteration = 0;
+  for(INDEX round=0; round<3; ++round) {
+    test_same_candidates(k_projection, mrf);
+    test_same_candidates(expanded_projection, mrf);
+    run_passes(lp, iteration, 2);
+  }
+  // unchanged reparametrization reuses all edges
+  test_same_candidates(k_projection, mrf);
+  test_same_candidates(expanded_projection, mrf);
+
+  // costs changed directly, without message passing
+  matrix<REAL> delta(3, 3, 0.0);
+  delta(0,1) = -0.25;
+  mrf.AddToPairwiseCost(6, 7, delta);
+  test_same_candidates(k_projection, mrf);
+  test_same_candidates(expanded_projection, mrf);
+}
+
+template<typename MRF>
+struct budgeted_projection_search : public k_ary_cycle_inequalities_search<MRF, true> {
+  using base = k_ary_cycle_inequalities_search<MRF, true>;
+  using base::base;
+  using base::compute_partitions;
+  using base::construct_projection_graph;
+  using base::projection_edges_;
+};
+
+// the projection graph built with enough time equals one built from scratch
+template<typename SEARCH, typename MRF>
+void test_same_projection_edges(SEARCH& persistent, const MRF& mrf)
+{
+  SEARCH fresh(mrf);
+  test(fresh.construct_projection_graph(separation_budget(), fresh.compute_partitions()));
+  test(persistent.construct_projection_graph(separation_budget(), persistent.compute_partitions()));
+  test(persistent.projection_edges_ == fresh.projection_edges_);
+}
+
+// separation stops once the budget is exhausted. Edges computed so far are kept and the next search with enough time equals one from scratch.
+void test_exhausted_budget()
+{
+  std::vector<std::string> options = {"", "-v", "0"};
+  Solver<LP<mrf_test_FMC>, StandardVisitor> s(options);
+  auto& mrf = s.GetProblemConstructor<0>();
+  auto& lp = s.GetLP();
+  build_frustrated_cycle(mrf, 5, 0.1);
+  // general projections are only considered for more than three labels
+  for(INDEX i=5; i<9; ++i) {
+    mrf.AddUnaryFactor(std::vector<REAL>({0.1*(i%2), 0.2*(i%3), 0.15, 0.05*i}));
+  }
+  for(INDEX i=5; i<8; ++i) {
+    matrix<REAL> cost(4, 4);
+    for(INDEX x1=0; x1<4; ++x1) {
+      for(INDEX x2=0; x2<4; ++x2) {
+        cost(x1,x2) = x1 == x2 ? 0.0 : 0.3 + 0.1*((i + x1 + 2*x2) % 5);
+      }
+    }
+    mrf.AddPairwiseFactor(i, i+1, cost);
+  }
+  lp.Begin();
+  lp.set_reparametrization(LPReparametrizationMode::DampedUniform);
+
+  using mrf_type = std::remove_reference_t<decltype(mrf)>;
+  budgeted_projection_search<mrf_type> persistent(mrf);
+  const separation_budget exhausted(0.0);
+  test(exhausted.exceeded());
+  test(persistent.search(std::numeric_limits<INDEX>::max(), exhausted).empty());
+  test_same_projection_edges(persistent, mrf);
+  test_same_candidates(persistent, mrf);
+
+  // partitions change with the reparametrization. A construction without time keeps the new partitions, hence all edges depending on them must be recomputed later.
+  INDEX iteration = 0;
+  const auto initial_partitions = persistent.compute_partitions();
+  for(INDEX round=0; round<20 && initial_partitions == persistent.compute_partitions(); ++round) {
+    run_passes(lp, iteration, 1);
+  }
+  test(initial_partitions != persistent.compute_partitions());
+  test(!persistent.construct_projection_graph(exhausted, persistent.compute_partitions()));
+  test(persistent.search(std::numeric_limits<INDEX>::max(), exhausted).empty());
+  test_same_projection_edges(persistent, mrf);
+  test_same_candidates(persistent, mrf);
+
+  // a direct cost change reparametrizes one factor only, but changes partitions used by its neighbors as well.
+  // First split labels of variables 6 and 7 into {0,1} and {2,3}, then into {0,2} and {1,3}. The number of partitions stays the same, hence the node layout is kept.
+  auto block_cost = [](auto same_block) {
+    matrix<REAL> cost(4, 4, 0.0);
+    for(INDEX x1=0; x1<4; ++x1) {
+      for(INDEX x2=0; x2<4; ++x2) {
+        cost(x1,x2) = same_block(x1) == same_block(x2) ? 3.0 + 0.125*(x1 + 4*x2) : 0.0;
+      }
+    }
+    return cost;
+  };
+  const matrix<REAL> no_cost(4, 4, 0.0);
+  const auto low_labels = block_cost([](const INDEX x) { return x < 2; });
+  const auto even_labels = block_cost([](const INDEX x) { return x % 2 == 0; });
+  mrf.UpdatePairwiseCost(6, 7, no_cost, low_labels);
+  test_same_projection_edges(persistent, mrf);
+
+  const auto partitions = persistent.compute_partitions();
+  mrf.UpdatePairwiseCost(6, 7, low_labels, even_labels);
+  const auto changed_partitions = persistent.compute_partitions();
+  test(partitions[6] != changed_partitions[6] && partitions[7] != changed_partitions[7]);
+  for(INDEX i=0; i<partitions.size(); ++i) {
+    test(partitions[i].size() == changed_partitions[i].size());
+  }
+  test(!persistent.construct_projection_graph(exhausted, changed_partitions));
+  test_same_projection_edges(persistent, mrf);
+  test_same_candidates(persistent, mrf);
+
+  // a tightening step without time adds nothing and leaves the model usable
+  const INDEX no_triplets = mrf.GetNumberOfTripletFactors();
+  test(mrf.Tighten(10, 0.0) == 0);
+  test(mrf.GetNumberOfTripletFactors() == no_triplets);
+  run_passes(lp, iteration, 2);
+  test(mrf.Tighten(10) > 0);
+}
+
+int main()
+{
+  test_retire_inactive_triplets();
+  test_incremental_projection_graph();
+  test_exhausted_budget();
+}
@@ -0,0 +1,200 @@
+#include "test.h"
+#include "mrf_test_model.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include <cstdio>
+
+using namespace LP_MP;
+
+using warm_start_solver = Solver<LP<mrf_test_FMC>, StandardVisitor>;
+
+constexpr INDEX no_variables = 4;
+constexpr INDEX no_labels = 3;
+
+struct chain_costs {
+  std::vector<std::vector<REAL>> unaries;
+  std::vector<matrix<REAL>> pairwise;
+};
+
+chain_costs original_costs()
+{
+  chain_costs c;
+  for(INDEX i=0; i<no_variables; ++i) {
+    c.unaries.push_back({0.1*i, 0.5, 0.3*((i+1)%3)});
+  }
+  for(INDEX i=0; i+1<no_variables; ++i) {
+    matrix<REAL> cost(no_labels, no_labels);
+    for(INDEX x1=0; x1<no_labels; ++x1) {
+      for(INDEX x2=0; x2<no_labels; ++x2) {
+        cost(x1,x2) = x1 == x2 ? 0.0 : 0.2 + 0.1*((i + x1 + 2*x2) % 3);
+      }
+    }
+    c.pairwise.push_back(std::move(cost));
+  }
+  return c;
+}
+
+// minimum over all labelings. The model is a chain, hence the lower bound converges to it.
+REAL optimum(const chain_costs& c)
+{
+  REAL best = std::numeric_limits<REAL>::infinity();
+  std::array<INDEX, no_variables> x = {};
+  for(INDEX l=0; l<std::pow(no_labels, no_variables); ++l) {
+    INDEX r = l;
+    for(INDEX i=0; i<no_variables; ++i, r /= no_labels) { x[i] = r % no_labels; }
+    REAL cost = 0.0;
+    for(INDEX i=0; i<no_variables; ++i) { cost += c.unaries[i][x[i]]; }
+    for(INDEX i=0; i+1<no_variables; ++i) { cost += c.pairwise[i](x[i], x[i+1]); }
+    best = std::min(best, cost);
+  }
+  return best;
+}
+
+template<typename MRF>
+void build_chain(MRF& mrf, const chain_costs& c)
+{
+  for(INDEX i=0; i<no_variables; ++i) {
+    mrf.AddUnaryFactor(c.unaries[i]);
+  }
+  for(INDEX i=0; i+1<no_variables; ++i) {
+    mrf.AddPairwiseFactor(i, i+1, c.pairwise[i]);
+  }
+}
+
+REAL solve_from_scratch(const chain_costs& c)
+{
+  std::vector<std::string> options = {"", "--maxIter", "100", "-v", "0"};
+  warm_start_solver s(options);
+  build_chain(s.GetProblemConstructor<0>(), c);
+  s.Solve();
+  return s.lower_bound();
+}
+
+// set labeling in all factors of a chain built by build_chain
+template<typename MRF>
+void set_labeling(MRF& mrf, const std::array<INDEX, no_variables>& x)
+{
+  for(INDEX i=0; i<no_variables; ++i) {
+    mrf.GetUnaryFactor(i)->GetFactor()->primal_ = x[i];
+  }
+  for(INDEX i=0; i+1<no_variables; ++i) {
+    mrf.GetPairwiseFactor(i, i+1)->GetFactor()->primal_ = {x[i], x[i+1]};
+  }
+}
+
+// checkpoints contain the primal of the best solution, which is loaded into the factors when resuming
+void test_resume_primal(const bool delta)
+{
+  const std::string checkpoint = "warm_start_primal_checkpoint.bin";
+  const chain_costs costs = original_costs();
+  const std::array<INDEX, no_variables> labeling = {2, 0, 1, 1};
+  REAL labeling_cost = 0.0;
+  for(INDEX i=0; i<no_variables; ++i) { labeling_cost += costs.unaries[i][labeling[i]]; }
+  for(INDEX i=0; i+1<no_variables; ++i) { labeling_cost += costs.pairwise[i](labeling[i], labeling[i+1]); }
+  {
+    std::vector<std::string> options = {"", "--maxIter", "5", "-v", "0", "--checkpointFile", checkpoint, "--checkpointInterval", "1"};
+    if(delta) { options.push_back("--checkpointDelta"); }
+    warm_start_solver s(options);
+    auto& mrf = s.GetProblemConstructor<0>();
+    build_chain(mrf, costs);
+    s.GetLP().Begin();
+    set_labeling(mrf, labeling);
+    s.RegisterPrimal();
+    test(std::abs(s.primal_cost() - labeling_cost) <= eps);
+    s.Solve();
+  }
+
+  std::vector<std::string> options = {"", "-v", "0"};
+  warm_start_solver s(options);
+  auto& mrf = s.GetProblemConstructor<0>();
+  build_chain(mrf, costs);
+  s.GetLP().Begin();
+  for(auto it=s.GetLP().factor_begin(); it!=s.GetLP().factor_end(); ++it) {
+    (*it)->init_primal();
+  }
+  test(s.GetLP().EvaluatePrimal() == std::numeric_limits<REAL>::infinity());
+  s.Resume(checkpoint);
+  test(std::abs(s.primal_cost() - labeling_cost) <= eps);
+  test(std::abs(s.GetLP().EvaluatePrimal() - labeling_cost) <= eps);
+  for(INDEX i=0; i<no_variables; ++i) {
+    test(mrf.GetUnaryFactor(i)->GetFactor()->primal() == labeling[i]);
+  }
+
+  std::remove(checkpoint.c_str());
+}
+
+// change costs through the problem constructor between calls to Solve. Optimization must continue on the changed problem and reach the bound of a solve from scratch.
+int main()
+{
+  const std::string checkpoint = "warm_start_checkpoint.bin";
+  const chain_costs original = original_costs();
+  chain_costs changed = original;
+
+  const REAL original_lb = solve_from_scratch(original);
+  test(std::abs(original_lb - optimum(original)) <= eps);
+
+  {
+    std::vector<std::string> options = {"", "--maxIter", "100", "-v", "0", "--checkpointFile", checkpoint, "--checkpointInterval", "1"};
+    warm_start_solver s(options);
+    auto& mrf = s.GetProblemConstructor<0>();
+    build_chain(mrf, original);
+    s.Solve();
+    test(std::abs(s.lower_bound() - original_lb) <= eps);
+
+    const std::vector<REAL> unary_delta = {1.0, -0.5, 0.0};
+    mrf.AddToUnaryCost(1, unary_delta);
+    for(INDEX x=0; x<no_labels; ++x) { changed.unaries[1][x] += unary_delta[x]; }
+
+    changed.unaries[2] = {0.7, 0.0, 0.4};
+    mrf.UpdateUnaryCost(2, original.unaries[2], changed.unaries[2]);
+
+    matrix<REAL> pairwise_delta(no_labels, no_labels, 0.0);
+    pairwise_delta(0,0) = 0.8;
+    pairwise_delta(1,2) = -0.3;
+    mrf.AddToPairwiseCost(0, 1, pairwise_delta);
+    for(INDEX x1=0; x1<no_labels; ++x1) {
+      for(INDEX x2=0; x2<no_labels; ++x2) {
+        changed.pairwise[0](x1,x2) += pairwise_delta(x1,x2);
+      }
+    }
+
+    for(INDEX x=0; x<no_labels; ++x) {
+      changed.pairwise[2](x,x) = 0.6;
+    }
+    mrf.UpdatePairwiseCost(2, 3, original.pairwise[2], changed.pairwise[2]);
+
+    s.ResetPrimal();
+    test(s.primal_cost() == std::numeric_limits<REAL>::infinity());
+    s.Solve();
+    const REAL changed_lb = solve_from_scratch(changed);
+    test(std::abs(changed_lb - optimum(changed)) <= eps);
+    test(std::abs(changed_lb - original_lb) > 0.1);
+    test(std::abs(s.lower_bound() - changed_lb) <= eps);
+    test(std::abs(s.GetLP().LowerBound() - changed_lb) <= eps);
+  }
+
+  // the checkpoint is loaded in the first call to Solve only, hence a cost change before the second call is kept
+  {
+    std::vector<std::string> options = {"", "--maxIter", "100", "-v", "0", "--resumeFrom", checkpoint};
+    warm_start_solver s(options);
+    auto& mrf = s.GetProblemConstructor<0>();
+    build_chain(mrf, original);
+    s.Solve();
+    test(std::abs(s.lower_bound() - optimum(changed)) <= eps);
+
+    for(INDEX i=0; i<no_variables; ++i) {
+      mrf.UpdateUnaryCost(i, changed.unaries[i], original.unaries[i]);
+    }
+    for(INDEX i=0; i+1<no_variables; ++i) {
+      mrf.UpdatePairwiseCost(i, i+1, changed.pairwise[i], original.pairwise[i]);
+    }
+    s.ResetPrimal();
+    s.Solve();
+    test(std::abs(s.lower_bound() - original_lb) <= eps);
+  }
+
+  std::remove(checkpoint.c_str());
+
+  test_resume_primal(false);
+  test_resume_primal(true);
+}
@@ -0,0 +1,78 @@
+// converts telemetry files written by TelemetryVisitor into csv or into pgfplots coordinates of lower and upper bound
+
+#include "telemetry.hxx"
+#include "tclap/CmdLine.h"
+#include <iostream>
+#include <fstream>
+#include <limits>
+
+using namespace LP_MP;
+
+void write_csv(const telemetry::table& t, std::ostream& s)
+{
+   for(std::size_t i=0; i<t.names.size(); ++i) {
+      s << (i == 0 ? "" : ",") << t.names[i];
+   }
+   s << "\n";
+   s.precision(std::numeric_limits<double>::max_digits10);
+   for(const auto& row : t.rows) {
+      for(std::size_t i=0; i<row.size(); ++i) {
+         s << (i == 0 ? "" : ",") << row[i];
+      }
+      s << "\n";
+   }
+}
+
+// non-finite bounds, e.g. upper bounds before the first primal, are skipped
+void write_pgfplots(const telemetry::table& t, const std::string& x_axis, std::ostream& s)
+{
+   const std::size_t x = t.column(x_axis);
+   for(const std::string bound : {"lower_bound", "upper_bound"}) {
+      const std::size_t y = t.column(bound);
+      s << "\\addplot[thick," << (bound == "lower_bound" ? "blue" : "red") << "] plot coordinates {\n";
+      for(const auto& row : t.rows) {
+         if(std::isfinite(row[y])) {
+            s << "(" << row[x] << "," << row[y] << ")\n";
+         }
+      }
+      s << "};\n";
+   }
+}
+
+int main(int argc, char** argv)
+{
+   TCLAP::CmdLine cmd("convert telemetry files of LP_MP solvers", ' ', "0.1");
+   TCLAP::UnlabeledValueArg<std::string> inputArg("input", "telemetry file", true, "", "file name", cmd);
+   TCLAP::ValueArg<std::string> outputArg("o", "output", "output file, default = standard output", false, "", "file name", cmd);
+   TCLAP::ValueArg<std::string> formatArg("f", "format", "output format, default = csv", false, "csv", "{csv|pgfplots}", cmd);
+   TCLAP::ValueArg<std::string> xAxisArg("x", "xAxis", "horizontal axis of plots, default = time", false, "time", "{time|iteration}", cmd);
+
+   try {
+      cmd.parse(argc, argv);
+      const auto t = telemetry::read_file(inputArg.getValue());
+
+      std::ofstream file;
+      if(outputArg.isSet()) {
+         file.open(outputArg.getValue());
+         if(!file.is_open()) {
+            throw std::runtime_error("could not open output file " + outputArg.getValue());
+         }
+      }
+      std::ostream& s = outputArg.isSet() ? file : std::cout;
+
+      if(formatArg.getValue() == "csv") {
+         write_csv(t, s);
+      } else if(formatArg.getValue() == "pgfplots") {
+         write_pgfplots(t, xAxisArg.getValue(), s);
+      } else {
+         throw std::runtime_error("output format " + formatArg.getValue() + " unknown");
+      }
+   } catch(TCLAP::ArgException& e) {
+      std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+      return 1;
+   } catch(std::exception& e) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+   return 0;
+}